@@ -0,0 +1,636 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "external.h"
+#include "internal.h"
+#include "params.h"
+#include "pool.h"
+#include "timing.h"
+
+// Runs NIST ACVP SLH-DSA test vectors (keyGen, sigGen and sigVer, revision FIPS205)
+// Each file has to hold the inputs and the expected results together, like the internalProjection.json files of the ACVP server
+
+typedef enum { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT } JsonType;
+
+// Parsed JSON value, strings point into the file buffer
+typedef struct Json {
+    JsonType type;
+    bool boolean;
+    double number;
+    const char *string;
+    size_t len;
+    struct Json *items;     // array elements or object values
+    const char **keys;      // object keys
+    size_t count;
+} Json;
+
+typedef struct {
+    char *p;
+    char *end;
+    bool error;
+    bool no_memory;     // set together with error when a list cannot grow
+} Parser;
+
+static void skip_space(Parser *ps)
+{
+    while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' || *ps->p == '\r'))
+        ps->p++;
+}
+
+// Strings are unescaped in place, the result is never longer than the escaped form
+// \u escapes are only decoded for ASCII, the vector files do not use others
+static const char *parse_string(Parser *ps, size_t *len)
+{
+    char *out = ++ps->p;
+    const char *start = out;
+    while (ps->p < ps->end && *ps->p != '"') {
+        char c = *ps->p++;
+        if (c == '\\' && ps->p < ps->end) {
+            char e = *ps->p++;
+            switch (e) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u':
+                if (ps->end - ps->p < 4) {
+                    ps->error = true;
+                    return NULL;
+                }
+                c = (char) strtol((char[]) { ps->p[0], ps->p[1], ps->p[2], ps->p[3], 0 }, NULL, 16);
+                ps->p += 4;
+                break;
+            default: c = e; break;
+            }
+        }
+        *out++ = c;
+    }
+    if (ps->p >= ps->end) {
+        ps->error = true;
+        return NULL;
+    }
+    *len = out - start;
+    *out = 0;
+    ps->p++;
+    return start;
+}
+
+static void parse_value(Parser *ps, Json *v);
+
+// Elements of an array or members of an object, grown by doubling
+static void parse_list(Parser *ps, Json *v, bool object, char close)
+{
+    size_t cap = 0;
+    v->count = 0;
+    v->items = NULL;
+    v->keys = NULL;
+    ps->p++;
+    skip_space(ps);
+    if (ps->p < ps->end && *ps->p == close) {
+        ps->p++;
+        return;
+    }
+
+    while (!ps->error) {
+        if (v->count == cap) {
+            cap = cap ? 2 * cap : 8;
+            Json *items = realloc(v->items, cap * sizeof *v->items);
+            if (items != NULL)
+                v->items = items;
+            const char **keys = object ? realloc(v->keys, cap * sizeof *v->keys) : NULL;
+            if (keys != NULL)
+                v->keys = keys;
+            // the old buffers stay valid for the count parsed so far, json_free releases them
+            if (items == NULL || (object && keys == NULL)) {
+                ps->error = true;
+                ps->no_memory = true;
+                return;
+            }
+        }
+        skip_space(ps);
+        if (object) {
+            size_t key_len;
+            if (ps->p >= ps->end || *ps->p != '"') {
+                ps->error = true;
+                return;
+            }
+            v->keys[v->count] = parse_string(ps, &key_len);
+            skip_space(ps);
+            if (ps->p >= ps->end || *ps->p != ':') {
+                ps->error = true;
+                return;
+            }
+            ps->p++;
+        }
+        parse_value(ps, &v->items[v->count++]);
+        skip_space(ps);
+        if (ps->p < ps->end && *ps->p == ',') {
+            ps->p++;
+            continue;
+        }
+        if (ps->p < ps->end && *ps->p == close) {
+            ps->p++;
+            return;
+        }
+        ps->error = true;
+    }
+}
+
+static void parse_value(Parser *ps, Json *v)
+{
+    memset(v, 0, sizeof *v);
+    skip_space(ps);
+    if (ps->p >= ps->end) {
+        ps->error = true;
+        return;
+    }
+
+    switch (*ps->p) {
+    case '{':
+        v->type = JSON_OBJECT;
+        parse_list(ps, v, true, '}');
+        return;
+    case '[':
+        v->type = JSON_ARRAY;
+        parse_list(ps, v, false, ']');
+        return;
+    case '"':
+        v->type = JSON_STRING;
+        v->string = parse_string(ps, &v->len);
+        return;
+    }
+
+    if (ps->end - ps->p >= 4 && memcmp(ps->p, "true", 4) == 0) {
+        v->type = JSON_BOOL;
+        v->boolean = true;
+        ps->p += 4;
+    } else if (ps->end - ps->p >= 5 && memcmp(ps->p, "false", 5) == 0) {
+        v->type = JSON_BOOL;
+        ps->p += 5;
+    } else if (ps->end - ps->p >= 4 && memcmp(ps->p, "null", 4) == 0) {
+        v->type = JSON_NULL;
+        ps->p += 4;
+    } else {
+        char *end;
+        v->type = JSON_NUMBER;
+        v->number = strtod(ps->p, &end);
+        if (end == ps->p)
+            ps->error = true;
+        ps->p = end;
+    }
+}
+
+static void json_free(Json *v)
+{
+    for (size_t i = 0; i < v->count; i++)
+        json_free(&v->items[i]);
+    free(v->items);
+    free(v->keys);
+}
+
+static const Json *json_get(const Json *obj, const char *key)
+{
+    if (obj == NULL || obj->type != JSON_OBJECT)
+        return NULL;
+    for (size_t i = 0; i < obj->count; i++) {
+        if (strcmp(obj->keys[i], key) == 0)
+            return &obj->items[i];
+    }
+    return NULL;
+}
+
+static const char *json_string(const Json *obj, const char *key)
+{
+    const Json *v = json_get(obj, key);
+    return v != NULL && v->type == JSON_STRING ? v->string : NULL;
+}
+
+static int64_t json_int(const Json *obj, const char *key)
+{
+    const Json *v = json_get(obj, key);
+    return v != NULL && v->type == JSON_NUMBER ? (int64_t) v->number : -1;
+}
+
+// value of each hex digit plus one, 0 for other characters
+static uint8_t hex_table[256];
+
+static void hex_init(void)
+{
+    for (int c = 0; c < 10; c++)
+        hex_table['0' + c] = c + 1;
+    for (int c = 0; c < 6; c++) {
+        hex_table['a' + c] = c + 11;
+        hex_table['A' + c] = c + 11;
+    }
+}
+
+// Decodes hex into a new buffer, returns NULL if hex has odd length or other characters
+// or the buffer cannot be allocated, the vector then fails like a malformed one
+static uint8_t *hex_decode(const Json *v, size_t *len)
+{
+    if (v == NULL || v->type != JSON_STRING || v->len % 2 != 0)
+        return NULL;
+
+    const uint8_t *s = (const uint8_t *) v->string;
+    uint8_t *out = malloc(v->len / 2 + 1);
+    if (out == NULL)
+        return NULL;
+    for (size_t i = 0; i < v->len / 2; i++) {
+        uint8_t hi = hex_table[s[2 * i]];
+        uint8_t lo = hex_table[s[2 * i + 1]];
+        if (hi == 0 || lo == 0) {
+            free(out);
+            return NULL;
+        }
+        out[i] = (hi - 1) << 4 | (lo - 1);
+    }
+    *len = v->len / 2;
+    return out;
+}
+
+static const struct {
+    const char *name;
+    PreHash PH;
+} hash_algs[12] = {
+    { "SHA2-224",     PH_SHA_224 },
+    { "SHA2-256",     PH_SHA_256 },
+    { "SHA2-384",     PH_SHA_384 },
+    { "SHA2-512",     PH_SHA_512 },
+    { "SHA2-512/224", PH_SHA_512_224 },
+    { "SHA2-512/256", PH_SHA_512_256 },
+    { "SHA3-224",     PH_SHA3_224 },
+    { "SHA3-256",     PH_SHA3_256 },
+    { "SHA3-384",     PH_SHA3_384 },
+    { "SHA3-512",     PH_SHA3_512 },
+    { "SHAKE-128",    PH_SHAKE128 },
+    { "SHAKE-256",    PH_SHAKE256 }
+};
+
+static const char *parameter_sets[12] = {
+    "SLH-DSA-SHA2-128f", "SLH-DSA-SHA2-128s", "SLH-DSA-SHA2-192f", "SLH-DSA-SHA2-192s",
+    "SLH-DSA-SHA2-256f", "SLH-DSA-SHA2-256s", "SLH-DSA-SHAKE-128f", "SLH-DSA-SHAKE-128s",
+    "SLH-DSA-SHAKE-192f", "SLH-DSA-SHAKE-192s", "SLH-DSA-SHAKE-256f", "SLH-DSA-SHAKE-256s"
+};
+
+typedef enum { KEYGEN, SIGGEN, SIGVER } Mode;
+
+typedef enum { PASSED, FAILED, SKIPPED } Outcome;
+
+// One test case and its result
+typedef struct {
+    const Json *group;
+    const Json *test;
+    Parameters prm;
+    int64_t tgId;
+    int64_t tcId;
+    Outcome outcome;
+    uint64_t ns;
+} Vector;
+
+typedef struct {
+    Mode mode;
+    Vector *vectors;
+} Run;
+
+static bool equal(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+    return a != NULL && b != NULL && a_len == b_len && memcmp(a, b, a_len) == 0;
+}
+
+static Outcome run_keygen(Vector *v)
+{
+    Parameters *prm = &v->prm;
+    size_t sk_seed_len, sk_prf_len, pk_seed_len, sk_len, pk_len;
+    uint8_t *sk_seed = hex_decode(json_get(v->test, "skSeed"), &sk_seed_len);
+    uint8_t *sk_prf = hex_decode(json_get(v->test, "skPrf"), &sk_prf_len);
+    uint8_t *pk_seed = hex_decode(json_get(v->test, "pkSeed"), &pk_seed_len);
+    uint8_t *sk = hex_decode(json_get(v->test, "sk"), &sk_len);
+    uint8_t *pk = hex_decode(json_get(v->test, "pk"), &pk_len);
+
+    // a vector of a known parameter set that cannot be decoded fails, so a broken file does not pass
+    Outcome outcome = FAILED;
+    if (sk_seed != NULL && sk_prf != NULL && pk_seed != NULL && sk_seed_len == prm->n && sk_prf_len == prm->n && pk_seed_len == prm->n) {
+        uint8_t SK[4 * prm->n];
+        uint8_t PK[2 * prm->n];
+        uint64_t start = now_ns();
+        slh_keygen_internal(prm, sk_seed, sk_prf, pk_seed, SK, PK);
+        v->ns = now_ns() - start;
+        outcome = equal(SK, sizeof SK, sk, sk_len) && equal(PK, sizeof PK, pk, pk_len) ? PASSED : FAILED;
+    }
+
+    free(sk_seed);
+    free(sk_prf);
+    free(pk_seed);
+    free(sk);
+    free(pk);
+    return outcome;
+}
+
+// Reads the pre-hash function of a preHash test, returns false if it is missing or not approved
+static bool test_prehash(const Vector *v, PreHash *PH)
+{
+    const char *name = json_string(v->test, "hashAlg");
+    for (uint32_t i = 0; name != NULL && i < 12; i++) {
+        if (strcmp(name, hash_algs[i].name) == 0) {
+            *PH = hash_algs[i].PH;
+            return true;
+        }
+    }
+    return false;
+}
+
+static Outcome run_sign_verify(Vector *v, Mode mode)
+{
+    Parameters *prm = &v->prm;
+    uint32_t sig_len = slh_signature_length(prm);
+    const char *interface = json_string(v->group, "signatureInterface");
+    const char *prehash = json_string(v->group, "preHash");
+    bool internal = interface != NULL && strcmp(interface, "internal") == 0;
+    bool pure = prehash == NULL || strcmp(prehash, "pure") == 0;
+    PreHash PH = PH_SHA_256;
+
+    size_t key_len, M_len, ctx_len = 0, sig_len_in, rnd_len = 0;
+    const Json *key = json_get(v->test, mode == SIGGEN ? "sk" : "pk");
+    if (key == NULL)
+        key = json_get(v->group, mode == SIGGEN ? "sk" : "pk");
+    uint8_t *K = hex_decode(key, &key_len);
+    uint8_t *M = hex_decode(json_get(v->test, "message"), &M_len);
+    uint8_t *ctx = json_get(v->test, "context") != NULL ? hex_decode(json_get(v->test, "context"), &ctx_len) : calloc(1, 1);
+    uint8_t *SIG = hex_decode(json_get(v->test, "signature"), &sig_len_in);
+    uint8_t *rnd = json_get(v->test, "additionalRandomness") != NULL ? hex_decode(json_get(v->test, "additionalRandomness"), &rnd_len) : NULL;
+
+    Outcome outcome = FAILED;
+    if (K == NULL || M == NULL || ctx == NULL || SIG == NULL || (!pure && !internal && !test_prehash(v, &PH)))
+        goto done;
+
+    if (mode == SIGGEN) {
+        const Json *det = json_get(v->group, "deterministic");
+        bool deterministic = det != NULL && det->type == JSON_BOOL && det->boolean;
+        if (key_len != 4 * prm->n || (!deterministic && rnd_len != prm->n))
+            goto done;
+        // the deterministic variant uses PK.seed for addrnd
+        const uint8_t *addrnd = deterministic ? K + 2 * prm->n : rnd;
+
+        uint8_t out[sig_len];
+        uint64_t start = now_ns();
+        if (internal)
+            slh_sign_internal(prm, M, M_len, K, addrnd, out);
+        else if (pure)
+            slh_sign_addrnd(prm, M, M_len, ctx, ctx_len, K, addrnd, out);
+        else
+            hash_slh_sign_addrnd(prm, M, M_len, ctx, ctx_len, PH, K, addrnd, out);
+        v->ns = now_ns() - start;
+        outcome = equal(out, sig_len, SIG, sig_len_in) ? PASSED : FAILED;
+    } else {
+        const Json *expected = json_get(v->test, "testPassed");
+        if (key_len != 2 * prm->n || expected == NULL || expected->type != JSON_BOOL)
+            goto done;
+
+        bool result;
+        uint64_t start = now_ns();
+        if (internal)
+            result = slh_verify_internal(prm, M, M_len, SIG, sig_len_in, K);
+        else if (pure)
+            result = slh_verify(prm, M, M_len, SIG, sig_len_in, ctx, ctx_len, K);
+        else
+            result = hash_slh_verify(prm, M, M_len, SIG, sig_len_in, ctx, ctx_len, PH, K);
+        v->ns = now_ns() - start;
+        outcome = result == expected->boolean ? PASSED : FAILED;
+    }
+
+done:
+    free(K);
+    free(M);
+    free(ctx);
+    free(SIG);
+    free(rnd);
+    return outcome;
+}
+
+static void vector_job(void *arg, size_t i)
+{
+    Run *run = arg;
+    Vector *v = &run->vectors[i];
+    v->outcome = run->mode == KEYGEN ? run_keygen(v) : run_sign_verify(v, run->mode);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *data = malloc(size + 1);
+    if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    data[size] = 0;
+    *len = size;
+    return data;
+}
+
+// Runs all vectors of one file on the pool, returns the number of failed vectors (at least 1 if none passed)
+// or -1 if the file cannot be used. Only vectors of unknown parameter sets are skipped.
+static int64_t run_file(const char *path, Pool *pool, FILE *latencies)
+{
+    size_t len;
+    char *data = read_file(path, &len);
+    if (data == NULL) {
+        printf("Error reading %s\n", path);
+        return -1;
+    }
+
+    Json root;
+    Parser ps = { data, data + len, false, false };
+    parse_value(&ps, &root);
+    if (ps.error) {
+        if (ps.no_memory)
+            printf("%s: out of memory parsing the JSON\n", path);
+        else
+            printf("%s: invalid JSON near byte %ld\n", path, (long) (ps.p - data));
+        json_free(&root);
+        free(data);
+        return -1;
+    }
+
+    // the ACVP files wrap the vector set in an array after a version object
+    const Json *set = &root;
+    if (root.type == JSON_ARRAY && root.count > 0)
+        set = &root.items[root.count - 1];
+
+    const char *mode_name = json_string(set, "mode");
+    const Json *groups = json_get(set, "testGroups");
+    Run run;
+    if (mode_name != NULL && strcmp(mode_name, "keyGen") == 0)
+        run.mode = KEYGEN;
+    else if (mode_name != NULL && strcmp(mode_name, "sigGen") == 0)
+        run.mode = SIGGEN;
+    else if (mode_name != NULL && strcmp(mode_name, "sigVer") == 0)
+        run.mode = SIGVER;
+    else
+        groups = NULL;
+    if (groups == NULL || groups->type != JSON_ARRAY) {
+        printf("%s: not an SLH-DSA keyGen, sigGen or sigVer vector set\n", path);
+        json_free(&root);
+        free(data);
+        return -1;
+    }
+
+    size_t total = 0;
+    for (size_t g = 0; g < groups->count; g++) {
+        const Json *tests = json_get(&groups->items[g], "tests");
+        total += tests != NULL && tests->type == JSON_ARRAY ? tests->count : 0;
+    }
+
+    run.vectors = calloc(total + 1, sizeof *run.vectors);
+    if (run.vectors == NULL) {
+        printf("%s: out of memory for %zu vectors\n", path, total);
+        json_free(&root);
+        free(data);
+        return -1;
+    }
+    size_t count = 0;
+    for (size_t g = 0; g < groups->count; g++) {
+        const Json *group = &groups->items[g];
+        const Json *tests = json_get(group, "tests");
+        const char *set_name = json_string(group, "parameterSet");
+        int known = -1;
+        for (int i = 0; set_name != NULL && i < 12; i++) {
+            if (strcmp(set_name, parameter_sets[i]) == 0)
+                known = i;
+        }
+        if (tests == NULL || tests->type != JSON_ARRAY)
+            continue;
+
+        for (size_t t = 0; t < tests->count; t++) {
+            Vector *v = &run.vectors[count++];
+            v->group = group;
+            v->test = &tests->items[t];
+            v->tgId = json_int(group, "tgId");
+            v->tcId = json_int(v->test, "tcId");
+            v->outcome = SKIPPED;
+            if (known >= 0)
+                setup_parameter_set(&v->prm, set_name);
+        }
+    }
+
+    // vectors of unknown parameter sets stay skipped, the rest run on the pool
+    size_t runnable = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (run.vectors[i].prm.n != 0) {
+            Vector tmp = run.vectors[runnable];
+            run.vectors[runnable++] = run.vectors[i];
+            run.vectors[i] = tmp;
+        }
+    }
+    uint64_t start = now_ns();
+    if (pool != NULL)
+        pool_run(pool, vector_job, &run, runnable);
+    else
+        for (size_t i = 0; i < runnable; i++)
+            vector_job(&run, i);
+    uint64_t wall = now_ns() - start;
+
+    size_t passed = 0, failed = 0, skipped = 0;
+    uint64_t *ns = malloc((count + 1) * sizeof *ns);
+    if (ns == NULL) {
+        printf("%s: out of memory for the latencies\n", path);
+        free(run.vectors);
+        json_free(&root);
+        free(data);
+        return -1;
+    }
+    size_t timed = 0;
+    for (size_t i = 0; i < count; i++) {
+        Vector *v = &run.vectors[i];
+        if (v->outcome == PASSED)
+            passed++;
+        else if (v->outcome == FAILED)
+            failed++;
+        else
+            skipped++;
+        if (v->outcome == FAILED)
+            printf("%s: tgId %ld tcId %ld failed\n", path, (long) v->tgId, (long) v->tcId);
+        if (v->outcome != SKIPPED)
+            ns[timed++] = v->ns;
+        if (latencies != NULL)
+            fprintf(latencies, "%s,%s,%ld,%ld,%s,%lu,%s\n", path, mode_name, (long) v->tgId, (long) v->tcId,
+                    json_string(v->group, "parameterSet"), (unsigned long) v->ns,
+                    v->outcome == PASSED ? "passed" : v->outcome == FAILED ? "failed" : "skipped");
+    }
+    qsort(ns, timed, sizeof *ns, compare_u64);
+    printf("%s: %s, %zu vectors, %zu passed, %zu failed, %zu skipped, %.2f s wall, median %.1f us, max %.1f us per vector\n",
+           path, mode_name, count, passed, failed, skipped, wall / 1e9,
+           timed ? ns[timed / 2] / 1e3 : 0.0, timed ? ns[timed - 1] / 1e3 : 0.0);
+
+    free(ns);
+    free(run.vectors);
+    json_free(&root);
+    free(data);
+    if (passed == 0) {
+        printf("%s: no vector passed\n", path);
+        return failed > 0 ? (int64_t) failed : 1;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threads = cpus > 0 ? cpus : 1;
+    const char *latency_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:")) != -1) {
+        switch (opt) {
+        case 't': threads = atoi(optarg); break;
+        case 'o': latency_path = optarg; break;
+        default:
+            printf("Usage: %s [-t threads] [-o latencies.csv] vectors.json...\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc) {
+        printf("Usage: %s [-t threads] [-o latencies.csv] vectors.json...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *latencies = NULL;
+    if (latency_path != NULL) {
+        latencies = fopen(latency_path, "w");
+        if (latencies == NULL) {
+            printf("Error opening %s\n", latency_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(latencies, "file,mode,tgId,tcId,parameterSet,ns,result\n");
+    }
+
+    hex_init();
+    Pool *pool = threads > 1 ? pool_create(threads) : NULL;
+
+    bool ok = true;
+    for (int i = optind; i < argc; i++)
+        ok &= run_file(argv[i], pool, latencies) == 0;
+
+    pool_destroy(pool);
+    if (latencies != NULL)
+        fclose(latencies);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,327 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "async.h"
+#include "batch.h"
+#include "external.h"
+#include "pool.h"
+
+// Bounded multi-producer multi-consumer ring (Vyukov): every cell has a sequence number
+// that tells whether it is free for the producer at position pos (seq == pos) or full for the consumer (seq == pos + 1)
+typedef struct {
+    _Atomic size_t *seq;
+    uint8_t *data;
+    size_t size;                // bytes per element
+    size_t mask;
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) _Atomic size_t dequeue_pos;
+} Ring;
+
+struct AsyncQueue {
+    Ring sq;
+    Ring cq;
+    size_t capacity;
+    _Atomic size_t inflight;    // submitted and not reaped
+    sem_t pending;              // requests on the submission ring, plus one per worker when stopping
+    atomic_bool stop;
+    int efd;
+    pthread_t *threads;
+    uint32_t count;
+};
+
+static bool ring_init(Ring *r, size_t capacity, size_t size)
+{
+    r->seq = malloc(capacity * sizeof *r->seq);
+    r->data = malloc(capacity * size);
+    if (r->seq == NULL || r->data == NULL)
+        return false;
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&r->seq[i], i);
+    r->size = size;
+    r->mask = capacity - 1;
+    atomic_init(&r->enqueue_pos, 0);
+    atomic_init(&r->dequeue_pos, 0);
+    return true;
+}
+
+static void ring_free(Ring *r)
+{
+    free((void *) r->seq);
+    free(r->data);
+}
+
+static bool ring_push(Ring *r, const void *item)
+{
+    size_t pos = atomic_load_explicit(&r->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        size_t seq = atomic_load_explicit(&r->seq[pos & r->mask], memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&r->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(r->data + (pos & r->mask) * r->size, item, r->size);
+    atomic_store_explicit(&r->seq[pos & r->mask], pos + 1, memory_order_release);
+    return true;
+}
+
+static bool ring_pop(Ring *r, void *item)
+{
+    size_t pos = atomic_load_explicit(&r->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        size_t seq = atomic_load_explicit(&r->seq[pos & r->mask], memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&r->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(item, r->data + (pos & r->mask) * r->size, r->size);
+    atomic_store_explicit(&r->seq[pos & r->mask], pos + r->mask + 1, memory_order_release);
+    return true;
+}
+
+// Takes the request that a count of pending belongs to
+// A producer may still be writing an earlier cell, so an empty ring is only final when stopping
+static bool take_request(AsyncQueue *q, AsyncRequest *req)
+{
+    while (!ring_pop(&q->sq, req)) {
+        if (atomic_load(&q->stop))
+            return false;
+        sched_yield();
+    }
+    return true;
+}
+
+// Runs every request of operation op, those with the same parameter set (and flags when signing) as one batch
+static void run_op(const AsyncRequest *reqs, size_t count, uint8_t op, bool *done, uint32_t *status)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (done[i] || reqs[i].op != op)
+            continue;
+
+        size_t idx[count];
+        size_t L = 0;
+        for (size_t j = i; j < count; j++) {
+            if (!done[j] && reqs[j].op == op && reqs[j].prm == reqs[i].prm
+                && (op == ASYNC_VERIFY || reqs[j].flags == reqs[i].flags))
+                idx[L++] = j;
+        }
+
+        if (op == ASYNC_VERIFY) {
+            VerifyItem items[L];
+            bool results[L];
+            for (size_t e = 0; e < L; e++) {
+                const AsyncRequest *r = &reqs[idx[e]];
+                items[e] = (VerifyItem) { r->M, r->M_len, r->SIG, r->SIG_len, r->ctx, r->ctx_len, r->key };
+            }
+            slh_verify_batch(reqs[i].prm, items, L, results);
+            for (size_t e = 0; e < L; e++)
+                status[idx[e]] = results[e] ? ASYNC_OK : ASYNC_INVALID;
+        } else {
+            SignItem items[L];
+            bool ok[L];
+            for (size_t e = 0; e < L; e++) {
+                const AsyncRequest *r = &reqs[idx[e]];
+                items[e] = (SignItem) { r->M, r->M_len, r->ctx, r->ctx_len, r->key, r->SIG, NULL };
+            }
+            slh_sign_batch(reqs[i].prm, NULL, items, L, !(reqs[i].flags & ASYNC_RANDOMIZED), ok);
+            // ctx was checked when the batch was taken, so a failed item had no randomness
+            for (size_t e = 0; e < L; e++)
+                status[idx[e]] = ok[e] ? ASYNC_OK : ASYNC_ERROR;
+        }
+        for (size_t e = 0; e < L; e++)
+            done[idx[e]] = true;
+    }
+}
+
+// Posts the completions of the requests finished since the last call
+static void post(AsyncQueue *q, const AsyncRequest *reqs, size_t count, const bool *done, bool *posted, const uint32_t *status)
+{
+    uint64_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!done[i] || posted[i])
+            continue;
+        AsyncCompletion c = { reqs[i].token, status[i] };
+        // cannot fail, at most capacity requests are in flight
+        ring_push(&q->cq, &c);
+        posted[i] = true;
+        added++;
+    }
+    if (added > 0 && write(q->efd, &added, sizeof added) != sizeof added)
+        printf("Error signalling completions\n");
+}
+
+static void *worker(void *arg)
+{
+    AsyncQueue *q = arg;
+    AsyncRequest reqs[ASYNC_BATCH];
+
+    for (;;) {
+        while (sem_wait(&q->pending) != 0)
+            ;
+        if (!take_request(q, &reqs[0]))
+            break;
+
+        // whatever else is waiting joins the batch
+        size_t count = 1;
+        while (count < ASYNC_BATCH && sem_trywait(&q->pending) == 0) {
+            if (!take_request(q, &reqs[count])) {
+                // a stop token, leave it for another worker
+                sem_post(&q->pending);
+                break;
+            }
+            count++;
+        }
+
+        bool done[count];
+        bool posted[count];
+        uint32_t status[count];
+        for (size_t i = 0; i < count; i++) {
+            const AsyncRequest *r = &reqs[i];
+            done[i] = false;
+            posted[i] = false;
+            if ((r->op != ASYNC_SIGN && r->op != ASYNC_VERIFY) || r->ctx_len > MAX_CTX_LENGTH
+                || r->SIG_len != slh_signature_length(r->prm)) {
+                done[i] = true;
+                status[i] = ASYNC_BAD_REQUEST;
+            }
+        }
+
+        // verifications first, their completions go out before the signatures start
+        run_op(reqs, count, ASYNC_VERIFY, done, status);
+        post(q, reqs, count, done, posted, status);
+        run_op(reqs, count, ASYNC_SIGN, done, status);
+        post(q, reqs, count, done, posted, status);
+    }
+    return NULL;
+}
+
+AsyncQueue *async_create(uint32_t entries, uint32_t threads)
+{
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    size_t capacity = 2;
+    while (capacity < entries)
+        capacity *= 2;
+
+    AsyncQueue *q = calloc(1, sizeof *q);
+    if (q == NULL)
+        return NULL;
+    q->capacity = capacity;
+    q->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    q->threads = calloc(threads, sizeof *q->threads);
+    if (q->efd < 0 || q->threads == NULL || !ring_init(&q->sq, capacity, sizeof(AsyncRequest))
+        || !ring_init(&q->cq, capacity, sizeof(AsyncCompletion))) {
+        if (q->efd >= 0)
+            close(q->efd);
+        ring_free(&q->sq);
+        ring_free(&q->cq);
+        free(q->threads);
+        free(q);
+        return NULL;
+    }
+    atomic_init(&q->inflight, 0);
+    atomic_init(&q->stop, false);
+    sem_init(&q->pending, 0, 0);
+
+    // see POOL_STACK_SIZE
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_STACK_SIZE);
+    for (uint32_t i = 0; i < threads; i++) {
+        if (pthread_create(&q->threads[i], &attr, worker, q) != 0) {
+            printf("Error starting worker thread\n");
+            pthread_attr_destroy(&attr);
+            async_destroy(q);
+            return NULL;
+        }
+        q->count++;
+    }
+    pthread_attr_destroy(&attr);
+    return q;
+}
+
+void async_destroy(AsyncQueue *q)
+{
+    if (q == NULL)
+        return;
+
+    // workers stop when they find a count of pending without a request, after the submitted requests ran out
+    atomic_store(&q->stop, true);
+    for (uint32_t i = 0; i < q->count; i++)
+        sem_post(&q->pending);
+    for (uint32_t i = 0; i < q->count; i++)
+        pthread_join(q->threads[i], NULL);
+
+    sem_destroy(&q->pending);
+    close(q->efd);
+    ring_free(&q->sq);
+    ring_free(&q->cq);
+    free(q->threads);
+    free(q);
+}
+
+int async_eventfd(const AsyncQueue *q)
+{
+    return q->efd;
+}
+
+bool async_submit(AsyncQueue *q, const AsyncRequest *req)
+{
+    if (atomic_fetch_add(&q->inflight, 1) >= q->capacity) {
+        atomic_fetch_sub(&q->inflight, 1);
+        return false;
+    }
+    if (!ring_push(&q->sq, req)) {
+        atomic_fetch_sub(&q->inflight, 1);
+        return false;
+    }
+    sem_post(&q->pending);
+    return true;
+}
+
+size_t async_reap(AsyncQueue *q, AsyncCompletion *out, size_t max)
+{
+    size_t n = 0;
+    while (n < max && ring_pop(&q->cq, &out[n]))
+        n++;
+    atomic_fetch_sub(&q->inflight, n);
+    return n;
+}
+
+size_t async_wait(AsyncQueue *q, AsyncCompletion *out, size_t max)
+{
+    for (;;) {
+        size_t n = async_reap(q, out, max);
+        if (n > 0 || max == 0)
+            return n;
+
+        struct pollfd pfd = { q->efd, POLLIN, 0 };
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return 0;
+        uint64_t counter;
+        if (read(q->efd, &counter, sizeof counter) < 0 && errno != EAGAIN)
+            return 0;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "params.h"
+
+// Submission and completion rings in front of worker threads, for event loops built on io_uring or epoll
+// Callers push requests with a token onto the submission ring, the workers take them in batches
+// (SHAKE verifications and signatures run 8 at a time on the multi-buffer Keccak) and post the token
+// with the result on the completion ring. The eventfd of the queue counts posted completions.
+// Both rings are bounded lock-free queues, any thread may submit or reap.
+typedef struct AsyncQueue AsyncQueue;
+
+enum {
+    ASYNC_SIGN   = 1,
+    ASYNC_VERIFY = 2
+};
+
+// flags
+#define ASYNC_RANDOMIZED 0x01   // hedged signing with fresh addrnd, otherwise deterministic
+
+enum {
+    ASYNC_OK          = 0,
+    ASYNC_INVALID     = 1,      // the signature does not verify
+    ASYNC_BAD_REQUEST = 2,      // unknown op, context too long or SIG_len is not the signature length
+    ASYNC_ERROR       = 3       // no randomness was available for a randomized signature, SIG is cleared
+};
+
+// Most requests a worker takes from the submission ring at once
+#define ASYNC_BATCH 16
+
+// One pure SLH-DSA operation, the arguments of slh_sign or slh_verify
+// All buffers must stay valid until the completion of the request is reaped
+typedef struct {
+    uint64_t token;             // copied to the completion
+    uint8_t op;
+    uint8_t flags;
+    Parameters *prm;
+    const uint8_t *M;
+    size_t M_len;
+    const uint8_t *ctx;
+    size_t ctx_len;
+    const uint8_t *key;         // SK for signing, PK for verification
+    uint8_t *SIG;               // written when signing, read when verifying
+    size_t SIG_len;
+} AsyncRequest;
+
+typedef struct {
+    uint64_t token;
+    uint32_t status;
+} AsyncCompletion;
+
+// Starts a queue for up to entries requests in flight (rounded up to a power of 2)
+// and the given number of workers, 0 uses one worker per online CPU
+// Returns NULL if memory, the eventfd or the threads could not be set up
+AsyncQueue *async_create(uint32_t entries, uint32_t threads);
+
+// Finishes all submitted requests, then stops the workers and closes the eventfd
+// No request may be submitted while the queue is destroyed
+void async_destroy(AsyncQueue *q);
+
+// Readable while completions are waiting, reading its 8-byte counter clears it
+int async_eventfd(const AsyncQueue *q);
+
+// Puts req on the submission ring, returns false if entries requests are already in flight
+// A request counts as in flight until its completion is reaped
+bool async_submit(AsyncQueue *q, const AsyncRequest *req);
+
+// Takes up to max completions from the completion ring without blocking and returns their number
+size_t async_reap(AsyncQueue *q, AsyncCompletion *out, size_t max);
+
+// Like async_reap, but waits on the eventfd until at least one completion is there
+size_t async_wait(AsyncQueue *q, AsyncCompletion *out, size_t max);
@@ -0,0 +1,821 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adrs.h"
+#include "batch.h"
+#include "external.h"
+#include "internal.h"
+#include "params.h"
+#include "rng.h"
+#include "shake.h"
+#include "shake_x8.h"
+#include "stats.h"
+#include "wots.h"
+#include "xmss.h"
+
+// F, H and Tlen of the SHAKE sets are all SHAKE256(PK.seed || ADRS || M)
+// Hashes count inputs that each have their own PK.seed, input j is M + j * M_len
+static void thash_lanes(Parameters *prm, const uint8_t *const *pk_seed, const ADRS *adrs, const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t count)
+{
+    Segment seg[SHAKE_LANES][3];
+    const Segment *lane_M[SHAKE_LANES];
+    size_t lane_count[SHAKE_LANES];
+    uint8_t *lane_out[SHAKE_LANES];
+
+    for (uint32_t j0 = 0; j0 < count; j0 += SHAKE_LANES) {
+        uint32_t lanes = count - j0 < SHAKE_LANES ? count - j0 : SHAKE_LANES;
+        for (uint32_t j = 0; j < lanes; j++) {
+            seg[j][0] = (Segment) { pk_seed[j0 + j], prm->n };
+            seg[j][1] = (Segment) { adrs[j0 + j].adrs, ADRS_SIZE };
+            seg[j][2] = (Segment) { M + (j0 + j) * M_len, M_len };
+            lane_M[j] = seg[j];
+            lane_count[j] = 3;
+            lane_out[j] = buffer + (j0 + j) * prm->n;
+        }
+        SHAKE_256_x8(lane_M, lane_count, lane_out, prm->n, lanes);
+    }
+}
+
+// Writes node_0 and the authentication path node in the order given by bit, see algorithms 11 and 17
+static void pair_nodes(Parameters *prm, ADRS *adrs, const uint8_t *node_0, const uint8_t *auth, uint64_t bit, uint8_t *pair)
+{
+    if (bit == 0) {
+        setTreeIndex(adrs, getTreeIndex(adrs) / 2);
+        memcpy(pair, node_0, prm->n);
+        memcpy(pair + prm->n, auth, prm->n);
+    } else {
+        setTreeIndex(adrs, (getTreeIndex(adrs) - 1) / 2);
+        memcpy(pair, auth, prm->n);
+        memcpy(pair + prm->n, node_0, prm->n);
+    }
+}
+
+// Algorithm 5 for chains of different items, chain e runs steps[e] steps on tmp + e * n starting at hash address start[e]
+// adrs[e] holds the chain address, the chains are sorted by descending steps like chains() does
+static void chains_lanes(Parameters *prm, const uint8_t *const *pk_seed, const ADRS *adrs, const uint32_t *start, const uint32_t *steps, uint8_t *tmp, uint32_t total)
+{
+    uint32_t n = prm->n;
+    uint32_t order[total];
+    ADRS lane_adrs[total];
+    const uint8_t *lane_seed[total];
+    uint8_t lane_tmp[total * n];
+
+    uint32_t count = 0;
+    for (int64_t s = prm->w - 1; s >= 0; s--) {
+        for (uint32_t e = 0; e < total; e++) {
+            if (steps[e] != s)
+                continue;
+            lane_adrs[count] = adrs[e];
+            lane_seed[count] = pk_seed[e];
+            memcpy(lane_tmp + count * n, tmp + e * n, n);
+            order[count++] = e;
+        }
+    }
+    for (uint32_t j = 0; j < prm->w - 1; j++) {
+        while (count > 0 && steps[order[count - 1]] <= j)
+            count--;
+        if (count == 0)
+            break;
+        for (uint32_t e = 0; e < count; e++)
+            setHashAddress(&lane_adrs[e], start[order[e]] + j);
+        STATS_COUNT(F, count);
+        thash_lanes(prm, lane_seed, lane_adrs, lane_tmp, n, lane_tmp, count);
+    }
+    for (uint32_t e = 0; e < total; e++)
+        memcpy(tmp + order[e] * n, lane_tmp + e * n, n);
+}
+
+// Algorithm 24 for L <= 8 items that passed the length checks, every stage runs for all of them at once
+static void verify_group(Parameters *prm, const VerifyItem *items, const size_t *idx, uint32_t L, bool *results)
+{
+    uint32_t n = prm->n;
+    uint32_t fors_tree_len = (1 + prm->a) * n;
+    uint32_t sig_fors_len = prm->k * fors_tree_len;
+    uint32_t xmss_sig_len = (prm->len + prm->h_) * n;
+
+    const uint8_t *pk_seed[L];
+    const uint8_t *sig_fors[L];
+    const uint8_t *sig_ht[L];
+    uint64_t idx_tree[L];
+    uint64_t idx_leaf[L];
+    uint32_t indices[L * prm->k];
+    ADRS adrs[L];
+    uint8_t node[L * n];
+    uint8_t pair[L * 2 * n];
+
+    // H_msg(R, PK.seed, PK.root, 0x00 || len(ctx) || ctx || M)
+    uint8_t digest[L * prm->m];
+    uint8_t prefix[L][2];
+    Segment seg[L][6];
+    const Segment *lane_M[L];
+    size_t lane_count[L];
+    uint8_t *lane_out[L];
+    for (uint32_t t = 0; t < L; t++) {
+        const VerifyItem *it = &items[idx[t]];
+        pk_seed[t] = it->PK;
+        sig_fors[t] = it->SIG + n;
+        sig_ht[t] = it->SIG + n + sig_fors_len;
+
+        prefix[t][0] = 0;
+        toByte(it->ctx_len, 1, prefix[t] + 1);
+        seg[t][0] = (Segment) { it->SIG, n };
+        seg[t][1] = (Segment) { it->PK, n };
+        seg[t][2] = (Segment) { it->PK + n, n };
+        seg[t][3] = (Segment) { prefix[t], 2 };
+        seg[t][4] = (Segment) { it->ctx, it->ctx_len };
+        seg[t][5] = (Segment) { it->M, it->M_len };
+        lane_M[t] = seg[t];
+        lane_count[t] = 6;
+        lane_out[t] = digest + t * prm->m;
+    }
+    STATS_COUNT(H_msg, L);
+    SHAKE_256_x8(lane_M, lane_count, lane_out, prm->m, L);
+
+    for (uint32_t t = 0; t < L; t++) {
+        uint8_t *d = digest + t * prm->m;
+        split_digest(prm, d, NULL, &idx_tree[t], &idx_leaf[t]);
+        base_2b(d, prm->a, prm->k, indices + t * prm->k);
+    }
+
+    // FORS public keys (algorithm 17), one tree of all items at a time
+    uint8_t roots[L * prm->k * n];
+    for (uint32_t i = 0; i < prm->k; i++) {
+        for (uint32_t t = 0; t < L; t++) {
+            initADRS(&adrs[t]);
+            setTreeAddress(&adrs[t], idx_tree[t]);
+            setTypeAndClear(&adrs[t], prm->FORS_TREE);
+            setKeyPairAddress(&adrs[t], idx_leaf[t]);
+            setTreeHeight(&adrs[t], 0);
+            setTreeIndex(&adrs[t], (i << prm->a) + indices[t * prm->k + i]);
+            memcpy(node + t * n, sig_fors[t] + i * fors_tree_len, n);
+        }
+        STATS_COUNT(F, L);
+        thash_lanes(prm, pk_seed, adrs, node, n, node, L);
+
+        for (uint32_t j = 0; j < prm->a; j++) {
+            for (uint32_t t = 0; t < L; t++) {
+                setTreeHeight(&adrs[t], j + 1);
+                pair_nodes(prm, &adrs[t], node + t * n, sig_fors[t] + i * fors_tree_len + (1 + j) * n,
+                           (indices[t * prm->k + i] >> j) & 1, pair + t * 2 * n);
+            }
+            STATS_COUNT(H, L);
+            thash_lanes(prm, pk_seed, adrs, pair, 2 * n, node, L);
+        }
+        for (uint32_t t = 0; t < L; t++)
+            memcpy(roots + (t * prm->k + i) * n, node + t * n, n);
+    }
+    for (uint32_t t = 0; t < L; t++) {
+        setTypeAndClear(&adrs[t], prm->FORS_ROOTS);
+        setKeyPairAddress(&adrs[t], idx_leaf[t]);
+    }
+    STATS_COUNT(Tlen, L);
+    thash_lanes(prm, pk_seed, adrs, roots, prm->k * n, node, L);
+
+    // hypertree (algorithm 13), node holds the message signed on each layer
+    uint32_t total = L * prm->len;
+    uint32_t msg[total];
+    uint32_t steps[total];
+    ADRS chain_adrs[total];
+    const uint8_t *chain_seed[total];
+    uint8_t ends[total * n];
+
+    for (uint32_t layer = 0; layer < prm->d; layer++) {
+        if (layer > 0) {
+            for (uint32_t t = 0; t < L; t++) {
+                idx_leaf[t] = idx_tree[t] & ((1 << prm->h_) - 1);
+                idx_tree[t] = idx_tree[t] >> prm->h_;
+            }
+        }
+        for (uint32_t t = 0; t < L; t++) {
+            initADRS(&adrs[t]);
+            setLayerAddress(&adrs[t], layer);
+            setTreeAddress(&adrs[t], idx_tree[t]);
+            setTypeAndClear(&adrs[t], prm->WOTS_HASH);
+            setKeyPairAddress(&adrs[t], idx_leaf[t]);
+            wots_digits(prm, node + t * n, msg + t * prm->len);
+        }
+
+        // WOTS+ chains of all items (algorithm 8)
+        for (uint32_t e = 0; e < total; e++) {
+            uint32_t t = e / prm->len;
+            uint32_t c = e % prm->len;
+            chain_adrs[e] = adrs[t];
+            setChainAddress(&chain_adrs[e], c);
+            chain_seed[e] = pk_seed[t];
+            steps[e] = prm->w - 1 - msg[e];
+            memcpy(ends + e * n, sig_ht[t] + layer * xmss_sig_len + c * n, n);
+        }
+        chains_lanes(prm, chain_seed, chain_adrs, msg, steps, ends, total);
+
+        for (uint32_t t = 0; t < L; t++) {
+            setTypeAndClear(&adrs[t], prm->WOTS_PK);
+            setKeyPairAddress(&adrs[t], idx_leaf[t]);
+        }
+        STATS_COUNT(Tlen, L);
+        thash_lanes(prm, pk_seed, adrs, ends, prm->len * n, node, L);
+
+        // XMSS authentication paths (algorithm 11)
+        for (uint32_t t = 0; t < L; t++) {
+            setTypeAndClear(&adrs[t], prm->TREE);
+            setTreeIndex(&adrs[t], idx_leaf[t]);
+        }
+        for (uint32_t k = 0; k < prm->h_; k++) {
+            for (uint32_t t = 0; t < L; t++) {
+                setTreeHeight(&adrs[t], k + 1);
+                pair_nodes(prm, &adrs[t], node + t * n, sig_ht[t] + layer * xmss_sig_len + (prm->len + k) * n,
+                           (idx_leaf[t] >> k) & 1, pair + t * 2 * n);
+            }
+            STATS_COUNT(H, L);
+            thash_lanes(prm, pk_seed, adrs, pair, 2 * n, node, L);
+        }
+    }
+
+    for (uint32_t t = 0; t < L; t++)
+        results[idx[t]] = memcmp(node + t * n, pk_seed[t] + n, n) == 0;
+}
+
+void slh_verify_batch(Parameters *prm, const VerifyItem *items, size_t count, bool *results)
+{
+    uint32_t sig_len = slh_signature_length(prm);
+    size_t group[SHAKE_LANES];
+    uint32_t L = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        results[i] = false;
+        if (items[i].ctx_len > MAX_CTX_LENGTH || items[i].SIG_len != sig_len)
+            continue;
+
+        // the SHA-256 lanes share one PK.seed midstate, so the SHA2 sets verify one item at a time
+        if (prm->sha2) {
+            results[i] = slh_verify(prm, (uint8_t *) items[i].M, items[i].M_len, (uint8_t *) items[i].SIG, items[i].SIG_len,
+                                    (uint8_t *) items[i].ctx, items[i].ctx_len, items[i].PK);
+            continue;
+        }
+
+        group[L++] = i;
+        if (L == SHAKE_LANES) {
+            verify_group(prm, items, group, L, results);
+            L = 0;
+        }
+    }
+    if (L > 0)
+        verify_group(prm, items, group, L, results);
+}
+
+typedef struct {
+    Parameters *prm;
+    const VerifyItem *items;
+    bool *results;
+    size_t count;
+} VerifyBatch;
+
+static void verify_job(void *arg, size_t i)
+{
+    VerifyBatch *batch = arg;
+    size_t first = i * VERIFY_CHUNK;
+    size_t count = batch->count - first < VERIFY_CHUNK ? batch->count - first : VERIFY_CHUNK;
+    slh_verify_batch(batch->prm, batch->items + first, count, batch->results + first);
+}
+
+void slh_verify_batch_pool(Parameters *prm, Pool *pool, const VerifyItem *items, size_t count, bool *results)
+{
+    if (pool == NULL) {
+        slh_verify_batch(prm, items, count, results);
+        return;
+    }
+    VerifyBatch batch = { prm, items, results, count };
+    pool_run(pool, verify_job, &batch, (count + VERIFY_CHUNK - 1) / VERIFY_CHUNK);
+}
+
+// Trees are built in blocks of 2^3 leaves per item, so the leaves of 8 items fill 64 lanes
+#define BLOCK_HEIGHT 3
+
+// State of up to 8 SHAKE signatures that run in lockstep
+typedef struct {
+    uint32_t L;
+    const uint8_t *sk_seed[SHAKE_LANES];
+    const uint8_t *pk_seed[SHAKE_LANES];
+    uint64_t idx_tree[SHAKE_LANES];
+    uint64_t idx_leaf[SHAKE_LANES];
+    uint32_t layer;
+} SignGroup;
+
+// Computes leaves [first, first + count) of tree number `tree` of all items, leaf x of item t goes to nodes + (t * count + x) * n
+typedef void (*LeafFn)(Parameters *prm, const SignGroup *g, uint32_t tree, uint64_t first, uint32_t count, uint8_t *nodes);
+
+// Address of item t on the current layer with the given type and key pair address
+static ADRS group_adrs(Parameters *prm, const SignGroup *g, uint32_t t, uint32_t type, uint64_t keypair)
+{
+    ADRS adrs;
+    initADRS(&adrs);
+    setLayerAddress(&adrs, g->layer);
+    setTreeAddress(&adrs, g->idx_tree[t]);
+    setTypeAndClear(&adrs, type);
+    setKeyPairAddress(&adrs, keypair);
+    return adrs;
+}
+
+// FORS leaves F(PRF(SK.seed)), see algorithms 14 and 15
+static void fors_leaves(Parameters *prm, const SignGroup *g, uint32_t tree, uint64_t first, uint32_t count, uint8_t *nodes)
+{
+    uint32_t n = prm->n;
+    uint32_t total = g->L * count;
+    ADRS adrs[total];
+    const uint8_t *seed[total];
+
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t t = e / count;
+        adrs[e] = group_adrs(prm, g, t, prm->FORS_PRF, g->idx_leaf[t]);
+        setTreeIndex(&adrs[e], ((uint64_t) tree << prm->a) + first + e % count);
+        seed[e] = g->pk_seed[t];
+        memcpy(nodes + e * n, g->sk_seed[t], n);
+    }
+    STATS_COUNT(PRF, total);
+    thash_lanes(prm, seed, adrs, nodes, n, nodes, total);
+
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t t = e / count;
+        adrs[e] = group_adrs(prm, g, t, prm->FORS_TREE, g->idx_leaf[t]);
+        setTreeHeight(&adrs[e], 0);
+        setTreeIndex(&adrs[e], ((uint64_t) tree << prm->a) + first + e % count);
+    }
+    STATS_COUNT(F, total);
+    thash_lanes(prm, seed, adrs, nodes, n, nodes, total);
+}
+
+// XMSS leaves are WOTS+ public keys (algorithm 6), all chains run w - 1 steps so they stay in lockstep
+static void xmss_leaves(Parameters *prm, const SignGroup *g, uint32_t tree, uint64_t first, uint32_t count, uint8_t *nodes)
+{
+    uint32_t n = prm->n;
+    uint32_t leaves = g->L * count;
+    uint32_t total = leaves * prm->len;
+    ADRS adrs[total];
+    const uint8_t *seed[total];
+    uint8_t tmp[total * n];
+
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t leaf = e / prm->len;
+        uint32_t t = leaf / count;
+        adrs[e] = group_adrs(prm, g, t, prm->WOTS_PRF, first + leaf % count);
+        setChainAddress(&adrs[e], e % prm->len);
+        seed[e] = g->pk_seed[t];
+        memcpy(tmp + e * n, g->sk_seed[t], n);
+    }
+    STATS_COUNT(PRF, total);
+    thash_lanes(prm, seed, adrs, tmp, n, tmp, total);
+
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t leaf = e / prm->len;
+        adrs[e] = group_adrs(prm, g, leaf / count, prm->WOTS_HASH, first + leaf % count);
+        setChainAddress(&adrs[e], e % prm->len);
+    }
+    for (uint32_t j = 0; j < prm->w - 1; j++) {
+        for (uint32_t e = 0; e < total; e++)
+            setHashAddress(&adrs[e], j);
+        STATS_COUNT(F, total);
+        thash_lanes(prm, seed, adrs, tmp, n, tmp, total);
+    }
+
+    for (uint32_t leaf = 0; leaf < leaves; leaf++) {
+        uint32_t t = leaf / count;
+        adrs[leaf] = group_adrs(prm, g, t, prm->WOTS_PK, first + leaf % count);
+        seed[leaf] = g->pk_seed[t];
+    }
+    STATS_COUNT(Tlen, leaves);
+    thash_lanes(prm, seed, adrs, tmp, prm->len * n, nodes, leaves);
+}
+
+// Copies the authentication path nodes out of count nodes at height j (the first has index first),
+// then replaces the nodes by their count / 2 parents. The nodes of item t are at nodes + t * count * n
+static void tree_level(Parameters *prm, const SignGroup *g, uint32_t tree, uint32_t height, const ADRS *adrs, const uint64_t *leaf,
+                       uint8_t *const *auth, uint32_t j, uint64_t first, uint32_t count, uint8_t *nodes)
+{
+    uint32_t n = prm->n;
+    uint32_t total = g->L * (count / 2);
+    ADRS pair_adrs[total];
+    const uint8_t *seed[total];
+    uint8_t parents[total * n];
+
+    for (uint32_t t = 0; t < g->L && auth != NULL; t++) {
+        uint64_t sibling = (leaf[t] >> j) ^ 1;
+        if (sibling >= first && sibling < first + count)
+            memcpy(auth[t] + j * n, nodes + (t * count + sibling - first) * n, n);
+    }
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t t = e / (count / 2);
+        pair_adrs[e] = adrs[t];
+        setTreeHeight(&pair_adrs[e], j + 1);
+        setTreeIndex(&pair_adrs[e], ((uint64_t) tree << (height - j - 1)) + first / 2 + e % (count / 2));
+        seed[e] = g->pk_seed[t];
+    }
+    STATS_COUNT(H, total);
+    thash_lanes(prm, seed, pair_adrs, nodes, 2 * n, parents, total);
+    memcpy(nodes, parents, total * n);
+}
+
+// Root and authentication path of one tree of every item, algorithms 15 and 16 for FORS or 9 and 10 for XMSS
+// adrs[t] is the node address of item t, leaf[t] the leaf whose path goes to auth[t] (auth may be NULL), the roots go to root + t * n
+static void tree_lanes(Parameters *prm, const SignGroup *g, LeafFn leaves, uint32_t tree, uint32_t height, const ADRS *adrs,
+                       const uint64_t *leaf, uint8_t *const *auth, uint8_t *root)
+{
+    uint32_t n = prm->n;
+    uint32_t c = height < BLOCK_HEIGHT ? height : BLOCK_HEIGHT;
+    uint32_t block = 1u << c;
+    uint32_t blocks = 1u << (height - c);
+    uint8_t nodes[g->L * block * n];
+    uint8_t tops[g->L * blocks * n];
+
+    for (uint32_t b = 0; b < blocks; b++) {
+        leaves(prm, g, tree, (uint64_t) b * block, block, nodes);
+        for (uint32_t j = 0; j < c; j++)
+            tree_level(prm, g, tree, height, adrs, leaf, auth, j, (uint64_t) b * (block >> j), block >> j, nodes);
+        for (uint32_t t = 0; t < g->L; t++)
+            memcpy(tops + (t * blocks + b) * n, nodes + t * n, n);
+    }
+    for (uint32_t j = c; j < height; j++)
+        tree_level(prm, g, tree, height, adrs, leaf, auth, j, 0, blocks >> (j - c), tops);
+    memcpy(root, tops, g->L * n);
+}
+
+// Node i of height z in a top tree from slh_expand_key
+static const uint8_t *top_node(Parameters *prm, const uint8_t *top, uint32_t z, uint64_t i)
+{
+    uint64_t level = (2ull << prm->h_) - (2ull << (prm->h_ - z));
+    return top + (level + i) * prm->n;
+}
+
+// Algorithm 19 for L <= 8 SHAKE items, every stage runs for all of them at once
+// The tree roots come out of the tree computations, so unlike slh_sign no public key is recomputed from a signature
+static void sign_group(Parameters *prm, const SignItem *items, const size_t *idx, uint32_t L, const uint8_t *addrnd)
+{
+    uint32_t n = prm->n;
+    uint32_t fors_tree_len = (1 + prm->a) * n;
+    uint32_t sig_fors_len = prm->k * fors_tree_len;
+    uint32_t xmss_sig_len = (prm->len + prm->h_) * n;
+
+    SignGroup g;
+    g.L = L;
+    g.layer = 0;
+    uint8_t *sig_fors[L];
+    uint8_t *sig_ht[L];
+
+    // R = PRF_msg(SK.prf, addrnd, M'), then H_msg(R, PK.seed, PK.root, M') with M' = 0x00 || len(ctx) || ctx || M
+    uint8_t digest[L * prm->m];
+    uint8_t prefix[L][2];
+    Segment seg[L][5];
+    const Segment *lane_M[L];
+    size_t lane_count[L];
+    uint8_t *lane_out[L];
+    for (uint32_t t = 0; t < L; t++) {
+        const SignItem *it = &items[idx[t]];
+        g.sk_seed[t] = it->SK;
+        g.pk_seed[t] = it->SK + 2 * n;
+        sig_fors[t] = it->SIG + n;
+        sig_ht[t] = it->SIG + n + sig_fors_len;
+
+        prefix[t][0] = 0;
+        toByte(it->ctx_len, 1, prefix[t] + 1);
+        seg[t][0] = (Segment) { it->SK + n, n };
+        seg[t][1] = (Segment) { addrnd + t * n, n };
+        seg[t][2] = (Segment) { prefix[t], 2 };
+        seg[t][3] = (Segment) { it->ctx, it->ctx_len };
+        seg[t][4] = (Segment) { it->M, it->M_len };
+        lane_M[t] = seg[t];
+        lane_count[t] = 5;
+        lane_out[t] = it->SIG;
+    }
+    STATS_COUNT(PRF_msg, L);
+    SHAKE_256_x8(lane_M, lane_count, lane_out, n, L);
+
+    for (uint32_t t = 0; t < L; t++) {
+        seg[t][0] = (Segment) { items[idx[t]].SIG, n };
+        seg[t][1] = (Segment) { g.pk_seed[t], 2 * n };    // PK.seed || PK.root
+        lane_out[t] = digest + t * prm->m;
+    }
+    STATS_COUNT(H_msg, L);
+    SHAKE_256_x8(lane_M, lane_count, lane_out, prm->m, L);
+
+    uint32_t indices[L * prm->k];
+    for (uint32_t t = 0; t < L; t++) {
+        uint8_t *d = digest + t * prm->m;
+        split_digest(prm, d, NULL, &g.idx_tree[t], &g.idx_leaf[t]);
+        base_2b(d, prm->a, prm->k, indices + t * prm->k);
+    }
+
+    // FORS secret values of the signed leaves (algorithm 14)
+    uint32_t total = L * prm->k;
+    ADRS sk_adrs[total];
+    const uint8_t *seed[total];
+    uint8_t sk[total * n];
+    for (uint32_t e = 0; e < total; e++) {
+        uint32_t t = e / prm->k;
+        sk_adrs[e] = group_adrs(prm, &g, t, prm->FORS_PRF, g.idx_leaf[t]);
+        setTreeIndex(&sk_adrs[e], ((uint64_t) (e % prm->k) << prm->a) + indices[e]);
+        seed[e] = g.pk_seed[t];
+        memcpy(sk + e * n, g.sk_seed[t], n);
+    }
+    STATS_COUNT(PRF, total);
+    thash_lanes(prm, seed, sk_adrs, sk, n, sk, total);
+    for (uint32_t e = 0; e < total; e++)
+        memcpy(sig_fors[e / prm->k] + (e % prm->k) * fors_tree_len, sk + e * n, n);
+
+    // FORS trees (algorithms 15 and 16) and the FORS public key from their roots
+    ADRS adrs[L];
+    uint64_t leaf[L];
+    uint8_t *auth[L];
+    uint8_t roots[L * prm->k * n];
+    uint8_t node[L * n];
+    for (uint32_t t = 0; t < L; t++)
+        adrs[t] = group_adrs(prm, &g, t, prm->FORS_TREE, g.idx_leaf[t]);
+    for (uint32_t i = 0; i < prm->k; i++) {
+        for (uint32_t t = 0; t < L; t++) {
+            leaf[t] = indices[t * prm->k + i];
+            auth[t] = sig_fors[t] + i * fors_tree_len + n;
+        }
+        tree_lanes(prm, &g, fors_leaves, i, prm->a, adrs, leaf, auth, node);
+        for (uint32_t t = 0; t < L; t++)
+            memcpy(roots + (t * prm->k + i) * n, node + t * n, n);
+    }
+    for (uint32_t t = 0; t < L; t++)
+        adrs[t] = group_adrs(prm, &g, t, prm->FORS_ROOTS, g.idx_leaf[t]);
+    STATS_COUNT(Tlen, L);
+    thash_lanes(prm, g.pk_seed, adrs, roots, prm->k * n, node, L);
+
+    // hypertree (algorithm 12), node holds the message signed on each layer
+    total = L * prm->len;
+    uint32_t msg[total];
+    uint32_t start[total];
+    ADRS chain_adrs[total];
+    const uint8_t *chain_seed[total];
+    uint8_t tmp[total * n];
+    memset(start, 0, sizeof start);
+
+    for (uint32_t layer = 0; layer < prm->d; layer++) {
+        if (layer > 0) {
+            for (uint32_t t = 0; t < L; t++) {
+                g.idx_leaf[t] = g.idx_tree[t] & ((1 << prm->h_) - 1);
+                g.idx_tree[t] = g.idx_tree[t] >> prm->h_;
+            }
+        }
+        g.layer = layer;
+
+        // WOTS+ signatures (algorithm 7)
+        for (uint32_t t = 0; t < L; t++)
+            wots_digits(prm, node + t * n, msg + t * prm->len);
+        for (uint32_t e = 0; e < total; e++) {
+            uint32_t t = e / prm->len;
+            chain_adrs[e] = group_adrs(prm, &g, t, prm->WOTS_PRF, g.idx_leaf[t]);
+            setChainAddress(&chain_adrs[e], e % prm->len);
+            chain_seed[e] = g.pk_seed[t];
+            memcpy(tmp + e * n, g.sk_seed[t], n);
+        }
+        STATS_COUNT(PRF, total);
+        thash_lanes(prm, chain_seed, chain_adrs, tmp, n, tmp, total);
+        for (uint32_t e = 0; e < total; e++) {
+            uint32_t t = e / prm->len;
+            chain_adrs[e] = group_adrs(prm, &g, t, prm->WOTS_HASH, g.idx_leaf[t]);
+            setChainAddress(&chain_adrs[e], e % prm->len);
+        }
+        chains_lanes(prm, chain_seed, chain_adrs, start, msg, tmp, total);
+        for (uint32_t t = 0; t < L; t++)
+            memcpy(sig_ht[t] + layer * xmss_sig_len, tmp + t * prm->len * n, prm->len * n);
+
+        // XMSS tree (algorithms 9 and 10), its root is signed on the next layer
+        bool cached = layer == prm->d - 1;
+        for (uint32_t t = 0; t < L; t++) {
+            adrs[t] = group_adrs(prm, &g, t, prm->TREE, 0);
+            leaf[t] = g.idx_leaf[t];
+            auth[t] = sig_ht[t] + layer * xmss_sig_len + prm->len * n;
+            cached &= items[idx[t]].top != NULL;
+        }
+        if (cached) {
+            for (uint32_t t = 0; t < L; t++) {
+                for (uint32_t j = 0; j < prm->h_; j++)
+                    memcpy(auth[t] + j * n, top_node(prm, items[idx[t]].top, j, (leaf[t] >> j) ^ 1), n);
+            }
+            break;
+        }
+        tree_lanes(prm, &g, xmss_leaves, 0, prm->h_, adrs, leaf, auth, node);
+    }
+}
+
+typedef struct {
+    Parameters *prm;
+    const SignItem *items;
+    size_t count;
+    bool deterministic;
+    bool *ok;
+} SignBatch;
+
+// addrnd of an item as slh_sign picks it, returns false (and clears SIG) if ctx is too long or no randomness was available
+static bool item_addrnd(Parameters *prm, const SignItem *it, bool deterministic, uint8_t *addrnd)
+{
+    bool ok = it->ctx_len <= MAX_CTX_LENGTH;
+    // for deterministic varaiant, use PK_seed for addrnd
+    if (ok && deterministic)
+        memcpy(addrnd, it->SK + 2 * prm->n, prm->n);
+    else if (ok)
+        ok = random_bytes(addrnd, prm->n);
+    if (!ok)
+        memset(it->SIG, 0, slh_signature_length(prm));
+    return ok;
+}
+
+// Signs item i for the SHA2 sets, or the group of items [8 * i, 8 * i + 8) in lockstep for the SHAKE sets
+static void sign_job(void *arg, size_t i)
+{
+    SignBatch *batch = arg;
+    Parameters *prm = batch->prm;
+    uint8_t addrnd[SHAKE_LANES * prm->n];
+
+    if (prm->sha2) {
+        const SignItem *it = &batch->items[i];
+        bool ok = item_addrnd(prm, it, batch->deterministic, addrnd);
+        if (ok)
+            slh_sign_addrnd(prm, it->M, it->M_len, it->ctx, it->ctx_len, it->SK, addrnd, it->SIG);
+        if (batch->ok != NULL)
+            batch->ok[i] = ok;
+        return;
+    }
+
+    size_t group[SHAKE_LANES];
+    uint32_t L = 0;
+    for (size_t j = i * SHAKE_LANES; j < batch->count && j < (i + 1) * SHAKE_LANES; j++) {
+        bool ok = item_addrnd(prm, &batch->items[j], batch->deterministic, addrnd + L * prm->n);
+        if (ok)
+            group[L++] = j;
+        if (batch->ok != NULL)
+            batch->ok[j] = ok;
+    }
+    if (L > 0)
+        sign_group(prm, batch->items, group, L, addrnd);
+}
+
+void slh_sign_batch(Parameters *prm, Pool *pool, const SignItem *items, size_t count, bool deterministic, bool *ok)
+{
+    SignBatch batch = { prm, items, count, deterministic, ok };
+    size_t jobs = prm->sha2 ? count : (count + SHAKE_LANES - 1) / SHAKE_LANES;
+
+    if (pool == NULL) {
+        for (size_t i = 0; i < jobs; i++)
+            sign_job(&batch, i);
+        return;
+    }
+    pool_run(pool, sign_job, &batch, jobs);
+}
+
+size_t slh_top_tree_size(Parameters *prm)
+{
+    return ((2ull << prm->h_) - 1) * prm->n;
+}
+
+typedef struct {
+    Parameters *prm;
+    const uint8_t *SK;
+    uint8_t *top;
+} ExpandKey;
+
+// Leaf i of the top tree, a WOTS+ public key on layer d - 1
+static void expand_job(void *arg, size_t i)
+{
+    ExpandKey *key = arg;
+    Parameters *prm = key->prm;
+    ADRS adrs;
+    initADRS(&adrs);
+    setLayerAddress(&adrs, prm->d - 1);
+    xmss_node(prm, key->SK, i, 0, key->SK + 2 * prm->n, adrs, key->top + i * prm->n);
+}
+
+bool slh_expand_key(Parameters *prm, Pool *pool, const uint8_t *SK, uint8_t *top)
+{
+    uint32_t n = prm->n;
+    uint64_t leaves = 1ull << prm->h_;
+    ExpandKey key = { prm, SK, top };
+    if (pool == NULL) {
+        for (uint64_t i = 0; i < leaves; i++)
+            expand_job(&key, i);
+    } else {
+        pool_run(pool, expand_job, &key, leaves);
+    }
+
+    ADRS adrs;
+    initADRS(&adrs);
+    setLayerAddress(&adrs, prm->d - 1);
+    setTypeAndClear(&adrs, prm->TREE);
+    for (uint32_t z = 1; z <= prm->h_; z++) {
+        setTreeHeight(&adrs, z);
+        for (uint64_t i = 0; i < leaves >> z; i++) {
+            setTreeIndex(&adrs, i);
+            H(prm, SK + 2 * n, &adrs, top_node(prm, top, z - 1, 2 * i), (uint8_t *) top_node(prm, top, z, i));
+        }
+    }
+    return memcmp(top_node(prm, top, prm->h_, 0), SK + 3 * n, n) == 0;
+}
+
+// SK.seed || SK.prf || PK.seed of key number index
+static void keygen_seeds(Parameters *prm, const uint8_t *master_seed, size_t seed_len, uint64_t index, uint8_t *seeds)
+{
+    uint8_t idx[8];
+    toByte(index, 8, idx);
+
+    SHAKE_256_CTX ctx;
+    SHAKE_256_init(&ctx);
+    SHAKE_256_update(&ctx, master_seed, seed_len);
+    SHAKE_256_update(&ctx, idx, sizeof idx);
+    SHAKE_256_final(&ctx, seeds, 3 * prm->n);
+}
+
+typedef struct {
+    Parameters *prm;
+    const uint8_t *master_seed;
+    size_t seed_len;
+    uint64_t first;
+    size_t count;
+    uint8_t *SK;
+    uint8_t *PK;
+} KeygenBatch;
+
+// Algorithm 18 for the keys [8 * i, 8 * i + 8) of the batch, the top XMSS trees of the SHAKE sets are built in lockstep
+static void keygen_job(void *arg, size_t i)
+{
+    KeygenBatch *batch = arg;
+    Parameters *prm = batch->prm;
+    uint32_t n = prm->n;
+
+    size_t j0 = i * SHAKE_LANES;
+    uint32_t L = batch->count - j0 < SHAKE_LANES ? batch->count - j0 : SHAKE_LANES;
+    uint8_t seeds[L * 3 * n];
+    for (uint32_t t = 0; t < L; t++)
+        keygen_seeds(prm, batch->master_seed, batch->seed_len, batch->first + j0 + t, seeds + t * 3 * n);
+
+    if (prm->sha2) {
+        for (uint32_t t = 0; t < L; t++) {
+            uint8_t *s = seeds + t * 3 * n;
+            slh_keygen_internal(prm, s, s + n, s + 2 * n, batch->SK + (j0 + t) * 4 * n, batch->PK + (j0 + t) * 2 * n);
+        }
+        return;
+    }
+
+    SignGroup g;
+    g.L = L;
+    g.layer = prm->d - 1;
+    ADRS adrs[L];
+    uint64_t leaf[L];
+    uint8_t root[L * n];
+    for (uint32_t t = 0; t < L; t++) {
+        g.sk_seed[t] = seeds + t * 3 * n;
+        g.pk_seed[t] = seeds + t * 3 * n + 2 * n;
+        g.idx_tree[t] = 0;
+        g.idx_leaf[t] = 0;
+        adrs[t] = group_adrs(prm, &g, t, prm->TREE, 0);
+        leaf[t] = 0;
+    }
+    tree_lanes(prm, &g, xmss_leaves, 0, prm->h_, adrs, leaf, NULL, root);
+
+    for (uint32_t t = 0; t < L; t++) {
+        uint8_t *SK = batch->SK + (j0 + t) * 4 * n;
+        uint8_t *PK = batch->PK + (j0 + t) * 2 * n;
+        memcpy(SK, seeds + t * 3 * n, 3 * n);
+        memcpy(SK + 3 * n, root + t * n, n);
+        memcpy(PK, seeds + t * 3 * n + 2 * n, n);
+        memcpy(PK + n, root + t * n, n);
+    }
+}
+
+void slh_keygen_batch(Parameters *prm, Pool *pool, const uint8_t *master_seed, size_t seed_len, uint64_t first, size_t count, uint8_t *SK, uint8_t *PK)
+{
+    KeygenBatch batch = { prm, master_seed, seed_len, first, count, SK, PK };
+    size_t jobs = (count + SHAKE_LANES - 1) / SHAKE_LANES;
+
+    if (pool == NULL) {
+        for (size_t i = 0; i < jobs; i++)
+            keygen_job(&batch, i);
+        return;
+    }
+    pool_run(pool, keygen_job, &batch, jobs);
+}
+
+bool slh_keygen_batch_file(Parameters *prm, Pool *pool, const uint8_t *master_seed, size_t seed_len, uint64_t first, size_t count, FILE *out)
+{
+    uint32_t n = prm->n;
+    uint8_t *SK = malloc(KEYGEN_CHUNK * 4 * n);
+    uint8_t *PK = malloc(KEYGEN_CHUNK * 2 * n);
+    bool ok = SK != NULL && PK != NULL;
+
+    for (size_t done = 0; ok && done < count; done += KEYGEN_CHUNK) {
+        size_t chunk = count - done < KEYGEN_CHUNK ? count - done : KEYGEN_CHUNK;
+        slh_keygen_batch(prm, pool, master_seed, seed_len, first + done, chunk, SK, PK);
+        for (size_t i = 0; ok && i < chunk; i++) {
+            ok = fwrite(SK + i * 4 * n, 4 * n, 1, out) == 1
+              && fwrite(PK + i * 2 * n, 2 * n, 1, out) == 1;
+        }
+    }
+    if (!ok)
+        printf("Error writing key pairs\n");
+
+    free(SK);
+    free(PK);
+    return ok;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "params.h"
+#include "pool.h"
+
+// One signature for slh_verify_batch, the fields are the arguments of slh_verify
+typedef struct {
+    const uint8_t *M;
+    size_t M_len;
+    const uint8_t *SIG;
+    size_t SIG_len;
+    const uint8_t *ctx;
+    size_t ctx_len;
+    const uint8_t *PK;
+} VerifyItem;
+
+// Number of signatures one worker of slh_verify_batch_pool verifies at a time, one lockstep group
+#define VERIFY_CHUNK 8
+
+// Verifies count pure SLH-DSA signatures, results[i] is what slh_verify returns for items[i]
+// For the SHAKE sets, up to 8 verifications run interleaved on the multi-buffer Keccak
+void slh_verify_batch(Parameters *prm, const VerifyItem *items, size_t count, bool *results);
+
+// Like slh_verify_batch, with chunks of VERIFY_CHUNK items spread over the workers of pool (or in the calling thread if pool is NULL)
+void slh_verify_batch_pool(Parameters *prm, Pool *pool, const VerifyItem *items, size_t count, bool *results);
+
+// One message for slh_sign_batch, SIG receives the signature
+// top is optional, the nodes of the key's top XMSS tree from slh_expand_key
+typedef struct {
+    const uint8_t *M;
+    size_t M_len;
+    const uint8_t *ctx;
+    size_t ctx_len;
+    const uint8_t *SK;
+    uint8_t *SIG;
+    const uint8_t *top;
+} SignItem;
+
+// Signs count messages like slh_sign, spread over the workers of pool (or in the calling thread if pool is NULL)
+// For the SHAKE sets, groups of up to 8 signatures run interleaved on the multi-buffer Keccak
+// Every item writes only its own SIG, so the output is the same as signing the items one after another
+// ok[i] (if ok is not NULL) is false if items[i] has a too long ctx or no randomness was available, its SIG is then cleared
+void slh_sign_batch(Parameters *prm, Pool *pool, const SignItem *items, size_t count, bool deterministic, bool *ok);
+
+// Number of bytes of the top XMSS tree of a key, (2^(h' + 1) - 1) * n
+size_t slh_top_tree_size(Parameters *prm);
+
+// Computes every node of the top XMSS tree of SK, which is the same for all signatures of the key
+// Nodes of height z are stored after those of height z - 1, leaves first, the root last
+// With it, the SHAKE lockstep signer copies the top layer's authentication paths instead of rebuilding the tree
+// Returns false if the root differs from PK.root in SK
+bool slh_expand_key(Parameters *prm, Pool *pool, const uint8_t *SK, uint8_t *top);
+
+// Number of keys slh_keygen_batch_file generates before writing them out
+#define KEYGEN_CHUNK 1024
+
+// Generates the keys first, ..., first + count - 1 of a master seed, SK and PK of the i-th key go to SK + 4 * n * i and PK + 2 * n * i
+// Key number index is slh_keygen_internal on SK.seed || SK.prf || PK.seed = SHAKE256(master_seed || toByte(index, 8), 3 * n)
+// For the SHAKE sets, the top XMSS trees of up to 8 keys are built in lockstep on the multi-buffer Keccak
+void slh_keygen_batch(Parameters *prm, Pool *pool, const uint8_t *master_seed, size_t seed_len, uint64_t first, size_t count, uint8_t *SK, uint8_t *PK);
+
+// Like slh_keygen_batch, but writes SK || PK of every key to out in index order
+// Returns false if writing failed
+bool slh_keygen_batch_file(Parameters *prm, Pool *pool, const uint8_t *master_seed, size_t seed_len, uint64_t first, size_t count, FILE *out);
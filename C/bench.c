@@ -0,0 +1,495 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "adrs.h"
+#include "batch.h"
+#include "external.h"
+#include "fors.h"
+#include "internal.h"
+#include "nodepool.h"
+#include "nodes.h"
+#include "params.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "shake.h"
+#include "shard.h"
+#include "stats.h"
+#include "timing.h"
+#include "wots.h"
+#include "xmss.h"
+
+// A sample lasts at least this long, short operations are repeated inside one sample
+#define MIN_SAMPLE_NS 20000
+
+// Messages in one sign call of the thread scaling sweep, per thread
+#define SWEEP_MESSAGES 8
+
+// Gap between two verifications of the loaded scheduler benchmark
+#define LOADED_GAP_US 2000
+
+#define MSG_LEN 32
+
+// Everything the benchmarked operations work on, for one parameter set
+typedef struct {
+    Parameters *prm;
+    uint8_t *SK;
+    uint8_t *PK;
+    uint8_t *SIG;
+    uint32_t sig_len;
+    uint8_t M[MSG_LEN];
+    uint8_t ctx[8];
+    uint8_t node[2 * 32];
+    uint8_t chain_in[67 * 32];
+    ADRS adrs;
+    Pool *pool;
+    SignItem *items;
+    uint32_t items_count;
+    NodePool *np;
+    NodeKey **keys;
+    ShardPool *shards;
+} Bench;
+
+typedef struct {
+    uint32_t samples;
+    double median_ns;
+    double p99_ns;
+    double median_cycles;
+    double ops_per_sec;
+} Result;
+
+static FILE *json;
+static bool json_first = true;
+static bool stats_failed;
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Times samples calls of op, each call handles items operations (for ops/sec)
+// Cycles are TSC ticks, which run at the nominal clock and not the turbo clock
+static Result measure(void (*op)(Bench *), Bench *b, uint32_t samples, uint32_t items)
+{
+    // one warm-up call, which also tells how many calls fill a sample
+    uint64_t start = now_ns();
+    op(b);
+    uint64_t once = now_ns() - start;
+    uint32_t reps = once >= MIN_SAMPLE_NS ? 1 : MIN_SAMPLE_NS / (once + 1) + 1;
+
+    double ns[samples];
+    double cycles[samples];
+    for (uint32_t s = 0; s < samples; s++) {
+        uint64_t t0 = now_ns();
+        uint64_t c0 = __rdtsc();
+        for (uint32_t r = 0; r < reps; r++)
+            op(b);
+        cycles[s] = (double) (__rdtsc() - c0) / reps;
+        ns[s] = (double) (now_ns() - t0) / reps;
+    }
+    qsort(ns, samples, sizeof ns[0], compare_double);
+    qsort(cycles, samples, sizeof cycles[0], compare_double);
+
+    Result r;
+    r.samples = samples;
+    r.median_ns = ns[samples / 2];
+    r.p99_ns = ns[(samples * 99 - 1) / 100];
+    r.median_cycles = cycles[samples / 2];
+    r.ops_per_sec = items * 1e9 / r.median_ns;
+    return r;
+}
+
+static void report(const char *set, const char *op, uint32_t threads, Result r)
+{
+    printf("%-20s %-22s %3u %12.1f %12.1f %14.0f %12.1f\n", set, op, threads,
+           r.median_ns / 1000, r.p99_ns / 1000, r.median_cycles, r.ops_per_sec);
+
+    if (json == NULL)
+        return;
+    fprintf(json, "%s  {\"set\": \"%s\", \"op\": \"%s\", \"threads\": %u, \"samples\": %u, "
+                  "\"median_ns\": %.0f, \"p99_ns\": %.0f, \"median_cycles\": %.0f, \"ops_per_sec\": %.2f}",
+            json_first ? "" : ",\n", set, op, threads, r.samples, r.median_ns, r.p99_ns, r.median_cycles, r.ops_per_sec);
+    json_first = false;
+}
+
+static void op_keygen(Bench *b)
+{
+    uint32_t n = b->prm->n;
+    uint8_t sk_seed[n];
+    uint8_t sk_prf[n];
+    uint8_t pk_seed[n];
+    // all zero seeds make slh_keygen draw random ones
+    memset(sk_seed, 0, n);
+    memset(sk_prf, 0, n);
+    memset(pk_seed, 0, n);
+    slh_keygen(b->prm, sk_seed, sk_prf, pk_seed, b->SK, b->PK);
+}
+
+static void op_sign(Bench *b)
+{
+    slh_sign(b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, b->SK, b->SIG, true);
+}
+
+static void op_sign_randomized(Bench *b)
+{
+    slh_sign(b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, b->SK, b->SIG, false);
+}
+
+static void op_sign_sharded(Bench *b)
+{
+    if (!shard_sign(b->shards, b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, b->SK, b->SIG, true))
+        printf("Sharded signing failed\n");
+}
+
+static void op_verify(Bench *b)
+{
+    if (!slh_verify(b->prm, b->M, MSG_LEN, b->SIG, b->sig_len, b->ctx, sizeof b->ctx, b->PK))
+        printf("Verification failed\n");
+}
+
+static void op_hash_sign(Bench *b)
+{
+    hash_slh_sign(b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, PH_SHA_256, b->SK, b->SIG, true);
+}
+
+static void op_hash_sign_randomized(Bench *b)
+{
+    hash_slh_sign(b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, PH_SHA_256, b->SK, b->SIG, false);
+}
+
+static void op_hash_verify(Bench *b)
+{
+    if (!hash_slh_verify(b->prm, b->M, MSG_LEN, b->SIG, b->sig_len, b->ctx, sizeof b->ctx, PH_SHA_256, b->PK))
+        printf("Verification failed\n");
+}
+
+static void op_F(Bench *b)
+{
+    F(b->prm, b->PK, &b->adrs, b->node, b->node);
+}
+
+static void op_H(Bench *b)
+{
+    H(b->prm, b->PK, &b->adrs, b->node, b->node);
+}
+
+static void op_PRF(Bench *b)
+{
+    PRF(b->prm, b->PK, &b->adrs, b->SK, b->node);
+}
+
+static void op_Tlen(Bench *b)
+{
+    Tlen(b->prm, b->PK, &b->adrs, b->chain_in, b->prm->len * b->prm->n, b->node);
+}
+
+static void op_chain(Bench *b)
+{
+    chain(b->prm, b->node, 0, b->prm->w - 1, b->PK, &b->adrs, b->node);
+}
+
+static void op_wots_pkGen(Bench *b)
+{
+    wots_pkGen(b->prm, b->SK, b->PK, b->adrs, b->node);
+}
+
+static void op_xmss_node(Bench *b)
+{
+    xmss_node(b->prm, b->SK, 0, b->prm->h_, b->PK, b->adrs, b->node);
+}
+
+static void op_fors_node(Bench *b)
+{
+    fors_node(b->prm, b->SK, 0, b->prm->a, b->PK, b->adrs, b->node);
+}
+
+static void op_sign_batch(Bench *b)
+{
+    slh_sign_batch(b->prm, b->pool, b->items, b->items_count, true, NULL);
+}
+
+static void op_sign_nodes(Bench *b)
+{
+    nodepool_sign_batch(b->np, b->prm, b->items, b->keys, b->items_count, true, NULL);
+}
+
+// Signing load for bench_loaded: every finished signature is submitted again until stop is set
+typedef struct {
+    Sched *sched;
+    SchedJob job;
+    atomic_bool *stop;
+} SignLoad;
+
+static void sign_load_done(void *arg, bool result)
+{
+    SignLoad *load = arg;
+    (void) result;
+    if (!atomic_load(load->stop))
+        sched_submit(load->sched, &load->job);
+}
+
+static void verify_done(void *arg, bool result)
+{
+    if (!result)
+        printf("Verification failed\n");
+    atomic_store((_Atomic uint64_t *) arg, now_ns());
+}
+
+// Latency of single verifications while all workers of the scheduler are busy signing
+static Result measure_loaded(Bench *b, uint32_t threads, uint32_t samples)
+{
+    op_sign(b);
+    Sched *sched = sched_create(threads, NULL);
+    if (sched == NULL)
+        return (Result) { 0 };
+
+    // two signatures per worker, so a signing slice is always waiting
+    uint32_t loads = 2 * threads;
+    SignLoad load[loads];
+    uint8_t *sigs = malloc((size_t) loads * b->sig_len);
+    atomic_bool stop = false;
+    for (uint32_t i = 0; i < loads; i++) {
+        load[i] = (SignLoad) { sched, { SCHED_SIGN, b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, b->SK,
+                                        sigs + (size_t) i * b->sig_len, b->sig_len, NULL, sign_load_done, &load[i] }, &stop };
+        sched_submit(sched, &load[i].job);
+    }
+
+    double ns[samples];
+    for (uint32_t s = 0; s < samples; s++) {
+        usleep(LOADED_GAP_US);
+        _Atomic uint64_t end = 0;
+        SchedJob verify = { SCHED_VERIFY, b->prm, b->M, MSG_LEN, b->ctx, sizeof b->ctx, b->PK,
+                            b->SIG, b->sig_len, NULL, verify_done, &end };
+        uint64_t start = now_ns();
+        sched_submit(sched, &verify);
+        while (atomic_load(&end) == 0)
+            usleep(50);
+        ns[s] = (double) (end - start);
+    }
+    atomic_store(&stop, true);
+    sched_destroy(sched);
+    free(sigs);
+
+    qsort(ns, samples, sizeof ns[0], compare_double);
+    Result r = { 0 };
+    r.samples = samples;
+    r.median_ns = ns[samples / 2];
+    r.p99_ns = ns[(samples * 99 - 1) / 100];
+    r.ops_per_sec = 1e9 / r.median_ns;
+    return r;
+}
+
+// Hash counts and stage times of one call of op, checked against the analytic counts
+static void report_stats(const char *set, const char *op_name, void (*op)(Bench *), Bench *b, bool sign)
+{
+    SlhStats s;
+    stats_reset();
+    op(b);
+    stats_get(&s);
+    bool ok = stats_check(b->prm, sign, &s);
+    stats_failed |= !ok;
+
+    printf("%-20s %-22s F %lu H %lu PRF %lu Tlen %lu H_msg %lu PRF_msg %lu ", set, op_name, (unsigned long) s.F,
+           (unsigned long) s.H, (unsigned long) s.PRF, (unsigned long) s.Tlen, (unsigned long) s.H_msg, (unsigned long) s.PRF_msg);
+    if (b->prm->sha2)
+        printf("sha256 %lu sha256_lanes %lu sha512 %lu", (unsigned long) s.sha256, (unsigned long) s.sha256_lanes, (unsigned long) s.sha512);
+    else
+        printf("keccak %lu keccak_x8 %lu", (unsigned long) s.keccak, (unsigned long) s.keccak_x8);
+    printf(" %s\n", ok ? "ok" : "MISMATCH");
+    printf("%-20s %-22s us: PRF_msg %.1f H_msg %.1f fors_sign %.1f fors_pk %.1f layers", set, op_name,
+           s.ns_PRF_msg / 1e3, s.ns_H_msg / 1e3, s.ns_fors_sign / 1e3, s.ns_fors_pk / 1e3);
+    for (uint32_t j = 0; j < b->prm->d; j++)
+        printf(" %.1f", s.ns_layer[j] / 1e3);
+    printf("\n");
+
+    if (json == NULL)
+        return;
+    fprintf(json, ",\n  {\"set\": \"%s\", \"op\": \"%s_stats\", \"F\": %lu, \"H\": %lu, \"PRF\": %lu, \"Tlen\": %lu, "
+                  "\"H_msg\": %lu, \"PRF_msg\": %lu, \"keccak\": %lu, \"keccak_x8\": %lu, \"sha256\": %lu, "
+                  "\"sha256_lanes\": %lu, \"sha512\": %lu, \"expected\": %s, "
+                  "\"ns_PRF_msg\": %lu, \"ns_H_msg\": %lu, \"ns_fors_sign\": %lu, \"ns_fors_pk\": %lu, \"ns_layer\": [",
+            set, op_name, (unsigned long) s.F, (unsigned long) s.H, (unsigned long) s.PRF, (unsigned long) s.Tlen,
+            (unsigned long) s.H_msg, (unsigned long) s.PRF_msg, (unsigned long) s.keccak, (unsigned long) s.keccak_x8,
+            (unsigned long) s.sha256, (unsigned long) s.sha256_lanes, (unsigned long) s.sha512, ok ? "true" : "false",
+            (unsigned long) s.ns_PRF_msg, (unsigned long) s.ns_H_msg, (unsigned long) s.ns_fors_sign, (unsigned long) s.ns_fors_pk);
+    for (uint32_t j = 0; j < b->prm->d; j++)
+        fprintf(json, "%s%lu", j == 0 ? "" : ", ", (unsigned long) s.ns_layer[j]);
+    fprintf(json, "]}");
+}
+
+static void bench_set(const char *name, uint32_t samples, uint32_t max_threads)
+{
+    Parameters prm;
+    setup_parameter_set(&prm, name);
+
+    uint32_t sig_len = slh_signature_length(&prm);
+    uint8_t SK[4 * prm.n];
+    uint8_t PK[2 * prm.n];
+    uint8_t *SIG = malloc(sig_len);
+
+    Bench b;
+    memset(&b, 0, sizeof b);
+    b.prm = &prm;
+    b.SK = SK;
+    b.PK = PK;
+    b.SIG = SIG;
+    b.sig_len = sig_len;
+    for (uint32_t i = 0; i < MSG_LEN; i++)
+        b.M[i] = i;
+    initADRS(&b.adrs);
+
+    report(name, "keygen", 1, measure(op_keygen, &b, samples, 1));
+    report(name, "sign", 1, measure(op_sign, &b, samples, 1));
+    report(name, "sign_randomized", 1, measure(op_sign_randomized, &b, samples, 1));
+
+    // one signature split over worker processes, forked while the bench has no other threads
+    b.shards = shard_create(max_threads);
+    if (b.shards != NULL) {
+        report(name, "sign_sharded", max_threads, measure(op_sign_sharded, &b, samples, 1));
+        shard_destroy(b.shards);
+    }
+    report(name, "verify", 1, measure(op_verify, &b, samples, 1));
+    report(name, "hash_sign", 1, measure(op_hash_sign, &b, samples, 1));
+    report(name, "hash_sign_randomized", 1, measure(op_hash_sign_randomized, &b, samples, 1));
+    report(name, "hash_verify", 1, measure(op_hash_verify, &b, samples, 1));
+
+    // built with -DSLH_STATS: hash counts and stage times of one sign and one verify
+    if (STATS_ENABLED) {
+        report_stats(name, "sign", op_sign, &b, true);
+        report_stats(name, "verify", op_verify, &b, false);
+    }
+
+    report(name, "F", 1, measure(op_F, &b, samples, 1));
+    report(name, "H", 1, measure(op_H, &b, samples, 1));
+    report(name, "PRF", 1, measure(op_PRF, &b, samples, 1));
+    report(name, "Tlen", 1, measure(op_Tlen, &b, samples, 1));
+    report(name, "chain", 1, measure(op_chain, &b, samples, 1));
+    report(name, "wots_pkGen", 1, measure(op_wots_pkGen, &b, samples, 1));
+    report(name, "xmss_node", 1, measure(op_xmss_node, &b, samples, 1));
+    report(name, "fors_node", 1, measure(op_fors_node, &b, samples, 1));
+
+    // thread scaling of slh_sign_batch, the sweep signs SWEEP_MESSAGES messages per thread per call
+    SignItem items[SWEEP_MESSAGES * max_threads];
+    uint8_t *sigs = malloc((size_t) SWEEP_MESSAGES * max_threads * sig_len);
+    for (uint32_t i = 0; i < SWEEP_MESSAGES * max_threads; i++)
+        items[i] = (SignItem) { b.M, MSG_LEN, b.ctx, sizeof b.ctx, SK, sigs + (size_t) i * sig_len };
+    b.items = items;
+
+    uint32_t sweep_samples = samples / 4 > 3 ? samples / 4 : 3;
+    for (uint32_t threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        b.pool = pool_create(threads);
+        if (b.pool == NULL)
+            break;
+        b.items_count = SWEEP_MESSAGES * threads;
+        report(name, "sign_batch", threads, measure(op_sign_batch, &b, sweep_samples, b.items_count));
+        pool_destroy(b.pool);
+        if (threads == max_threads)
+            break;
+    }
+
+    free(sigs);
+
+    // scaling over NUMA nodes, all CPUs of the first nodes nodes with a replica of the key on each
+    for (uint32_t nodes = 1; nodes <= node_count(); nodes++) {
+        b.np = nodepool_create(nodes, 0);
+        if (b.np == NULL)
+            break;
+        NodeKey *key = nodepool_add_key(b.np, &prm, SK, true);
+        uint32_t threads = 0;
+        for (uint32_t node = 0; node < nodes; node++)
+            threads += pool_size(nodepool_pool(b.np, node));
+
+        b.items_count = SWEEP_MESSAGES * threads;
+        b.items = malloc(b.items_count * sizeof *b.items);
+        b.keys = malloc(b.items_count * sizeof *b.keys);
+        sigs = malloc((size_t) b.items_count * sig_len);
+        for (uint32_t i = 0; i < b.items_count; i++) {
+            b.items[i] = (SignItem) { b.M, MSG_LEN, b.ctx, sizeof b.ctx, SK, sigs + (size_t) i * sig_len };
+            b.keys[i] = key;
+        }
+        if (key != NULL) {
+            char op[32];
+            snprintf(op, sizeof op, "sign_batch_%unode", nodes);
+            report(name, op, threads, measure(op_sign_nodes, &b, sweep_samples, b.items_count));
+        }
+        free(sigs);
+        free(b.keys);
+        free(b.items);
+        nodepool_destroy(b.np);
+    }
+
+    // verification latency under a full signing load on the scheduler
+    report(name, "verify_loaded", max_threads, measure_loaded(&b, max_threads, samples));
+
+    free(SIG);
+}
+
+int main(int argc, char **argv)
+{
+    const char *parameter_sets[12] = {
+        "SLH-DSA-SHA2-128f",
+        "SLH-DSA-SHA2-128s",
+        "SLH-DSA-SHA2-192f",
+        "SLH-DSA-SHA2-192s",
+        "SLH-DSA-SHA2-256f",
+        "SLH-DSA-SHA2-256s",
+        "SLH-DSA-SHAKE-128f",
+        "SLH-DSA-SHAKE-128s",
+        "SLH-DSA-SHAKE-192f",
+        "SLH-DSA-SHAKE-192s",
+        "SLH-DSA-SHAKE-256f",
+        "SLH-DSA-SHAKE-256s"
+    };
+    const char *only = NULL;
+    const char *json_path = NULL;
+    uint32_t samples = 10;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t max_threads = cpus > 0 ? cpus : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:t:j:")) != -1) {
+        switch (opt) {
+        case 'p': only = optarg; break;
+        case 's': samples = atoi(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'j': json_path = optarg; break;
+        default:
+            printf("Usage: %s [-p parameter set] [-s samples] [-t max threads] [-j results.json]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (samples == 0 || max_threads == 0) {
+        printf("Samples and threads must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    if (json_path != NULL) {
+        json = fopen(json_path, "w");
+        if (json == NULL) {
+            printf("Error opening %s\n", json_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(json, "[\n");
+    }
+
+    printf("%-20s %-22s %3s %12s %12s %14s %12s\n", "set", "op", "thr", "median us", "p99 us", "median cycles", "ops/s");
+    for (uint32_t i = 0; i < 12; i++) {
+        if (only == NULL || strcmp(only, parameter_sets[i]) == 0)
+            bench_set(parameter_sets[i], samples, max_threads);
+    }
+
+    if (json != NULL) {
+        fprintf(json, "\n]\n");
+        fclose(json);
+    }
+    if (stats_failed) {
+        printf("Hash counts differ from the analytic counts\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,175 +1,285 @@
-#include <stdio.h>
-#include <stdint.h>
-#include <string.h>
-#include <sodium.h>
-
-#include "adrs.h"
-#include "params.h"
-#include "internal.h"
-#include "shake.h"
-#include "external.h"
-
-// Algorithmus 21: Generiert ein SLH-DSA Schlsselpaar
-void slh_keygen(Parameters *prm, uint8_t *SK_seed, uint8_t *SK_prf, uint8_t *PK_seed, uint8_t *SK, uint8_t *PK)
-{
-    if (sodium_init() < 0) {
-        printf("Error initalizing sodium library\n");
-        return;
-    }
-
-    // check if the seed and prf values are empty
-    // if so, randomly generate them
-    uint32_t sum_sk_seed, sum_sk_prf, sum_pk_seed = 0;
-    for (uint32_t i = 0; i < prm->n; i++) {
-        sum_sk_seed |= SK_seed[i];
-        sum_sk_prf  |= SK_prf[i];
-        sum_pk_seed |= PK_seed[i];
-    }
-    if (sum_sk_seed == 0)
-        randombytes_buf(SK_seed, prm->n);
-    if (sum_sk_prf == 0)
-        randombytes_buf(SK_prf , sizeof SK_prf);
-    if (sum_pk_seed == 0)
-        randombytes_buf(PK_seed, sizeof PK_seed);
-
-    slh_keygen_internal(prm, SK_seed, SK_prf, PK_seed, SK, PK);
-}
-
-// Algorithmus 22: Generiert eine reine SLH-DSA Signatur
-void slh_sign(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *ctx, const size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic)
-{
-    if (ctx_len > MAX_CTX_LENGTH) {
-        printf("Invalid context length\n");
-        return;
-    }
-
-    // for deterministic varaiant, use PK_seed for addrnd
-    uint8_t addrnd[prm->n];
-    if (deterministic == true) {
-        memcpy(addrnd, SK + 2 * prm->n, prm->n);
-    }
-    else {
-        if (sodium_init() < 0) {
-            printf("Error initalizing sodium library\n");
-            return;
-        }
-        randombytes_buf(addrnd, sizeof addrnd);
-    }
-    uint8_t M_prime[1 + 1 + ctx_len + M_len];
-    M_prime[0] = 0;
-    toByte(ctx_len, 1, M_prime + 1);
-
-    memcpy(M_prime + 2, ctx, ctx_len);
-    memcpy(M_prime + 2 + ctx_len, M, M_len);
-
-    slh_sign_internal(prm, M_prime, sizeof M_prime, SK, addrnd, SIG);
-}
-
-// Algorithmus 23: Generiert eine vorgehashte SLH-DSA Signatur
-void hash_slh_sign(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const char *PH, const uint8_t *SK, uint8_t *SIG, bool deterministic)
-{
-    if (ctx_len > MAX_CTX_LENGTH) {
-        printf("Context is longer that %d\n", MAX_CTX_LENGTH);
-        return;
-    }
-
-    // for deterministic varaiant, use PK_seed for addrnd
-    uint8_t addrnd[prm->n];
-    if (deterministic == true) {
-        memcpy(addrnd, SK + 2 * prm->n, prm->n);
-    }
-    else {
-        if (sodium_init() < 0) {
-            printf("Error initalizing sodium library\n");
-            return;
-        }
-        randombytes_buf(addrnd, sizeof addrnd);
-    }
-
-    uint8_t OID[11];
-    uint8_t PHM[64] = {0};
-
-    if (strcmp(PH, "SHA-256") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x01", 11);
-        SHA_256(M, M_len, PHM);
-    } else if (strcmp(PH, "SHA-512") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x03", 11);
-        SHA_512(M, M_len, PHM);
-    } else if (strcmp(PH, "SHAKE128") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x0B", 11);
-        SHAKE_128(M, M_len, PHM, 32);
-    } else if (strcmp(PH, "SHAKE256") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x0C", 11);
-        SHAKE_256(M, M_len, PHM, 64);
-    } else {
-        printf("Unsupported hash function\n");
-        printf("Valid values are 'SHA-256', 'SHA-512', 'SHAKE128', 'SHAKE256'\n");
-        return;
-    }
-
-    uint8_t M_prime[1 + 1 + ctx_len + 11 + sizeof PHM];
-    M_prime[0] = 1;
-    toByte(ctx_len, 1, M_prime + 1);
-
-    memcpy(M_prime + 2, ctx, ctx_len);
-    memcpy(M_prime + 2 + ctx_len, OID, sizeof OID);
-    memcpy(M_prime + 2 + ctx_len + sizeof OID, PHM, sizeof PHM);
-
-    slh_sign_internal(prm, M_prime, sizeof M_prime, SK, addrnd, SIG);
-}
-
-// Algorithmus 24: Verifiziert eine reine SLH-DSA Signatur
-bool slh_verify(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, uint8_t *ctx, size_t ctx_len, const uint8_t *PK)
-{
-    if (ctx_len > MAX_CTX_LENGTH) {
-        printf("Invalid context length\n");
-        return false;
-    }
-    uint8_t M_prime[1 + 1 + ctx_len + M_len];
-    M_prime[0] = 0;
-    toByte(ctx_len, 1, M_prime + 1);
-
-    memcpy(M_prime + 2, ctx, ctx_len);
-    memcpy(M_prime + 2 + ctx_len, M, M_len);
-    return slh_verify_internal(prm, M_prime, sizeof M_prime, SIG, SIG_len, PK);
-}
-
-// Algorithmus 25: Verifiziert eine vorgehashte SLH-DSA Signatur
-bool hash_slh_verify(Parameters *prm, const uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, const char *PH, const uint8_t *PK)
-{
-    if (ctx_len > MAX_CTX_LENGTH) {
-        printf("Context is longer that %d\n", MAX_CTX_LENGTH);
-        return false;
-    }
-
-    uint8_t OID[11];
-    uint8_t PHM[64] = {0};
-
-    if (strcmp(PH, "SHA-256") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x01", 11);
-        SHA_256(M, M_len, PHM);
-    } else if (strcmp(PH, "SHA-512") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x03", 11);
-        SHA_512(M, M_len, PHM);
-    } else if (strcmp(PH, "SHAKE128") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x0B", 11);
-        SHAKE_128(M, M_len, PHM, 32);
-    } else if (strcmp(PH, "SHAKE256") == 0) {
-        memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x0C", 11);
-        SHAKE_256(M, M_len, PHM, 64);
-    } else {
-        printf("Unsupported hash function\n");
-        printf("Valid values are 'SHA-256', 'SHA-512', 'SHAKE128', 'SHAKE256'\n");
-        return false;
-    }
-
-    uint8_t M_prime[1 + 1 + ctx_len + 11 + sizeof PHM];
-    M_prime[0] = 1;
-    toByte(ctx_len, 1, M_prime + 1);
-
-    memcpy(M_prime + 2, ctx, ctx_len);
-    memcpy(M_prime + 2 + ctx_len, OID, sizeof OID);
-    memcpy(M_prime + 2 + ctx_len + sizeof OID, PHM, sizeof PHM);
-
-    return slh_verify_internal(prm, M_prime, sizeof M_prime, SIG, SIG_len, PK);
-}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "adrs.h"
+#include "params.h"
+#include "internal.h"
+#include "rng.h"
+#include "shake.h"
+#include "external.h"
+
+// Algorithmus 21: Generiert ein SLH-DSA Schlsselpaar
+void slh_keygen(Parameters *prm, uint8_t *SK_seed, uint8_t *SK_prf, uint8_t *PK_seed, uint8_t *SK, uint8_t *PK)
+{
+    // check if the seed and prf values are empty
+    // if so, randomly generate them
+    uint32_t sum_sk_seed = 0, sum_sk_prf = 0, sum_pk_seed = 0;
+    for (uint32_t i = 0; i < prm->n; i++) {
+        sum_sk_seed |= SK_seed[i];
+        sum_sk_prf  |= SK_prf[i];
+        sum_pk_seed |= PK_seed[i];
+    }
+    bool ok = true;
+    if (sum_sk_seed == 0)
+        ok = ok && random_bytes(SK_seed, prm->n);
+    if (sum_sk_prf == 0)
+        ok = ok && random_bytes(SK_prf, prm->n);
+    if (sum_pk_seed == 0)
+        ok = ok && random_bytes(PK_seed, prm->n);
+    if (!ok) {
+        printf("Error initalizing sodium library\n");
+        return;
+    }
+
+    slh_keygen_internal(prm, SK_seed, SK_prf, PK_seed, SK, PK);
+}
+
+// Algorithmus 22: Generiert eine reine SLH-DSA Signatur
+void slh_sign(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *ctx, const size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return;
+    }
+
+    // for deterministic varaiant, use PK_seed for addrnd
+    uint8_t addrnd[prm->n];
+    if (deterministic == true) {
+        memcpy(addrnd, SK + 2 * prm->n, prm->n);
+    }
+    else {
+        if (!random_bytes(addrnd, sizeof addrnd)) {
+            printf("Error initalizing sodium library\n");
+            return;
+        }
+    }
+    slh_sign_addrnd(prm, M, M_len, ctx, ctx_len, SK, addrnd, SIG);
+}
+
+// Algorithmus 22 with the caller's addrnd, e.g. from a test vector
+void slh_sign_addrnd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return;
+    }
+
+    // M' = 0x00 || len(ctx) || ctx || M, passed as segments so M is not copied
+    uint8_t prefix[2];
+    prefix[0] = 0;
+    toByte(ctx_len, 1, prefix + 1);
+
+    Segment M_prime[3] = {
+        { prefix, sizeof prefix },
+        { ctx, ctx_len },
+        { M, M_len }
+    };
+    slh_sign_internal_segments(prm, M_prime, 3, SK, addrnd, SIG);
+}
+
+// Reader that yields 0x00 || len(ctx) || ctx before the caller's message
+typedef struct {
+    uint8_t prefix[2 + MAX_CTX_LENGTH];
+    size_t prefix_len;
+    size_t pos;
+    MsgReader *M;
+} PrefixReader;
+
+static ssize_t prefix_read(void *arg, uint8_t *buf, size_t len)
+{
+    PrefixReader *r = arg;
+    if (r->pos < r->prefix_len) {
+        size_t n = r->prefix_len - r->pos;
+        if (n > len)
+            n = len;
+        memcpy(buf, r->prefix + r->pos, n);
+        r->pos += n;
+        return n;
+    }
+    return r->M->read(r->M->arg, buf, len);
+}
+
+static bool prefix_rewind(void *arg)
+{
+    PrefixReader *r = arg;
+    r->pos = 0;
+    return r->M->rewind(r->M->arg);
+}
+
+static void prefix_reader_init(PrefixReader *r, MsgReader *reader, MsgReader *M, const uint8_t *ctx, size_t ctx_len)
+{
+    r->prefix[0] = 0;
+    toByte(ctx_len, 1, r->prefix + 1);
+    memcpy(r->prefix + 2, ctx, ctx_len);
+    r->prefix_len = 2 + ctx_len;
+    r->pos = 0;
+    r->M = M;
+
+    reader->read = prefix_read;
+    reader->rewind = M->rewind != NULL ? prefix_rewind : NULL;
+    reader->arg = r;
+}
+
+// Algorithmus 22, with the message read from M in chunks
+// M is read twice if it supports rewind, otherwise once (see slh_sign_internal_reader)
+bool slh_sign_reader(Parameters *prm, MsgReader *M, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic)
+{
+    if (ctx_len > MAX_CTX_LENGTH)
+        return false;
+
+    uint8_t addrnd[prm->n];
+    if (deterministic == true) {
+        memcpy(addrnd, SK + 2 * prm->n, prm->n);
+    }
+    else if (!random_bytes(addrnd, sizeof addrnd)) {
+        return false;
+    }
+
+    PrefixReader r;
+    MsgReader M_prime;
+    prefix_reader_init(&r, &M_prime, M, ctx, ctx_len);
+    return slh_sign_internal_reader(prm, &M_prime, SK, addrnd, SIG);
+}
+
+// Computes PHM = PH(M) and the DER encoded OID of PH
+// Returns the length of PHM, or 0 if PH is not an approved pre-hash function
+static size_t prehash(PreHash PH, const uint8_t *M, size_t M_len, uint8_t *OID, uint8_t *PHM)
+{
+    // all OIDs are 2.16.840.1.101.3.4.2.PH
+    memcpy(OID, "\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x00", 11);
+    OID[10] = PH;
+
+    switch (PH) {
+    case PH_SHA_224:     SHA_224(M, M_len, PHM);        return 28;
+    case PH_SHA_256:     SHA_256(M, M_len, PHM);        return 32;
+    case PH_SHA_384:     SHA_384(M, M_len, PHM);        return 48;
+    case PH_SHA_512:     SHA_512(M, M_len, PHM);        return 64;
+    case PH_SHA_512_224: SHA_512_224(M, M_len, PHM);    return 28;
+    case PH_SHA_512_256: SHA_512_256(M, M_len, PHM);    return 32;
+    case PH_SHA3_224:    SHA3(M, M_len, PHM, 28);       return 28;
+    case PH_SHA3_256:    SHA3(M, M_len, PHM, 32);       return 32;
+    case PH_SHA3_384:    SHA3(M, M_len, PHM, 48);       return 48;
+    case PH_SHA3_512:    SHA3(M, M_len, PHM, 64);       return 64;
+    case PH_SHAKE128:    SHAKE_128(M, M_len, PHM, 32);  return 32;
+    case PH_SHAKE256:    SHAKE_256(M, M_len, PHM, 64);  return 64;
+    }
+    return 0;
+}
+
+// Algorithmus 23: Generiert eine vorgehashte SLH-DSA Signatur
+void hash_slh_sign(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *SK, uint8_t *SIG, bool deterministic)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Context is longer that %d\n", MAX_CTX_LENGTH);
+        return;
+    }
+
+    // for deterministic varaiant, use PK_seed for addrnd
+    uint8_t addrnd[prm->n];
+    if (deterministic == true) {
+        memcpy(addrnd, SK + 2 * prm->n, prm->n);
+    }
+    else {
+        if (!random_bytes(addrnd, sizeof addrnd)) {
+            printf("Error initalizing sodium library\n");
+            return;
+        }
+    }
+    hash_slh_sign_addrnd(prm, M, M_len, ctx, ctx_len, PH, SK, addrnd, SIG);
+}
+
+// Algorithmus 23 with the caller's addrnd, e.g. from a test vector
+void hash_slh_sign_addrnd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Context is longer that %d\n", MAX_CTX_LENGTH);
+        return;
+    }
+
+    uint8_t OID[11];
+    uint8_t PHM[64];
+    size_t PHM_len = prehash(PH, M, M_len, OID, PHM);
+    if (PHM_len == 0) {
+        printf("Unsupported hash function\n");
+        return;
+    }
+
+    // M' = 0x01 || len(ctx) || ctx || OID || PHM
+    uint8_t prefix[2];
+    prefix[0] = 1;
+    toByte(ctx_len, 1, prefix + 1);
+
+    Segment M_prime[4] = {
+        { prefix, sizeof prefix },
+        { ctx, ctx_len },
+        { OID, sizeof OID },
+        { PHM, PHM_len }
+    };
+
+    slh_sign_internal_segments(prm, M_prime, 4, SK, addrnd, SIG);
+}
+
+// Algorithmus 24: Verifiziert eine reine SLH-DSA Signatur
+bool slh_verify(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, uint8_t *ctx, size_t ctx_len, const uint8_t *PK)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return false;
+    }
+    uint8_t prefix[2];
+    prefix[0] = 0;
+    toByte(ctx_len, 1, prefix + 1);
+
+    Segment M_prime[3] = {
+        { prefix, sizeof prefix },
+        { ctx, ctx_len },
+        { M, M_len }
+    };
+    return slh_verify_internal_segments(prm, M_prime, 3, SIG, SIG_len, PK);
+}
+
+// Algorithmus 24, with the message read from M in chunks
+bool slh_verify_reader(Parameters *prm, MsgReader *M, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *PK)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return false;
+    }
+
+    PrefixReader r;
+    MsgReader M_prime;
+    prefix_reader_init(&r, &M_prime, M, ctx, ctx_len);
+    return slh_verify_internal_reader(prm, &M_prime, SIG, SIG_len, PK);
+}
+
+// Algorithmus 25: Verifiziert eine vorgehashte SLH-DSA Signatur
+bool hash_slh_verify(Parameters *prm, const uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *PK)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Context is longer that %d\n", MAX_CTX_LENGTH);
+        return false;
+    }
+
+    uint8_t OID[11];
+    uint8_t PHM[64];
+    size_t PHM_len = prehash(PH, M, M_len, OID, PHM);
+    if (PHM_len == 0) {
+        printf("Unsupported hash function\n");
+        return false;
+    }
+
+    // M' = 0x01 || len(ctx) || ctx || OID || PHM
+    uint8_t prefix[2];
+    prefix[0] = 1;
+    toByte(ctx_len, 1, prefix + 1);
+
+    Segment M_prime[4] = {
+        { prefix, sizeof prefix },
+        { ctx, ctx_len },
+        { OID, sizeof OID },
+        { PHM, PHM_len }
+    };
+
+    return slh_verify_internal_segments(prm, M_prime, 4, SIG, SIG_len, PK);
+}
@@ -4,15 +4,42 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "params.h"
+#include "internal.h"
 
 #define MAX_CTX_LENGTH 255
 
+// Approved pre-hash functions for HashSLH-DSA
+// Each value is the last arc of the function's OID 2.16.840.1.101.3.4.2.x
+typedef enum {
+    PH_SHA_256     = 0x01,
+    PH_SHA_384     = 0x02,
+    PH_SHA_512     = 0x03,
+    PH_SHA_224     = 0x04,
+    PH_SHA_512_224 = 0x05,
+    PH_SHA_512_256 = 0x06,
+    PH_SHA3_224    = 0x07,
+    PH_SHA3_256    = 0x08,
+    PH_SHA3_384    = 0x09,
+    PH_SHA3_512    = 0x0A,
+    PH_SHAKE128    = 0x0B,
+    PH_SHAKE256    = 0x0C
+} PreHash;
+
 void slh_keygen(Parameters *prm, uint8_t *SK_seed, uint8_t *SK_prf, uint8_t *PK_seed, uint8_t *SK, uint8_t *PK);
 
 void slh_sign(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *ctx, const size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic);
 
-void hash_slh_sign(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const char *PH, const uint8_t *SK, uint8_t *SIG, bool deterministic);
+void slh_sign_addrnd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG);
+
+// Returns false if ctx is too long, no randomness was available or M could not be read completely
+bool slh_sign_reader(Parameters *prm, MsgReader *M, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic);
+
+void hash_slh_sign(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *SK, uint8_t *SIG, bool deterministic);
+
+void hash_slh_sign_addrnd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG);
 
 bool slh_verify(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, uint8_t *ctx, size_t ctx_len, const uint8_t *PK);
 
-bool hash_slh_verify(Parameters *prm, const uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, const char *PH, const uint8_t *PK);
+bool slh_verify_reader(Parameters *prm, MsgReader *M, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *PK);
+
+bool hash_slh_verify(Parameters *prm, const uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *ctx, size_t ctx_len, PreHash PH, const uint8_t *PK);
@@ -1,152 +1,321 @@
-#include <stdbool.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include "adrs.h"
-#include "fors.h"
-#include "hypertree.h"
-#include "params.h"
-#include "shake.h"
-#include "xmss.h"
-
-// algorithm 18
-void slh_keygen_internal(Parameters *prm, uint8_t *sk_seed, uint8_t *sk_prf, uint8_t *pk_seed, uint8_t *SK, uint8_t *PK)
-{
-    ADRS adrs;
-    initADRS(&adrs);
-
-    setLayerAddress(&adrs, prm->d - 1);
-    uint8_t pk_root[prm->n];
-    xmss_node(prm, sk_seed, 0, prm->h_, pk_seed, adrs, pk_root);
-
-    memcpy(SK + 0 * prm->n, sk_seed, prm->n);
-    memcpy(SK + 1 * prm->n, sk_prf,  prm->n);
-    memcpy(SK + 2 * prm->n, pk_seed, prm->n);
-    memcpy(SK + 3 * prm->n, pk_root, prm->n);
-
-    memcpy(PK + 0 * prm->n, pk_seed, prm->n);
-    memcpy(PK + 1 * prm->n, pk_root, prm->n);
-}
-
-// algorithm 19
-void slh_sign_internal(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer)
-{
-    // precompute these values to make the code cleaner
-    uint64_t index1 = (prm->k * prm->a + 7) / 8;
-    uint64_t index2 = ((prm->h - (prm->h / prm->d)) + 7) / 8;
-    uint64_t index3 = ((prm->h / prm->d) + 7) / 8;
-
-    ADRS adrs;
-    initADRS(&adrs);
-
-    uint8_t sk_seed[prm->n];
-    uint8_t sk_prf[prm->n];
-    uint8_t pk_seed[prm->n];
-    uint8_t pk_root[prm->n];
-    memcpy(sk_seed, SK + 0 * prm->n, prm->n);
-    memcpy(sk_prf,  SK + 1 * prm->n, prm->n);
-    memcpy(pk_seed, SK + 2 * prm->n, prm->n);
-    memcpy(pk_root, SK + 3 * prm->n, prm->n);
-
-    uint32_t sig_fors_len = prm->k * (1 + prm->a) * prm->n;
-    uint32_t sig_ht_len = (prm->h + prm->d * prm->len) * prm->n;
-    // signature = Randomness + FORS signature + HT signature
-    uint8_t SIG[prm->n + sig_fors_len + sig_ht_len];
-
-    // Generate R using PRF
-    uint8_t R[prm->n];
-    PRF_msg(prm, sk_prf, addrnd, M, M_len, R);
-    memcpy(SIG, R, prm->n);
-
-    // Generate message digest
-    uint8_t digest[prm->m];
-    H_msg(prm, R, pk_seed, pk_root, M, M_len, digest);
-
-    uint8_t md[index1];
-    memcpy(md, digest, index1);
-
-    uint8_t tmp_idx_tree[index2];
-    uint8_t tmp_idx_leaf[index3];
-    memcpy(tmp_idx_tree, digest + index1, index2);
-    memcpy(tmp_idx_leaf, digest + index1 + index2, index3);
-
-    uint64_t idx_tree = toInt(tmp_idx_tree, index2) & (UINT64_C(1) << (prm->h - prm->h_)) - UINT64_C(1);
-    uint64_t idx_leaf = toInt(tmp_idx_leaf, index3) & (1 << prm->h_) - 1;
-
-    setTreeAddress(&adrs, idx_tree);
-    setTypeAndClear(&adrs, prm->FORS_TREE);
-    setKeyPairAddress(&adrs, idx_leaf);
-
-    // Generate FORS signature
-    uint8_t SIG_FORS[sig_fors_len];
-    fors_sign(prm, md, sk_seed, pk_seed, adrs, SIG_FORS);
-
-    // Copy FORS signature to main signature
-    memcpy(SIG + prm->n, SIG_FORS, sig_fors_len);
-
-    uint8_t PK_FORS[prm->n];
-    fors_pkFromSig(prm, SIG_FORS, md, pk_seed, adrs, PK_FORS);
-
-    // Generate and append HT signature
-    uint8_t SIG_HT[sig_ht_len];
-    ht_sign(prm, PK_FORS, sk_seed, pk_seed, idx_tree, idx_leaf, SIG_HT);
-    memcpy(SIG + prm->n + sig_fors_len, SIG_HT, sig_ht_len);
-    memcpy(buffer, SIG, prm->n + sig_fors_len + sig_ht_len);
-}
-
-// algorithm 20
-bool slh_verify_internal(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *PK)
-{
-    uint64_t index1 = (prm->k * prm->a + 7) / 8;
-    uint64_t index2 = ((prm->h - (prm->h / prm->d)) + 7) / 8;
-    uint64_t index3 = ((prm->h / prm->d) + 7) / 8;
-
-    uint32_t sig_fors_len = prm->k * (1 + prm->a) * prm->n;
-    uint32_t sig_ht_len = (prm->h + prm->d * prm->len) * prm->n;
-    uint32_t sig_len = prm->n + sig_fors_len + sig_ht_len;
-
-    uint8_t pk_seed[prm->n];
-    uint8_t pk_root[prm->n];
-    memcpy(pk_seed, PK + 0 * prm->n, prm->n);
-    memcpy(pk_root, PK + 1 * prm->n, prm->n);
-
-    if (SIG_len != sig_len) {
-        printf("Signature has invalid length\n");
-        return false;
-    }
-
-    ADRS adrs;
-    initADRS(&adrs);
-
-    uint8_t R[prm->n];
-    memcpy(R, SIG, prm->n);
-
-    // Extract FORS and HT signatures
-    uint8_t SIG_FORS[sig_fors_len];
-    memcpy(SIG_FORS, SIG + prm->n, sig_fors_len);
-
-    uint8_t SIG_HT[sig_ht_len];
-    memcpy(SIG_HT, SIG + prm->n + sig_fors_len, sig_ht_len);
-
-    uint8_t digest[prm->m];
-    H_msg(prm, R, pk_seed, pk_root, M, M_len, digest);
-    uint8_t md[index1];
-    memcpy(md, digest, index1);
-
-    uint8_t tmp_idx_tree[index2];
-    uint8_t tmp_idx_leaf[index3];
-    memcpy(tmp_idx_tree, digest + index1, index2);
-    memcpy(tmp_idx_leaf, digest + index1 + index2, index3);
-
-    uint64_t idx_tree = toInt(tmp_idx_tree, index2) & (UINT64_MAX >> (64 - (prm->h - prm->h / prm->d)));
-    uint64_t idx_leaf = toInt(tmp_idx_leaf, index3) & (UINT64_MAX >> (64 - prm->h / prm->d));
-
-    setTreeAddress(&adrs, idx_tree);
-    setTypeAndClear(&adrs, prm->FORS_TREE);
-    setKeyPairAddress(&adrs, idx_leaf);
-
-    uint8_t PK_FORS[prm->n];
-    fors_pkFromSig(prm, SIG_FORS, md, pk_seed, adrs, PK_FORS);
-
-    return ht_verify(prm, PK_FORS, SIG_HT, pk_seed, idx_tree, idx_leaf, pk_root);
-}
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "adrs.h"
+#include "fors.h"
+#include "hypertree.h"
+#include "internal.h"
+#include "params.h"
+#include "shake.h"
+#include "stats.h"
+#include "xmss.h"
+
+// algorithm 18
+void slh_keygen_internal(Parameters *prm, uint8_t *sk_seed, uint8_t *sk_prf, uint8_t *pk_seed, uint8_t *SK, uint8_t *PK)
+{
+    ADRS adrs;
+    initADRS(&adrs);
+
+    setLayerAddress(&adrs, prm->d - 1);
+    uint8_t pk_root[prm->n];
+    xmss_node(prm, sk_seed, 0, prm->h_, pk_seed, adrs, pk_root);
+
+    memcpy(SK + 0 * prm->n, sk_seed, prm->n);
+    memcpy(SK + 1 * prm->n, sk_prf,  prm->n);
+    memcpy(SK + 2 * prm->n, pk_seed, prm->n);
+    memcpy(SK + 3 * prm->n, pk_root, prm->n);
+
+    memcpy(PK + 0 * prm->n, pk_seed, prm->n);
+    memcpy(PK + 1 * prm->n, pk_root, prm->n);
+}
+
+// algorithm 19, lines 7 to 12: md, idx_tree and idx_leaf from the message digest
+void split_digest(Parameters *prm, const uint8_t *digest, const uint8_t **md, uint64_t *idx_tree, uint64_t *idx_leaf)
+{
+    uint64_t index1 = (prm->k * prm->a + 7) / 8;
+    uint64_t index2 = ((prm->h - (prm->h / prm->d)) + 7) / 8;
+    uint64_t index3 = ((prm->h / prm->d) + 7) / 8;
+
+    if (md)
+        *md = digest;
+    *idx_tree = toInt((uint8_t *) digest + index1, index2) & (UINT64_MAX >> (64 - (prm->h - prm->h / prm->d)));
+    *idx_leaf = toInt((uint8_t *) digest + index1 + index2, index3) & (UINT64_MAX >> (64 - prm->h / prm->d));
+}
+
+// algorithm 19, lines 6 to 18: signs the message digest computed from R
+static void sign_digest(Parameters *prm, const uint8_t *SK, const uint8_t *R, const uint8_t *digest, uint8_t *buffer)
+{
+
+    ADRS adrs;
+    initADRS(&adrs);
+
+    uint8_t sk_seed[prm->n];
+    uint8_t pk_seed[prm->n];
+    memcpy(sk_seed, SK + 0 * prm->n, prm->n);
+    memcpy(pk_seed, SK + 2 * prm->n, prm->n);
+
+    uint32_t sig_fors_len = prm->k * (1 + prm->a) * prm->n;
+    uint32_t sig_ht_len = (prm->h + prm->d * prm->len) * prm->n;
+    // signature = Randomness + FORS signature + HT signature
+    uint8_t SIG[prm->n + sig_fors_len + sig_ht_len];
+    memcpy(SIG, R, prm->n);
+
+    const uint8_t *md;
+    uint64_t idx_tree, idx_leaf;
+    split_digest(prm, digest, &md, &idx_tree, &idx_leaf);
+
+    setTreeAddress(&adrs, idx_tree);
+    setTypeAndClear(&adrs, prm->FORS_TREE);
+    setKeyPairAddress(&adrs, idx_leaf);
+
+    // Generate FORS signature
+    uint8_t SIG_FORS[sig_fors_len];
+    STATS_START(t_fors_sign);
+    fors_sign(prm, md, sk_seed, pk_seed, adrs, SIG_FORS);
+    STATS_STOP(t_fors_sign, ns_fors_sign);
+
+    // Copy FORS signature to main signature
+    memcpy(SIG + prm->n, SIG_FORS, sig_fors_len);
+
+    uint8_t PK_FORS[prm->n];
+    STATS_START(t_fors_pk);
+    fors_pkFromSig(prm, SIG_FORS, md, pk_seed, adrs, PK_FORS);
+    STATS_STOP(t_fors_pk, ns_fors_pk);
+
+    // Generate and append HT signature
+    uint8_t SIG_HT[sig_ht_len];
+    ht_sign(prm, PK_FORS, sk_seed, pk_seed, idx_tree, idx_leaf, SIG_HT);
+    memcpy(SIG + prm->n + sig_fors_len, SIG_HT, sig_ht_len);
+    memcpy(buffer, SIG, prm->n + sig_fors_len + sig_ht_len);
+}
+
+// algorithm 19
+void slh_sign_internal(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer)
+{
+    Segment seg = { M, M_len };
+    slh_sign_internal_segments(prm, &seg, 1, SK, addrnd, buffer);
+}
+
+// algorithm 19, with the message given as a list of segments
+void slh_sign_internal_segments(Parameters *prm, const Segment *M, size_t M_count, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer)
+{
+    // Generate R using PRF
+    uint8_t R[prm->n];
+    STATS_START(t_prf_msg);
+    PRF_msg(prm, SK + 1 * prm->n, addrnd, M, M_count, R);
+    STATS_STOP(t_prf_msg, ns_PRF_msg);
+
+    // Generate message digest
+    uint8_t digest[prm->m];
+    STATS_START(t_h_msg);
+    H_msg(prm, R, SK + 2 * prm->n, SK + 3 * prm->n, M, M_count, digest);
+    STATS_STOP(t_h_msg, ns_H_msg);
+
+    sign_digest(prm, SK, R, digest, buffer);
+}
+
+// Absorbs M into PRF_msg and copies it into an unlinked temporary file at the same time
+// Returns a read-only mapping of the copy for the H_msg pass, or NULL on error
+static const uint8_t *stage_message(Parameters *prm, MsgReader *M, MsgCtx *ctx, size_t *M_len)
+{
+    uint8_t chunk[MSG_CHUNK_LEN];
+    ssize_t chunk_len;
+    size_t total = 0;
+
+    FILE *stage = tmpfile();
+    if (stage == NULL)
+        return NULL;
+    int fd = fileno(stage);
+
+    while ((chunk_len = M->read(M->arg, chunk, sizeof chunk)) > 0) {
+        PRF_msg_update(prm, ctx, chunk, chunk_len);
+        for (ssize_t off = 0; off < chunk_len; ) {
+            ssize_t written = write(fd, chunk + off, chunk_len - off);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written < 0) {
+                // the file is unlinked, closing it frees what was staged
+                fclose(stage);
+                return NULL;
+            }
+            off += written;
+        }
+        total += chunk_len;
+    }
+    if (chunk_len < 0) {
+        fclose(stage);
+        return NULL;
+    }
+
+    *M_len = total;
+    if (total == 0) {
+        fclose(stage);
+        return (const uint8_t *) "";
+    }
+
+    uint8_t *view = mmap(NULL, total, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive after it is closed
+    fclose(stage);
+    if (view == MAP_FAILED)
+        return NULL;
+    madvise(view, total, MADV_SEQUENTIAL);
+    return view;
+}
+
+// algorithm 19, with the message read from M in chunks
+// R depends on all of M and H_msg starts with R, so the message has to go through both hashes in turn.
+// With rewind, M is read twice. Without it, M is read once and staged in a mapped temporary file for H_msg.
+bool slh_sign_internal_reader(Parameters *prm, MsgReader *M, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer)
+{
+    uint8_t chunk[MSG_CHUNK_LEN];
+    ssize_t chunk_len;
+    MsgCtx ctx;
+
+    uint8_t R[prm->n];
+    uint8_t digest[prm->m];
+    STATS_START(t_prf_msg);
+    PRF_msg_init(prm, &ctx, SK + 1 * prm->n, addrnd);
+
+    if (M->rewind == NULL) {
+        size_t M_len;
+        const uint8_t *view = stage_message(prm, M, &ctx, &M_len);
+        if (view == NULL)
+            return false;
+        PRF_msg_final(prm, &ctx, R);
+        STATS_STOP(t_prf_msg, ns_PRF_msg);
+
+        STATS_START(t_h_msg);
+        H_msg_init(prm, &ctx, R, SK + 2 * prm->n, SK + 3 * prm->n);
+        H_msg_update(prm, &ctx, view, M_len);
+        H_msg_final(prm, &ctx, digest);
+        STATS_STOP(t_h_msg, ns_H_msg);
+        if (M_len > 0)
+            munmap((void *) view, M_len);
+
+        sign_digest(prm, SK, R, digest, buffer);
+        return true;
+    }
+
+    // a message that changes between the passes would get R of one message and the digest of another
+    size_t first_len = 0;
+    while ((chunk_len = M->read(M->arg, chunk, sizeof chunk)) > 0) {
+        PRF_msg_update(prm, &ctx, chunk, chunk_len);
+        first_len += chunk_len;
+    }
+    if (chunk_len < 0)
+        return false;
+    PRF_msg_final(prm, &ctx, R);
+    STATS_STOP(t_prf_msg, ns_PRF_msg);
+
+    if (!M->rewind(M->arg))
+        return false;
+
+    STATS_START(t_h_msg);
+    size_t second_len = 0;
+    H_msg_init(prm, &ctx, R, SK + 2 * prm->n, SK + 3 * prm->n);
+    while ((chunk_len = M->read(M->arg, chunk, sizeof chunk)) > 0) {
+        H_msg_update(prm, &ctx, chunk, chunk_len);
+        second_len += chunk_len;
+    }
+    if (chunk_len < 0 || second_len != first_len)
+        return false;
+    H_msg_final(prm, &ctx, digest);
+    STATS_STOP(t_h_msg, ns_H_msg);
+
+    sign_digest(prm, SK, R, digest, buffer);
+    return true;
+}
+
+// algorithm 20, lines 5 to 18: verifies SIG against the message digest
+static bool verify_digest(Parameters *prm, uint8_t *SIG, const uint8_t *PK, const uint8_t *digest)
+{
+    uint32_t sig_fors_len = prm->k * (1 + prm->a) * prm->n;
+    uint32_t sig_ht_len = (prm->h + prm->d * prm->len) * prm->n;
+
+    uint8_t pk_seed[prm->n];
+    uint8_t pk_root[prm->n];
+    memcpy(pk_seed, PK + 0 * prm->n, prm->n);
+    memcpy(pk_root, PK + 1 * prm->n, prm->n);
+
+    ADRS adrs;
+    initADRS(&adrs);
+
+    // Extract FORS and HT signatures
+    uint8_t SIG_FORS[sig_fors_len];
+    memcpy(SIG_FORS, SIG + prm->n, sig_fors_len);
+
+    uint8_t SIG_HT[sig_ht_len];
+    memcpy(SIG_HT, SIG + prm->n + sig_fors_len, sig_ht_len);
+
+    const uint8_t *md;
+    uint64_t idx_tree, idx_leaf;
+    split_digest(prm, digest, &md, &idx_tree, &idx_leaf);
+
+    setTreeAddress(&adrs, idx_tree);
+    setTypeAndClear(&adrs, prm->FORS_TREE);
+    setKeyPairAddress(&adrs, idx_leaf);
+
+    uint8_t PK_FORS[prm->n];
+    STATS_START(t_fors_pk);
+    fors_pkFromSig(prm, SIG_FORS, md, pk_seed, adrs, PK_FORS);
+    STATS_STOP(t_fors_pk, ns_fors_pk);
+
+    return ht_verify(prm, PK_FORS, SIG_HT, pk_seed, idx_tree, idx_leaf, pk_root);
+}
+
+static bool check_sig_len(Parameters *prm, size_t SIG_len)
+{
+    if (SIG_len != slh_signature_length(prm)) {
+        printf("Signature has invalid length\n");
+        return false;
+    }
+    return true;
+}
+
+// algorithm 20
+bool slh_verify_internal(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *PK)
+{
+    Segment seg = { M, M_len };
+    return slh_verify_internal_segments(prm, &seg, 1, SIG, SIG_len, PK);
+}
+
+// algorithm 20, with the message given as a list of segments
+bool slh_verify_internal_segments(Parameters *prm, const Segment *M, size_t M_count, uint8_t *SIG, size_t SIG_len, const uint8_t *PK)
+{
+    if (!check_sig_len(prm, SIG_len))
+        return false;
+
+    uint8_t digest[prm->m];
+    STATS_START(t_h_msg);
+    H_msg(prm, SIG, PK, PK + prm->n, M, M_count, digest);
+    STATS_STOP(t_h_msg, ns_H_msg);
+
+    return verify_digest(prm, SIG, PK, digest);
+}
+
+// algorithm 20, with the message read from M in chunks
+bool slh_verify_internal_reader(Parameters *prm, MsgReader *M, uint8_t *SIG, size_t SIG_len, const uint8_t *PK)
+{
+    if (!check_sig_len(prm, SIG_len))
+        return false;
+
+    uint8_t chunk[MSG_CHUNK_LEN];
+    ssize_t chunk_len;
+    MsgCtx ctx;
+
+    uint8_t digest[prm->m];
+    STATS_START(t_h_msg);
+    H_msg_init(prm, &ctx, SIG, PK, PK + prm->n);
+    while ((chunk_len = M->read(M->arg, chunk, sizeof chunk)) > 0)
+        H_msg_update(prm, &ctx, chunk, chunk_len);
+    if (chunk_len < 0)
+        return false;
+    H_msg_final(prm, &ctx, digest);
+    STATS_STOP(t_h_msg, ns_H_msg);
+
+    return verify_digest(prm, SIG, PK, digest);
+}
@@ -3,10 +3,40 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include "params.h"
+#include "shake.h"
+
+// size of the chunks in which a MsgReader is consumed
+#define MSG_CHUNK_LEN 16384
+
+// Streaming source of a message
+// read() copies up to len bytes into buf and returns their number, 0 marks the end of the message and -1 an error
+// rewind() restarts the message from the beginning, signing then reads the message twice
+// and fails unless both passes yield the same number of bytes, the bytes themselves are not compared,
+// so the source must give the same message twice
+// if rewind is NULL, signing reads the message once and stages it in a temporary file
+typedef struct {
+    ssize_t (*read)(void *arg, uint8_t *buf, size_t len);
+    bool (*rewind)(void *arg);
+    void *arg;
+} MsgReader;
+
+// Splits the message digest into md and the tree and leaf index of the signing key pair (algorithm 19, lines 7 to 12)
+// md points into digest and may be NULL
+void split_digest(Parameters *prm, const uint8_t *digest, const uint8_t **md, uint64_t *idx_tree, uint64_t *idx_leaf);
 
 void slh_keygen_internal(Parameters *prm, uint8_t *sk_seed, uint8_t *sk_prf, uint8_t *pk_seed, uint8_t *SK, uint8_t *PK);
 
 void slh_sign_internal(Parameters *prm, uint8_t *M, size_t M_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer);
 
+void slh_sign_internal_segments(Parameters *prm, const Segment *M, size_t M_count, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer);
+
+// Returns false if M could not be read, the two passes differ in length or the message could not be staged
+bool slh_sign_internal_reader(Parameters *prm, MsgReader *M, const uint8_t *SK, const uint8_t *addrnd, uint8_t *buffer);
+
 bool slh_verify_internal(Parameters *prm, uint8_t *M, size_t M_len, uint8_t *SIG, size_t SIG_len, const uint8_t *PK);
+
+bool slh_verify_internal_segments(Parameters *prm, const Segment *M, size_t M_count, uint8_t *SIG, size_t SIG_len, const uint8_t *PK);
+
+bool slh_verify_internal_reader(Parameters *prm, MsgReader *M, uint8_t *SIG, size_t SIG_len, const uint8_t *PK);
@@ -29,7 +29,7 @@ int main(void)
     // memset(SK, 0, prm.n * 4);
     memset(PK, 0, sizeof PK);
 
-    uint32_t sig_len = prm.n + (prm.k * (1 + prm.a) * prm.n) + ((prm.h + prm.d * prm.len) * prm.n);
+    uint32_t sig_len = slh_signature_length(&prm);
     uint8_t SIG[sig_len];
     uint8_t M[6286] = {0};
     uint8_t ctx[251] = {0};
@@ -80,7 +80,13 @@ int main(void)
     */
 
     // Our own tests
-    char *parameter_sets[6] = {
+    char *parameter_sets[12] = {
+        "SLH-DSA-SHA2-128f",
+        "SLH-DSA-SHA2-128s",
+        "SLH-DSA-SHA2-192f",
+        "SLH-DSA-SHA2-192s",
+        "SLH-DSA-SHA2-256f",
+        "SLH-DSA-SHA2-256s",
         "SLH-DSA-SHAKE-128f",
         "SLH-DSA-SHAKE-128s",
         "SLH-DSA-SHAKE-192f",
@@ -88,14 +94,22 @@ int main(void)
         "SLH-DSA-SHAKE-256f",
         "SLH-DSA-SHAKE-256s"
     };
-    char *hash_functions[4] = {
-        "SHA-256",
-        "SHA-512",
-        "SHAKE128",
-        "SHAKE256"
+    PreHash hash_functions[12] = {
+        PH_SHA_224,
+        PH_SHA_256,
+        PH_SHA_384,
+        PH_SHA_512,
+        PH_SHA_512_224,
+        PH_SHA_512_256,
+        PH_SHA3_224,
+        PH_SHA3_256,
+        PH_SHA3_384,
+        PH_SHA3_512,
+        PH_SHAKE128,
+        PH_SHAKE256
     };
 
-    for (uint32_t i = 0; i < 6; i++) {
+    for (uint32_t i = 0; i < 12; i++) {
         setup_parameter_set(&prm, parameter_sets[i]);
 
         uint8_t sk_seed[prm.n];
@@ -111,7 +125,7 @@ int main(void)
 
         uint8_t M[10];
         uint8_t ctx[1];
-        uint32_t sig_len = prm.n + (prm.k * (1 + prm.a) * prm.n) + ((prm.h + prm.d * prm.len) * prm.n);
+        uint32_t sig_len = slh_signature_length(&prm);
         uint8_t SIG[sig_len];
 
         memset(M, 0, sizeof M);
@@ -126,7 +140,7 @@ int main(void)
 
         bool result = slh_verify(&prm, M, sizeof M, SIG, sizeof SIG, ctx, sizeof ctx, PK);
 
-        for (uint32_t j = 0; j < 4; j++) {
+        for (uint32_t j = 0; j < 12; j++) {
             memset(M, 0, sizeof M);
             memset(ctx, 0, sizeof ctx);
             memset(SIG, 0, sizeof SIG);
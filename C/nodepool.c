@@ -0,0 +1,232 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "nodepool.h"
+#include "nodes.h"
+
+struct NodeKey {
+    NodeKey *next;
+    uint32_t home;
+    bool replicated;
+    size_t size;                // bytes of each replica
+    uint8_t *replica[NODE_MAX]; // SK || top tree, on the node of the same index
+};
+
+struct NodePool {
+    uint32_t nodes;
+    Pool *pools[NODE_MAX];
+    uint32_t next_home;
+    atomic_uint next_node;      // round robin over the nodes for spread items, shared by concurrent batches
+    NodeKey *keys;
+};
+
+NodePool *nodepool_create(uint32_t nodes, uint32_t threads_per_node)
+{
+    uint32_t available = node_count();
+    if (nodes == 0 || nodes > available)
+        nodes = available;
+
+    NodePool *np = calloc(1, sizeof *np);
+    if (np == NULL)
+        return NULL;
+    atomic_init(&np->next_node, 0);
+    for (uint32_t node = 0; node < nodes; node++) {
+        uint32_t cpus[NODE_MAX_CPUS];
+        uint32_t count = node_cpus(node, cpus, NODE_MAX_CPUS);
+        if (threads_per_node != 0 && count > threads_per_node)
+            count = threads_per_node;
+        np->pools[node] = pool_create_pinned(cpus, count);
+        if (np->pools[node] == NULL) {
+            printf("Error starting the workers of node %u\n", node);
+            nodepool_destroy(np);
+            return NULL;
+        }
+        np->nodes++;
+    }
+    return np;
+}
+
+static void free_key(NodeKey *key)
+{
+    for (uint32_t node = 0; node < NODE_MAX; node++) {
+        if (key->replica[node] != NULL)
+            munmap(key->replica[node], key->size);
+    }
+    free(key);
+}
+
+void nodepool_destroy(NodePool *np)
+{
+    if (np == NULL)
+        return;
+    for (uint32_t node = 0; node < np->nodes; node++)
+        pool_destroy(np->pools[node]);
+    while (np->keys != NULL) {
+        NodeKey *key = np->keys;
+        np->keys = key->next;
+        free_key(key);
+    }
+    free(np);
+}
+
+uint32_t nodepool_nodes(const NodePool *np)
+{
+    return np->nodes;
+}
+
+Pool *nodepool_pool(NodePool *np, uint32_t node)
+{
+    return np->pools[node];
+}
+
+typedef struct {
+    uint8_t *memory;
+    size_t size;
+    size_t page;
+} Touch;
+
+// Page i of a replica is written first by a worker of the node, so the kernel places it there
+static void touch_job(void *arg, size_t i)
+{
+    Touch *t = arg;
+    size_t len = t->size - i * t->page < t->page ? t->size - i * t->page : t->page;
+    memset(t->memory + i * t->page, 0, len);
+}
+
+// SK and the top tree in memory of the given node
+static uint8_t *make_replica(NodePool *np, uint32_t node, Parameters *prm, const uint8_t *SK, size_t size)
+{
+    // mmap instead of malloc, so the pages are fresh and untouched
+    uint8_t *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return NULL;
+
+    long page = sysconf(_SC_PAGESIZE);
+    Touch t = { memory, size, page > 0 ? page : 4096 };
+    pool_run(np->pools[node], touch_job, &t, (size + t.page - 1) / t.page);
+
+    memcpy(memory, SK, 4 * prm->n);
+    if (!slh_expand_key(prm, np->pools[node], memory, memory + 4 * prm->n)) {
+        printf("Error expanding key, the root differs from PK.root\n");
+        munmap(memory, size);
+        return NULL;
+    }
+    return memory;
+}
+
+NodeKey *nodepool_add_key(NodePool *np, Parameters *prm, const uint8_t *SK, bool replicate)
+{
+    NodeKey *key = calloc(1, sizeof *key);
+    if (key == NULL)
+        return NULL;
+    key->home = np->next_home;
+    np->next_home = (np->next_home + 1) % np->nodes;
+    key->replicated = replicate;
+    key->size = 4 * prm->n + slh_top_tree_size(prm);
+
+    for (uint32_t node = 0; node < np->nodes; node++) {
+        if (!replicate && node != key->home)
+            continue;
+        key->replica[node] = make_replica(np, node, prm, SK, key->size);
+        if (key->replica[node] == NULL) {
+            free_key(key);
+            return NULL;
+        }
+    }
+    key->next = np->keys;
+    np->keys = key;
+    return key;
+}
+
+typedef struct {
+    NodePool *np;
+    uint32_t node;
+    Parameters *prm;
+    SignItem *items;
+    size_t count;
+    bool deterministic;
+    bool *ok;
+} NodeBatch;
+
+static void *node_sign(void *arg)
+{
+    NodeBatch *nb = arg;
+    slh_sign_batch(nb->prm, nb->np->pools[nb->node], nb->items, nb->count, nb->deterministic, nb->ok);
+    return NULL;
+}
+
+void nodepool_sign_batch(NodePool *np, Parameters *prm, const SignItem *items, NodeKey *const *keys, size_t count, bool deterministic, bool *ok)
+{
+    if (count == 0)
+        return;
+
+    // counting sort of the items by node, every node gets a contiguous run of routed, item i goes to routed[slot[i]]
+    SignItem *routed = malloc(count * sizeof *routed);
+    bool *routed_ok = malloc(count * sizeof *routed_ok);
+    uint32_t *node_of = malloc(count * sizeof *node_of);
+    size_t *slot = malloc(count * sizeof *slot);
+    if (routed == NULL || routed_ok == NULL || node_of == NULL || slot == NULL) {
+        printf("Error allocating memory\n");
+        for (size_t i = 0; ok != NULL && i < count; i++)
+            ok[i] = false;
+        free(routed);
+        free(routed_ok);
+        free(node_of);
+        free(slot);
+        return;
+    }
+    size_t start[NODE_MAX + 1] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        const NodeKey *key = keys != NULL ? keys[i] : NULL;
+        if (key != NULL && !key->replicated) {
+            node_of[i] = key->home;
+        } else {
+            node_of[i] = atomic_fetch_add(&np->next_node, 1) % np->nodes;
+        }
+        start[node_of[i] + 1]++;
+    }
+    for (uint32_t node = 0; node < np->nodes; node++)
+        start[node + 1] += start[node];
+
+    size_t fill[NODE_MAX];
+    memcpy(fill, start, sizeof fill);
+    for (size_t i = 0; i < count; i++) {
+        SignItem it = items[i];
+        const NodeKey *key = keys != NULL ? keys[i] : NULL;
+        if (key != NULL) {
+            it.SK = key->replica[node_of[i]];
+            it.top = key->replica[node_of[i]] + 4 * prm->n;
+        }
+        slot[i] = fill[node_of[i]]++;
+        routed[slot[i]] = it;
+    }
+
+    // node 0 signs in the calling thread, the others in helper threads that only wait on their pools
+    NodeBatch nb[NODE_MAX];
+    pthread_t helper[NODE_MAX];
+    bool started[NODE_MAX] = { false };
+    for (uint32_t node = 0; node < np->nodes; node++) {
+        nb[node] = (NodeBatch) { np, node, prm, routed + start[node], start[node + 1] - start[node], deterministic, routed_ok + start[node] };
+        if (node > 0 && nb[node].count > 0)
+            started[node] = pthread_create(&helper[node], NULL, node_sign, &nb[node]) == 0;
+    }
+    node_sign(&nb[0]);
+    for (uint32_t node = 1; node < np->nodes; node++) {
+        if (started[node])
+            pthread_join(helper[node], NULL);
+        else
+            node_sign(&nb[node]);
+    }
+
+    for (size_t i = 0; ok != NULL && i < count; i++)
+        ok[i] = routed_ok[slot[i]];
+
+    free(node_of);
+    free(slot);
+    free(routed_ok);
+    free(routed);
+}
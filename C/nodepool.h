@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "batch.h"
+#include "params.h"
+#include "pool.h"
+
+// One pool of pinned workers per NUMA node, with keys whose expanded top tree lives in the memory of a node
+// A key has a home node that signs all of its messages, or a replica of the top tree on every node
+// so that its messages can be spread over all nodes. Memory is placed by first touch:
+// the workers of a node write the pages of its replicas and their own stacks, the signing scratch memory.
+typedef struct NodePool NodePool;
+typedef struct NodeKey NodeKey;
+
+// Starts workers on the first nodes NUMA nodes (0 uses all of them), threads_per_node workers
+// per node pinned to its CPUs (0 uses every CPU of the node)
+// Returns NULL if a node has no usable CPUs or the threads could not be started
+NodePool *nodepool_create(uint32_t nodes, uint32_t threads_per_node);
+
+// Stops all workers and frees the keys of the pool
+void nodepool_destroy(NodePool *np);
+
+uint32_t nodepool_nodes(const NodePool *np);
+
+Pool *nodepool_pool(NodePool *np, uint32_t node);
+
+// Copies SK and expands its top tree (slh_expand_key) on its home node, or on every node if replicate is set
+// Home nodes are handed out round robin. Returns NULL if memory ran out or SK is inconsistent.
+NodeKey *nodepool_add_key(NodePool *np, Parameters *prm, const uint8_t *SK, bool replicate);
+
+// Signs count messages like slh_sign_batch, keys[i] (or NULL) is the key of items[i]
+// An item with a key goes to the key's home node and uses the node's copy of its SK and top tree,
+// items of replicated keys and without a key are spread over the nodes
+// The nodes sign their share at the same time, each with its own pool
+// ok is as for slh_sign_batch, all of it is false if the routing tables could not be allocated
+// Several threads may call it at once, nodepool_add_key must not run alongside it
+void nodepool_sign_batch(NodePool *np, Parameters *prm, const SignItem *items, NodeKey *const *keys, size_t count, bool deterministic, bool *ok);
@@ -0,0 +1,108 @@
+// sched_getaffinity
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "nodes.h"
+
+// Parses a sysfs list like "0-3,8-11" and calls add for every number in it
+// Returns false if the file could not be read
+static bool read_list(const char *path, void (*add)(void *arg, uint32_t value), void *arg)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+
+    unsigned first, last;
+    int c;
+    while (fscanf(f, "%u", &first) == 1) {
+        last = first;
+        c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%u", &last) != 1)
+                break;
+            c = fgetc(f);
+        }
+        for (unsigned v = first; v <= last; v++)
+            add(arg, v);
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+    return true;
+}
+
+typedef struct {
+    uint32_t *values;
+    uint32_t count;
+    uint32_t max;
+} List;
+
+static void list_add(void *arg, uint32_t value)
+{
+    List *l = arg;
+    if (l->count < l->max)
+        l->values[l->count++] = value;
+}
+
+// The nodes that have CPUs, in the order of their numbers
+static uint32_t online_nodes(uint32_t nodes[NODE_MAX])
+{
+    uint32_t online[NODE_MAX];
+    List l = { online, 0, NODE_MAX };
+    if (!read_list("/sys/devices/system/node/online", list_add, &l))
+        return 0;
+
+    // memory-only nodes have an empty cpulist
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < l.count; i++) {
+        char path[64];
+        uint32_t cpu;
+        List cpus = { &cpu, 0, 1 };
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%u/cpulist", online[i]);
+        if (read_list(path, list_add, &cpus) && cpus.count > 0)
+            nodes[count++] = online[i];
+    }
+    return count;
+}
+
+uint32_t node_count(void)
+{
+    uint32_t nodes[NODE_MAX];
+    uint32_t count = online_nodes(nodes);
+    return count > 0 ? count : 1;
+}
+
+uint32_t node_cpus(uint32_t node, uint32_t *cpus, uint32_t max)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0)
+        return 0;
+
+    uint32_t nodes[NODE_MAX];
+    uint32_t count = online_nodes(nodes);
+    uint32_t listed[NODE_MAX_CPUS];
+    List l = { listed, 0, NODE_MAX_CPUS };
+    if (count == 0) {
+        // one node with every CPU
+        if (node != 0)
+            return 0;
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE && l.count < NODE_MAX_CPUS; cpu++)
+            list_add(&l, cpu);
+    } else {
+        if (node >= count)
+            return 0;
+        char path[64];
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%u/cpulist", nodes[node]);
+        read_list(path, list_add, &l);
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < l.count && n < max; i++) {
+        if (listed[i] < CPU_SETSIZE && CPU_ISSET(listed[i], &allowed))
+            cpus[n++] = listed[i];
+    }
+    return n;
+}
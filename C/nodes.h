@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+// Most NUMA nodes that are told apart, CPUs of further nodes are left out
+#define NODE_MAX 64
+
+// Most CPUs per node that node_cpus reports
+#define NODE_MAX_CPUS 1024
+
+// Number of NUMA nodes with CPUs, read from /sys/devices/system/node
+// Without that directory (no NUMA support in the kernel) the machine counts as one node
+uint32_t node_count(void);
+
+// Writes up to max CPU numbers of the given node (0 .. node_count() - 1) to cpus and returns their number
+// Only CPUs the calling thread may run on are listed
+uint32_t node_cpus(uint32_t node, uint32_t *cpus, uint32_t max);
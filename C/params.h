@@ -23,6 +23,11 @@ typedef struct {
     uint8_t m;
     uint8_t len1;
     uint8_t len;
+    uint8_t sha2;   // 1 for the SLH-DSA-SHA2-* sets, 0 for SLH-DSA-SHAKE-*
+    char name[20];  // the name given to setup_parameter_set, e.g. "SLH-DSA-SHAKE-128f"
 } Parameters;
 
 void setup_parameter_set(Parameters *prm, const char* name);
+
+// Bytes of a signature: R, k FORS trees of 1 + a nodes and d XMSS signatures, n + k * (1 + a) * n + (h + d * len) * n
+uint32_t slh_signature_length(const Parameters *prm);
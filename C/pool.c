@@ -0,0 +1,156 @@
+// pthread_attr_setaffinity_np
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+struct Pool {
+    pthread_t *threads;
+    uint32_t count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;       // signalled when a new batch is posted or the pool stops
+    pthread_cond_t done;        // signalled when the last worker leaves a batch
+    pthread_mutex_t run_lock;   // one batch at a time
+
+    // current batch, guarded by lock
+    void (*job)(void *arg, size_t i);
+    void *arg;
+    size_t jobs;
+    size_t next;
+    uint64_t generation;
+    uint32_t busy;
+    bool stop;
+};
+
+static void *worker(void *arg)
+{
+    Pool *pool = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+
+        while (pool->next < pool->jobs) {
+            size_t i = pool->next++;
+            pthread_mutex_unlock(&pool->lock);
+            pool->job(pool->arg, i);
+            pthread_mutex_lock(&pool->lock);
+        }
+
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Starts threads workers, worker i is pinned to cpus[i] if cpus is not NULL
+static Pool *pool_start(uint32_t threads, const uint32_t *cpus)
+{
+    Pool *pool = calloc(1, sizeof *pool);
+    if (pool == NULL)
+        return NULL;
+    pool->threads = calloc(threads, sizeof *pool->threads);
+    if (pool->threads == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_STACK_SIZE);
+    for (uint32_t i = 0; i < threads; i++) {
+        if (cpus != NULL) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[i], &set);
+            pthread_attr_setaffinity_np(&attr, sizeof set, &set);
+        }
+        if (pthread_create(&pool->threads[i], &attr, worker, pool) != 0) {
+            printf("Error starting worker thread\n");
+            pthread_attr_destroy(&attr);
+            pool_destroy(pool);
+            return NULL;
+        }
+        pool->count++;
+    }
+    pthread_attr_destroy(&attr);
+    return pool;
+}
+
+Pool *pool_create(uint32_t threads)
+{
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    return pool_start(threads, NULL);
+}
+
+Pool *pool_create_pinned(const uint32_t *cpus, uint32_t count)
+{
+    if (count == 0)
+        return NULL;
+    return pool_start(count, cpus);
+}
+
+void pool_destroy(Pool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->run_lock);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+uint32_t pool_size(const Pool *pool)
+{
+    return pool->count;
+}
+
+void pool_run(Pool *pool, void (*job)(void *arg, size_t i), void *arg, size_t count)
+{
+    if (count == 0)
+        return;
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->jobs = count;
+    pool->next = 0;
+    pool->busy = pool->count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Fixed set of worker threads that is reused for every batch
+typedef struct Pool Pool;
+
+// Stack size of every thread that signs or verifies: the pool's workers and those of the scheduler and the async queue
+// The signing code keeps its working memory in VLAs, so each worker's stack is its scratch arena
+#define POOL_STACK_SIZE (8 << 20)
+
+// Starts a pool with the given number of workers, 0 uses one worker per online CPU
+// Returns NULL if the threads could not be started
+Pool *pool_create(uint32_t threads);
+
+// Starts one worker per entry of cpus, pinned to that CPU
+// A worker's stack is first touched by the worker, so with the kernel's default policy it lives on the worker's NUMA node
+// Returns NULL if count is 0 or the threads could not be started
+Pool *pool_create_pinned(const uint32_t *cpus, uint32_t count);
+
+// Stops and joins all workers
+void pool_destroy(Pool *pool);
+
+uint32_t pool_size(const Pool *pool);
+
+// Calls job(arg, i) for every i in [0, count) on the workers and returns when all calls are done
+// Indices are handed out in increasing order, whichever worker is free takes the next one
+void pool_run(Pool *pool, void (*job)(void *arg, size_t i), void *arg, size_t count);
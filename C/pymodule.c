@@ -0,0 +1,590 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "batch.h"
+#include "external.h"
+#include "internal.h"
+#include "params.h"
+#include "pool.h"
+#include "rng.h"
+
+// CPython extension module _slhdsa, built with make python
+// The functions take the parameter set name first, the other arguments are those of the python/ reference implementation
+// Inputs can be any contiguous buffer (bytes, bytearray, memoryview, ...) and are read in place
+// The GIL is released while hashing, so Python threads sign and verify in parallel
+
+static const char *set_names[12] = {
+    "SLH-DSA-SHA2-128s", "SLH-DSA-SHA2-128f", "SLH-DSA-SHA2-192s", "SLH-DSA-SHA2-192f",
+    "SLH-DSA-SHA2-256s", "SLH-DSA-SHA2-256f", "SLH-DSA-SHAKE-128s", "SLH-DSA-SHAKE-128f",
+    "SLH-DSA-SHAKE-192s", "SLH-DSA-SHAKE-192f", "SLH-DSA-SHAKE-256s", "SLH-DSA-SHAKE-256f"
+};
+
+static Parameters sets[12];
+
+// Names of the pre-hash functions as in python/external.py
+static const struct {
+    const char *name;
+    PreHash PH;
+} prehash_names[12] = {
+    { "SHA-256",     PH_SHA_256 },
+    { "SHA-384",     PH_SHA_384 },
+    { "SHA-512",     PH_SHA_512 },
+    { "SHA-224",     PH_SHA_224 },
+    { "SHA-512/224", PH_SHA_512_224 },
+    { "SHA-512/256", PH_SHA_512_256 },
+    { "SHA3-224",    PH_SHA3_224 },
+    { "SHA3-256",    PH_SHA3_256 },
+    { "SHA3-384",    PH_SHA3_384 },
+    { "SHA3-512",    PH_SHA3_512 },
+    { "SHAKE128",    PH_SHAKE128 },
+    { "SHAKE256",    PH_SHAKE256 }
+};
+
+// Workers of the batch functions, started on first use and shared by all callers
+static Pool *pool;
+
+static Parameters *get_set(const char *name)
+{
+    for (int i = 0; i < 12; i++) {
+        if (strcmp(name, set_names[i]) == 0)
+            return &sets[i];
+    }
+    PyErr_Format(PyExc_ValueError, "unknown parameter set %s", name);
+    return NULL;
+}
+
+static bool get_prehash(const char *name, PreHash *PH)
+{
+    for (int i = 0; i < 12; i++) {
+        if (strcmp(name, prehash_names[i].name) == 0) {
+            *PH = prehash_names[i].PH;
+            return true;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "unsupported pre-hash function %s", name);
+    return false;
+}
+
+static Pool *get_pool(void)
+{
+    if (pool == NULL) {
+        pool = pool_create(0);
+        if (pool == NULL)
+            PyErr_SetString(PyExc_OSError, "could not start the worker threads");
+    }
+    return pool;
+}
+
+static bool check_length(const Py_buffer *buf, size_t len, const char *name)
+{
+    if ((size_t) buf->len != len) {
+        PyErr_Format(PyExc_ValueError, "%s must be %zu bytes", name, len);
+        return false;
+    }
+    return true;
+}
+
+static bool check_ctx(const Py_buffer *ctx)
+{
+    if (ctx->len > MAX_CTX_LENGTH) {
+        PyErr_SetString(PyExc_ValueError, "ctx must be at most 255 bytes");
+        return false;
+    }
+    return true;
+}
+
+static void release(Py_buffer **bufs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (bufs[i]->obj != NULL)
+            PyBuffer_Release(bufs[i]);
+    }
+}
+
+static PyObject *py_slh_keygen_internal(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "sk_seed", "sk_prf", "pk_seed", NULL };
+    const char *name;
+    Py_buffer sk_seed = { 0 }, sk_prf = { 0 }, pk_seed = { 0 };
+    Py_buffer *bufs[] = { &sk_seed, &sk_prf, &pk_seed };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*", keywords, &name, &sk_seed, &sk_prf, &pk_seed))
+        return NULL;
+
+    PyObject *result = NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || !check_length(&sk_seed, prm->n, "sk_seed") || !check_length(&sk_prf, prm->n, "sk_prf")
+        || !check_length(&pk_seed, prm->n, "pk_seed"))
+        goto done;
+
+    PyObject *SK = PyBytes_FromStringAndSize(NULL, 4 * prm->n);
+    PyObject *PK = PyBytes_FromStringAndSize(NULL, 2 * prm->n);
+    if (SK != NULL && PK != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        slh_keygen_internal(prm, sk_seed.buf, sk_prf.buf, pk_seed.buf, (uint8_t *) PyBytes_AS_STRING(SK), (uint8_t *) PyBytes_AS_STRING(PK));
+        Py_END_ALLOW_THREADS
+        result = PyTuple_Pack(2, SK, PK);
+    }
+    Py_XDECREF(SK);
+    Py_XDECREF(PK);
+
+done:
+    release(bufs, 3);
+    return result;
+}
+
+// Like python/external.py, empty seeds are generated randomly
+static PyObject *py_slh_keygen(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "SK_seed", "SK_prf", "PK_seed", NULL };
+    const char *name;
+    Py_buffer in[3] = { { 0 }, { 0 }, { 0 } };
+    Py_buffer *bufs[] = { &in[0], &in[1], &in[2] };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|y*y*y*", keywords, &name, &in[0], &in[1], &in[2]))
+        return NULL;
+
+    PyObject *result = NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL)
+        goto done;
+
+    // n is at most 32, a fixed size lets the error paths jump over the buffer
+    uint8_t seeds[3][32];
+    static const char *seed_names[3] = { "SK_seed", "SK_prf", "PK_seed" };
+    for (int i = 0; i < 3; i++) {
+        if (in[i].obj != NULL && in[i].len != 0) {
+            if (!check_length(&in[i], prm->n, seed_names[i]))
+                goto done;
+            memcpy(seeds[i], in[i].buf, prm->n);
+        } else if (!random_bytes(seeds[i], prm->n)) {
+            PyErr_SetString(PyExc_OSError, "could not generate random seeds");
+            goto done;
+        }
+    }
+
+    PyObject *SK = PyBytes_FromStringAndSize(NULL, 4 * prm->n);
+    PyObject *PK = PyBytes_FromStringAndSize(NULL, 2 * prm->n);
+    if (SK != NULL && PK != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        slh_keygen_internal(prm, seeds[0], seeds[1], seeds[2], (uint8_t *) PyBytes_AS_STRING(SK), (uint8_t *) PyBytes_AS_STRING(PK));
+        Py_END_ALLOW_THREADS
+        result = PyTuple_Pack(2, SK, PK);
+    }
+    Py_XDECREF(SK);
+    Py_XDECREF(PK);
+    memset(seeds, 0, sizeof seeds);
+
+done:
+    release(bufs, 3);
+    return result;
+}
+
+static PyObject *py_slh_sign_internal(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "SK", "addrnd", NULL };
+    const char *name;
+    Py_buffer M = { 0 }, SK = { 0 }, addrnd = { 0 };
+    Py_buffer *bufs[] = { &M, &SK, &addrnd };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*", keywords, &name, &M, &SK, &addrnd))
+        return NULL;
+
+    PyObject *SIG = NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || !check_length(&SK, 4 * prm->n, "SK") || !check_length(&addrnd, prm->n, "addrnd"))
+        goto done;
+
+    SIG = PyBytes_FromStringAndSize(NULL, slh_signature_length(prm));
+    if (SIG != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        slh_sign_internal(prm, M.buf, M.len, SK.buf, addrnd.buf, (uint8_t *) PyBytes_AS_STRING(SIG));
+        Py_END_ALLOW_THREADS
+    }
+
+done:
+    release(bufs, 3);
+    return SIG;
+}
+
+static PyObject *py_slh_sign(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "ctx", "SK", "deterministic", NULL };
+    const char *name;
+    Py_buffer M = { 0 }, ctx = { 0 }, SK = { 0 };
+    Py_buffer *bufs[] = { &M, &ctx, &SK };
+    int deterministic = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*|p", keywords, &name, &M, &ctx, &SK, &deterministic))
+        return NULL;
+
+    PyObject *SIG = NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || !check_ctx(&ctx) || !check_length(&SK, 4 * prm->n, "SK"))
+        goto done;
+
+    // the randomness is drawn here, so a failing generator raises instead of signing with stale bytes
+    uint8_t addrnd[32];
+    if (deterministic)
+        memcpy(addrnd, (uint8_t *) SK.buf + 2 * prm->n, prm->n);
+    else if (!random_bytes(addrnd, prm->n)) {
+        PyErr_SetString(PyExc_OSError, "could not generate random bytes");
+        goto done;
+    }
+
+    SIG = PyBytes_FromStringAndSize(NULL, slh_signature_length(prm));
+    if (SIG != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        slh_sign_addrnd(prm, M.buf, M.len, ctx.buf, ctx.len, SK.buf, addrnd, (uint8_t *) PyBytes_AS_STRING(SIG));
+        Py_END_ALLOW_THREADS
+    }
+
+done:
+    release(bufs, 3);
+    return SIG;
+}
+
+static PyObject *py_hash_slh_sign(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "ctx", "PH", "SK", "deterministic", NULL };
+    const char *name, *ph_name;
+    Py_buffer M = { 0 }, ctx = { 0 }, SK = { 0 };
+    Py_buffer *bufs[] = { &M, &ctx, &SK };
+    int deterministic = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*sy*|p", keywords, &name, &M, &ctx, &ph_name, &SK, &deterministic))
+        return NULL;
+
+    PyObject *SIG = NULL;
+    PreHash PH;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || !get_prehash(ph_name, &PH) || !check_ctx(&ctx) || !check_length(&SK, 4 * prm->n, "SK"))
+        goto done;
+
+    uint8_t addrnd[32];
+    if (deterministic)
+        memcpy(addrnd, (uint8_t *) SK.buf + 2 * prm->n, prm->n);
+    else if (!random_bytes(addrnd, prm->n)) {
+        PyErr_SetString(PyExc_OSError, "could not generate random bytes");
+        goto done;
+    }
+
+    SIG = PyBytes_FromStringAndSize(NULL, slh_signature_length(prm));
+    if (SIG != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        hash_slh_sign_addrnd(prm, M.buf, M.len, ctx.buf, ctx.len, PH, SK.buf, addrnd, (uint8_t *) PyBytes_AS_STRING(SIG));
+        Py_END_ALLOW_THREADS
+    }
+
+done:
+    release(bufs, 3);
+    return SIG;
+}
+
+static PyObject *py_slh_verify_internal(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "SIG", "PK", NULL };
+    const char *name;
+    Py_buffer M = { 0 }, SIG = { 0 }, PK = { 0 };
+    Py_buffer *bufs[] = { &M, &SIG, &PK };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*", keywords, &name, &M, &SIG, &PK))
+        return NULL;
+
+    PyObject *result = NULL;
+    Parameters *prm = get_set(name);
+    if (prm != NULL && check_length(&PK, 2 * prm->n, "PK")) {
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = slh_verify_internal(prm, M.buf, M.len, SIG.buf, SIG.len, PK.buf);
+        Py_END_ALLOW_THREADS
+        result = PyBool_FromLong(ok);
+    }
+
+    release(bufs, 3);
+    return result;
+}
+
+static PyObject *py_slh_verify(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "ctx", "SIG", "PK", NULL };
+    const char *name;
+    Py_buffer M = { 0 }, ctx = { 0 }, SIG = { 0 }, PK = { 0 };
+    Py_buffer *bufs[] = { &M, &ctx, &SIG, &PK };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*y*", keywords, &name, &M, &ctx, &SIG, &PK))
+        return NULL;
+
+    PyObject *result = NULL;
+    Parameters *prm = get_set(name);
+    if (prm != NULL && check_length(&PK, 2 * prm->n, "PK")) {
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = slh_verify(prm, M.buf, M.len, SIG.buf, SIG.len, ctx.buf, ctx.len, PK.buf);
+        Py_END_ALLOW_THREADS
+        result = PyBool_FromLong(ok);
+    }
+
+    release(bufs, 4);
+    return result;
+}
+
+static PyObject *py_hash_slh_verify(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "M", "SIG", "ctx", "PH", "PK", NULL };
+    const char *name, *ph_name;
+    Py_buffer M = { 0 }, SIG = { 0 }, ctx = { 0 }, PK = { 0 };
+    Py_buffer *bufs[] = { &M, &SIG, &ctx, &PK };
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*y*y*sy*", keywords, &name, &M, &SIG, &ctx, &ph_name, &PK))
+        return NULL;
+
+    PyObject *result = NULL;
+    PreHash PH;
+    Parameters *prm = get_set(name);
+    if (prm != NULL && get_prehash(ph_name, &PH) && check_length(&PK, 2 * prm->n, "PK")) {
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = hash_slh_verify(prm, M.buf, M.len, SIG.buf, SIG.len, ctx.buf, ctx.len, PH, PK.buf);
+        Py_END_ALLOW_THREADS
+        result = PyBool_FromLong(ok);
+    }
+
+    release(bufs, 4);
+    return result;
+}
+
+// Gets the buffers of count tuples with fields entries each, bufs holds count * fields views
+// Returns false with an exception set, the views taken so far stay in bufs for release
+static bool get_items(PyObject *seq, Py_ssize_t count, int fields, const char *what, Py_buffer *bufs)
+{
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != fields) {
+            PyErr_Format(PyExc_TypeError, "items must be %s tuples", what);
+            return false;
+        }
+        for (int f = 0; f < fields; f++) {
+            if (PyObject_GetBuffer(PyTuple_GET_ITEM(item, f), &bufs[i * fields + f], PyBUF_SIMPLE) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void release_items(Py_buffer *bufs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (bufs[i].obj != NULL)
+            PyBuffer_Release(&bufs[i]);
+    }
+    PyMem_Free(bufs);
+}
+
+static PyObject *py_slh_sign_batch(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "items", "deterministic", NULL };
+    const char *name;
+    PyObject *items_obj;
+    int deterministic = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|p", keywords, &name, &items_obj, &deterministic))
+        return NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || get_pool() == NULL)
+        return NULL;
+    PyObject *seq = PySequence_Fast(items_obj, "items must be a sequence of (M, ctx, SK) tuples");
+    if (seq == NULL)
+        return NULL;
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    uint32_t sig_len = slh_signature_length(prm);
+    Py_buffer *bufs = PyMem_Calloc(3 * count + 1, sizeof *bufs);
+    SignItem *items = PyMem_Calloc(count + 1, sizeof *items);
+    bool *ok = PyMem_Calloc(count + 1, sizeof *ok);
+    PyObject *result = PyList_New(count);
+    if (bufs == NULL || items == NULL || ok == NULL || result == NULL || !get_items(seq, count, 3, "(M, ctx, SK)", bufs))
+        goto fail;
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_buffer *b = &bufs[3 * i];
+        if (!check_ctx(&b[1]) || !check_length(&b[2], 4 * prm->n, "SK"))
+            goto fail;
+        PyObject *SIG = PyBytes_FromStringAndSize(NULL, sig_len);
+        if (SIG == NULL)
+            goto fail;
+        PyList_SET_ITEM(result, i, SIG);
+        items[i] = (SignItem) { b[0].buf, b[0].len, b[1].buf, b[1].len, b[2].buf, (uint8_t *) PyBytes_AS_STRING(SIG) };
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    slh_sign_batch(prm, pool, items, count, deterministic, ok);
+    Py_END_ALLOW_THREADS
+
+    // ctx was checked above, so an item fails only without randomness
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (!ok[i]) {
+            PyErr_SetString(PyExc_OSError, "could not generate random bytes");
+            goto fail;
+        }
+    }
+
+    release_items(bufs, 3 * count);
+    PyMem_Free(items);
+    PyMem_Free(ok);
+    Py_DECREF(seq);
+    return result;
+
+fail:
+    if (bufs != NULL)
+        release_items(bufs, 3 * count);
+    PyMem_Free(items);
+    PyMem_Free(ok);
+    Py_XDECREF(result);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+static PyObject *py_slh_verify_batch(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "items", NULL };
+    const char *name;
+    PyObject *items_obj;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO", keywords, &name, &items_obj))
+        return NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || get_pool() == NULL)
+        return NULL;
+    PyObject *seq = PySequence_Fast(items_obj, "items must be a sequence of (M, ctx, SIG, PK) tuples");
+    if (seq == NULL)
+        return NULL;
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *bufs = PyMem_Calloc(4 * count + 1, sizeof *bufs);
+    VerifyItem *items = PyMem_Calloc(count + 1, sizeof *items);
+    bool *results = PyMem_Calloc(count + 1, sizeof *results);
+    PyObject *result = NULL;
+    if (bufs == NULL || items == NULL || results == NULL || !get_items(seq, count, 4, "(M, ctx, SIG, PK)", bufs))
+        goto done;
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_buffer *b = &bufs[4 * i];
+        if (!check_length(&b[3], 2 * prm->n, "PK"))
+            goto done;
+        items[i] = (VerifyItem) { b[0].buf, b[0].len, b[2].buf, b[2].len, b[1].buf, b[1].len, b[3].buf };
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    slh_verify_batch_pool(prm, pool, items, count, results);
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(count);
+    for (Py_ssize_t i = 0; result != NULL && i < count; i++)
+        PyList_SET_ITEM(result, i, PyBool_FromLong(results[i]));
+
+done:
+    if (bufs != NULL)
+        release_items(bufs, 4 * count);
+    PyMem_Free(items);
+    PyMem_Free(results);
+    Py_DECREF(seq);
+    return result;
+}
+
+static PyObject *py_slh_keygen_batch(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "parameter_set", "master_seed", "first", "count", NULL };
+    const char *name;
+    Py_buffer seed = { 0 };
+    Py_buffer *bufs[] = { &seed };
+    unsigned long long first;
+    Py_ssize_t count;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sy*Kn", keywords, &name, &seed, &first, &count))
+        return NULL;
+
+    PyObject *result = NULL;
+    uint8_t *keys = NULL;
+    Parameters *prm = get_set(name);
+    if (prm == NULL || get_pool() == NULL)
+        goto done;
+    if (count < 0) {
+        PyErr_SetString(PyExc_ValueError, "count must not be negative");
+        goto done;
+    }
+
+    // SK and PK of all keys, 6 * n bytes per key
+    keys = PyMem_Malloc(6 * prm->n * (size_t) count + 1);
+    if (keys == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    uint8_t *SK = keys, *PK = keys + 4 * prm->n * (size_t) count;
+    Py_BEGIN_ALLOW_THREADS
+    slh_keygen_batch(prm, pool, seed.buf, seed.len, first, count, SK, PK);
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(count);
+    for (Py_ssize_t i = 0; result != NULL && i < count; i++) {
+        PyObject *pair = Py_BuildValue("(y#y#)", SK + 4 * prm->n * i, (Py_ssize_t) (4 * prm->n), PK + 2 * prm->n * i, (Py_ssize_t) (2 * prm->n));
+        if (pair == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, pair);
+    }
+    memset(keys, 0, 4 * prm->n * (size_t) count);
+
+done:
+    PyMem_Free(keys);
+    release(bufs, 1);
+    return result;
+}
+
+static PyMethodDef methods[] = {
+    { "slh_keygen", (PyCFunction) (void (*)(void)) py_slh_keygen, METH_VARARGS | METH_KEYWORDS,
+      "slh_keygen(parameter_set, SK_seed=b'', SK_prf=b'', PK_seed=b'') -> (SK, PK)\nEmpty seeds are generated randomly." },
+    { "slh_keygen_internal", (PyCFunction) (void (*)(void)) py_slh_keygen_internal, METH_VARARGS | METH_KEYWORDS,
+      "slh_keygen_internal(parameter_set, sk_seed, sk_prf, pk_seed) -> (SK, PK)" },
+    { "slh_sign", (PyCFunction) (void (*)(void)) py_slh_sign, METH_VARARGS | METH_KEYWORDS,
+      "slh_sign(parameter_set, M, ctx, SK, deterministic=True) -> SIG" },
+    { "slh_sign_internal", (PyCFunction) (void (*)(void)) py_slh_sign_internal, METH_VARARGS | METH_KEYWORDS,
+      "slh_sign_internal(parameter_set, M, SK, addrnd) -> SIG" },
+    { "hash_slh_sign", (PyCFunction) (void (*)(void)) py_hash_slh_sign, METH_VARARGS | METH_KEYWORDS,
+      "hash_slh_sign(parameter_set, M, ctx, PH, SK, deterministic=True) -> SIG\nPH is a name like 'SHA-256', as in python/external.py." },
+    { "slh_verify", (PyCFunction) (void (*)(void)) py_slh_verify, METH_VARARGS | METH_KEYWORDS,
+      "slh_verify(parameter_set, M, ctx, SIG, PK) -> bool" },
+    { "slh_verify_internal", (PyCFunction) (void (*)(void)) py_slh_verify_internal, METH_VARARGS | METH_KEYWORDS,
+      "slh_verify_internal(parameter_set, M, SIG, PK) -> bool" },
+    { "hash_slh_verify", (PyCFunction) (void (*)(void)) py_hash_slh_verify, METH_VARARGS | METH_KEYWORDS,
+      "hash_slh_verify(parameter_set, M, SIG, ctx, PH, PK) -> bool" },
+    { "slh_sign_batch", (PyCFunction) (void (*)(void)) py_slh_sign_batch, METH_VARARGS | METH_KEYWORDS,
+      "slh_sign_batch(parameter_set, items, deterministic=True) -> list of SIG\nitems is a sequence of (M, ctx, SK) tuples, signed on all cores." },
+    { "slh_verify_batch", (PyCFunction) (void (*)(void)) py_slh_verify_batch, METH_VARARGS | METH_KEYWORDS,
+      "slh_verify_batch(parameter_set, items) -> list of bool\nitems is a sequence of (M, ctx, SIG, PK) tuples, verified on all cores." },
+    { "slh_keygen_batch", (PyCFunction) (void (*)(void)) py_slh_keygen_batch, METH_VARARGS | METH_KEYWORDS,
+      "slh_keygen_batch(parameter_set, master_seed, first, count) -> list of (SK, PK)\nKeys first, ..., first + count - 1 of master_seed, see batch.h." },
+    { NULL, NULL, 0, NULL }
+};
+
+static void module_free(void *module)
+{
+    pool_destroy(pool);
+    pool = NULL;
+}
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "_slhdsa", "SLH-DSA (FIPS 205) on the optimized C implementation", -1, methods,
+    NULL, NULL, NULL, module_free
+};
+
+PyMODINIT_FUNC PyInit__slhdsa(void)
+{
+    for (int i = 0; i < 12; i++)
+        setup_parameter_set(&sets[i], set_names[i]);
+
+    PyObject *m = PyModule_Create(&module);
+    if (m == NULL)
+        return NULL;
+    PyObject *names = PyTuple_New(12);
+    for (int i = 0; names != NULL && i < 12; i++)
+        PyTuple_SET_ITEM(names, i, PyUnicode_FromString(set_names[i]));
+    if (names == NULL || PyModule_AddObject(m, "PARAMETER_SETS", names) < 0) {
+        Py_XDECREF(names);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
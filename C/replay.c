@@ -0,0 +1,466 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "batch.h"
+#include "external.h"
+#include "internal.h"
+#include "params.h"
+#include "shake.h"
+#include "shake_x8.h"
+#include "stats.h"
+#include "timing.h"
+#include "trace.h"
+#include "KeccakSpongeWidth1600.h"
+
+// Records the SHAKE256 calls of real SLH-DSA operations to a trace file and replays them on different Keccak backends
+// replay -r -p set [-g messages] [-v] trace    records signing (and verifying) with a build that has -DSLH_TRACE
+// replay [-b backend] [-n runs] trace          replays the trace on one or all backends
+//
+// The replay keeps the shape of the traffic: the same call types and lengths in the same order, and the calls
+// marked as dependent get the output of the call before them as input, so chains stay serial.
+// The inputs are synthetic, so the outputs differ from the recorded run, but every backend computes the same ones.
+
+#define MSG_LEN 64
+
+static const char *type_names[TRACE_TYPES] = { "F", "H", "PRF", "Tlen", "SHAKE", "init", "absorb", "squeeze", "x8" };
+
+// Portable Keccak-p[1600, 24] as a baseline for the optimized backends
+
+static const uint64_t round_constants[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+};
+
+// rho offsets and pi positions along the path the combined rho and pi step takes through the lanes
+static const uint32_t rho[24] = { 1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44 };
+static const uint32_t pi[24] = { 10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1 };
+
+static uint64_t rotl(uint64_t x, uint32_t n)
+{
+    return x << n | x >> (64 - n);
+}
+
+static void keccak_ref(uint64_t A[25])
+{
+    for (int round = 0; round < 24; round++) {
+        uint64_t C[5];
+        for (int x = 0; x < 5; x++)
+            C[x] = A[x] ^ A[x + 5] ^ A[x + 10] ^ A[x + 15] ^ A[x + 20];
+        for (int x = 0; x < 5; x++) {
+            uint64_t D = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
+            for (int y = 0; y < 25; y += 5)
+                A[y + x] ^= D;
+        }
+
+        uint64_t t = A[1];
+        for (int i = 0; i < 24; i++) {
+            uint64_t next = A[pi[i]];
+            A[pi[i]] = rotl(t, rho[i]);
+            t = next;
+        }
+
+        for (int y = 0; y < 25; y += 5) {
+            for (int x = 0; x < 5; x++)
+                C[x] = A[y + x];
+            for (int x = 0; x < 5; x++)
+                A[y + x] = C[x] ^ (~C[(x + 1) % 5] & C[(x + 2) % 5]);
+        }
+        A[0] ^= round_constants[round];
+    }
+}
+
+typedef struct {
+    uint64_t A[25];
+    size_t pos;
+} RefSponge;
+
+typedef union {
+    SHAKE_256_CTX xkcp;
+    RefSponge ref;
+} Sponge;
+
+static void ref_init(Sponge *s)
+{
+    memset(&s->ref, 0, sizeof s->ref);
+}
+
+static void ref_xor_byte(RefSponge *s, size_t i, uint8_t b)
+{
+    s->A[i / 8] ^= (uint64_t) b << 8 * (i % 8);
+}
+
+static void ref_absorb(Sponge *s, const uint8_t *M, size_t M_len)
+{
+    for (size_t i = 0; i < M_len; i++) {
+        ref_xor_byte(&s->ref, s->ref.pos++, M[i]);
+        if (s->ref.pos == SHAKE_256_RATE) {
+            keccak_ref(s->ref.A);
+            s->ref.pos = 0;
+        }
+    }
+}
+
+static void ref_squeeze(Sponge *s, uint8_t *out, size_t out_len)
+{
+    ref_xor_byte(&s->ref, s->ref.pos, 0x1F);
+    ref_xor_byte(&s->ref, SHAKE_256_RATE - 1, 0x80);
+    for (size_t i = 0; i < out_len; i++) {
+        if (i % SHAKE_256_RATE == 0)
+            keccak_ref(s->ref.A);
+        out[i] = s->ref.A[i % SHAKE_256_RATE / 8] >> 8 * (i % 8);
+    }
+}
+
+static void ref_sponge(const uint8_t *M, size_t M_len, uint8_t *out, size_t out_len)
+{
+    Sponge s;
+    ref_init(&s);
+    ref_absorb(&s, M, M_len);
+    ref_squeeze(&s, out, out_len);
+}
+
+// The backends in the tree: the AVX-512 Keccak-p of XKCP and the 8-way SHAKE_256_x8
+
+static void xkcp_init(Sponge *s)
+{
+    SHAKE_256_init(&s->xkcp);
+}
+
+static void xkcp_absorb(Sponge *s, const uint8_t *M, size_t M_len)
+{
+    SHAKE_256_update(&s->xkcp, M, M_len);
+}
+
+static void xkcp_squeeze(Sponge *s, uint8_t *out, size_t out_len)
+{
+    SHAKE_256_final(&s->xkcp, out, out_len);
+}
+
+static void xkcp_sponge(const uint8_t *M, size_t M_len, uint8_t *out, size_t out_len)
+{
+    KeccakWidth1600_Sponge(1088, 512, M, M_len, 0x1F, out, out_len);
+}
+
+static void x8_lanes(void (*sponge)(const uint8_t *, size_t, uint8_t *, size_t), const uint8_t *const *M, size_t M_len, uint8_t *const *out, size_t out_len, uint32_t lanes)
+{
+    (void) sponge;
+    Segment seg[SHAKE_LANES];
+    const Segment *lane_M[SHAKE_LANES];
+    size_t lane_count[SHAKE_LANES];
+    for (uint32_t j = 0; j < lanes; j++) {
+        seg[j] = (Segment) { M[j], M_len };
+        lane_M[j] = &seg[j];
+        lane_count[j] = 1;
+    }
+    SHAKE_256_x8(lane_M, lane_count, out, out_len, lanes);
+}
+
+// multi-buffer calls hashed one lane after the other
+static void serial_lanes(void (*sponge)(const uint8_t *, size_t, uint8_t *, size_t), const uint8_t *const *M, size_t M_len, uint8_t *const *out, size_t out_len, uint32_t lanes)
+{
+    for (uint32_t j = 0; j < lanes; j++)
+        sponge(M[j], M_len, out[j], out_len);
+}
+
+typedef struct {
+    const char *name;
+    void (*init)(Sponge *s);
+    void (*absorb)(Sponge *s, const uint8_t *M, size_t M_len);
+    void (*squeeze)(Sponge *s, uint8_t *out, size_t out_len);
+    void (*sponge)(const uint8_t *M, size_t M_len, uint8_t *out, size_t out_len);
+    void (*lanes)(void (*sponge)(const uint8_t *, size_t, uint8_t *, size_t), const uint8_t *const *M, size_t M_len, uint8_t *const *out, size_t out_len, uint32_t lanes);
+} Backend;
+
+// A new kernel is compared by adding it here
+static const Backend backends[] = {
+    { "avx512",        xkcp_init, xkcp_absorb, xkcp_squeeze, xkcp_sponge, x8_lanes },
+    { "avx512-serial", xkcp_init, xkcp_absorb, xkcp_squeeze, xkcp_sponge, serial_lanes },
+    { "ref",           ref_init,  ref_absorb,  ref_squeeze,  ref_sponge,  serial_lanes },
+};
+
+#define BACKENDS (sizeof backends / sizeof backends[0])
+
+typedef struct {
+    uint64_t ns;
+    uint64_t calls[TRACE_TYPES];
+    uint64_t permutations[TRACE_TYPES];
+    uint64_t cycles[TRACE_TYPES];
+    uint64_t bytes;
+    uint8_t checksum[32];
+} Replay;
+
+// Runs the trace once, in holds 8 lanes of stride bytes, out 8 lanes of out_stride bytes
+static void replay_run(const Backend *b, const TraceRecord *records, size_t count, uint8_t *in, size_t stride, uint8_t *out, size_t out_stride, Replay *result)
+{
+    const uint8_t *lane_in[SHAKE_LANES];
+    uint8_t *lane_out[SHAKE_LANES];
+    for (uint32_t j = 0; j < SHAKE_LANES; j++) {
+        lane_in[j] = in + j * stride;
+        lane_out[j] = out + j * out_stride;
+    }
+    memset(result, 0, sizeof *result);
+    memset(out, 0, SHAKE_LANES * out_stride);
+    for (size_t i = 0; i < SHAKE_LANES * stride; i++)
+        in[i] = i * 131 + 7;
+
+    Sponge sponge;
+    size_t absorbed = 0;
+    uint32_t prev_lanes = 1;
+    size_t prev_len = 0;
+    size_t fold = 0;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        const TraceRecord *r = &records[i];
+        uint32_t lanes = r->type == TRACE_X8 ? r->lanes : 1;
+        uint64_t c0 = __rdtsc();
+
+        for (uint32_t rep = 0; rep < r->repeat; rep++) {
+            // the output of the previous call goes to the end of the input, where chains and trees put it
+            if (r->dep && prev_len > 0) {
+                size_t len = prev_len < r->in_len ? prev_len : r->in_len;
+                for (uint32_t j = 0; j < lanes; j++)
+                    memcpy(in + j * stride + r->in_len - len, lane_out[j < prev_lanes ? j : 0], len);
+            }
+
+            switch (r->type) {
+            case TRACE_INIT:
+                b->init(&sponge);
+                absorbed = 0;
+                break;
+            case TRACE_ABSORB:
+                b->absorb(&sponge, in, r->in_len);
+                absorbed += r->in_len;
+                break;
+            case TRACE_SQUEEZE:
+                b->squeeze(&sponge, out, r->out_len);
+                break;
+            case TRACE_X8:
+                b->lanes(b->sponge, lane_in, r->in_len, lane_out, r->out_len, lanes);
+                break;
+            default:
+                b->sponge(in, r->in_len, out, r->out_len);
+                break;
+            }
+            if (r->out_len > 0) {
+                prev_lanes = lanes;
+                prev_len = r->out_len;
+            }
+        }
+
+        result->cycles[r->type] += __rdtsc() - c0;
+        if (r->type == TRACE_SQUEEZE)
+            result->permutations[r->type] += r->repeat * SPONGE_PERMUTATIONS(absorbed, SHAKE_256_RATE, r->out_len);
+        else if (r->type != TRACE_INIT && r->type != TRACE_ABSORB)
+            result->permutations[r->type] += (uint64_t) r->repeat * lanes * SPONGE_PERMUTATIONS(r->in_len, SHAKE_256_RATE, r->out_len);
+        if (r->type != TRACE_ABSORB && r->type != TRACE_SQUEEZE)
+            result->calls[r->type] += (uint64_t) r->repeat * lanes;
+        result->bytes += (uint64_t) r->repeat * lanes * r->in_len;
+
+        // every output ends up in the checksum, which has to be the same for all backends
+        for (uint32_t j = 0; r->out_len > 0 && j < lanes; j++) {
+            for (size_t k = 0; k < r->out_len; k++)
+                result->checksum[fold++ % 32] ^= lane_out[j][k];
+        }
+    }
+    result->ns = now_ns() - start;
+}
+
+static bool record(const char *path, const char *set, uint32_t messages, bool verify)
+{
+    if (!TRACE_ENABLED) {
+        printf("Recording needs a build with -DSLH_TRACE, see make replay\n");
+        return false;
+    }
+    Parameters prm;
+    setup_parameter_set(&prm, set);
+    if (prm.n == 0 || prm.sha2) {
+        printf("Traces cover the SHAKE parameter sets, %s is none\n", set);
+        return false;
+    }
+
+    uint32_t n = prm.n;
+    uint32_t sig_len = slh_signature_length(&prm);
+    uint8_t seed[3 * n];
+    uint8_t SK[4 * n];
+    uint8_t PK[2 * n];
+    for (uint32_t i = 0; i < 3 * n; i++)
+        seed[i] = i;
+    slh_keygen_internal(&prm, seed, seed + n, seed + 2 * n, SK, PK);
+
+    uint8_t *M = malloc((size_t) messages * MSG_LEN);
+    uint8_t *sigs = malloc((size_t) messages * sig_len);
+    SignItem *items = malloc(messages * sizeof *items);
+    for (uint32_t i = 0; i < messages; i++) {
+        for (uint32_t j = 0; j < MSG_LEN; j++)
+            M[i * MSG_LEN + j] = i + j;
+        items[i] = (SignItem) { M + i * MSG_LEN, MSG_LEN, NULL, 0, SK, sigs + (size_t) i * sig_len };
+    }
+
+    // a single message is signed like slh_sign does it, more go through the lockstep signer in this thread
+    trace_begin();
+    if (messages == 1)
+        slh_sign_addrnd(&prm, M, MSG_LEN, NULL, 0, SK, PK, sigs);
+    else
+        slh_sign_batch(&prm, NULL, items, messages, true, NULL);
+    bool ok = true;
+    for (uint32_t i = 0; verify && i < messages; i++)
+        ok &= slh_verify(&prm, M + i * MSG_LEN, MSG_LEN, sigs + (size_t) i * sig_len, sig_len, NULL, 0, PK);
+    size_t count;
+    TraceRecord *records = trace_end(&count);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL || !trace_write(fp, set, records, count)) {
+        printf("Error writing %s\n", path);
+        ok = false;
+    }
+    if (fp != NULL)
+        fclose(fp);
+    if (ok) {
+        uint64_t calls = 0;
+        for (size_t i = 0; i < count; i++)
+            calls += records[i].repeat;
+        printf("%s: %s, %u message(s)%s, %lu calls in %zu records\n", path, set, messages, verify ? " signed and verified" : " signed",
+               (unsigned long) calls, count);
+    }
+    free(records);
+    free(items);
+    free(sigs);
+    free(M);
+    return ok;
+}
+
+static bool replay(const char *path, const char *backend, uint32_t runs)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Error opening %s\n", path);
+        return false;
+    }
+    char set[32];
+    size_t count;
+    TraceRecord *records = trace_read(fp, set, &count);
+    fclose(fp);
+    if (records == NULL) {
+        printf("%s is no valid trace\n", path);
+        return false;
+    }
+
+    // the x8 kernel squeezes at most one block
+    size_t stride = 0, out_stride = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].in_len > stride)
+            stride = records[i].in_len;
+        if (records[i].out_len > out_stride)
+            out_stride = records[i].out_len;
+        if (records[i].type == TRACE_X8 && records[i].out_len > SHAKE_256_RATE) {
+            printf("%s: multi-buffer call with %u output bytes\n", path, records[i].out_len);
+            free(records);
+            return false;
+        }
+    }
+    uint8_t *in = malloc(SHAKE_LANES * stride + 1);
+    uint8_t *out = malloc(SHAKE_LANES * out_stride);
+
+    printf("%s: %s, %zu records\n", path, set, count);
+    printf("%-14s %10s %10s %12s %10s  %s\n", "backend", "ms", "Mcalls/s", "Mperm/s", "MB/s", "checksum");
+
+    bool ok = true, found = false;
+    uint8_t reference[32];
+    for (size_t k = 0; k < BACKENDS; k++) {
+        if (backend != NULL && strcmp(backend, backends[k].name) != 0)
+            continue;
+        found = true;
+
+        // the fastest of the runs
+        Replay best, result;
+        for (uint32_t run = 0; run < runs; run++) {
+            replay_run(&backends[k], records, count, in, stride, out, out_stride, &result);
+            if (run == 0 || result.ns < best.ns)
+                best = result;
+        }
+
+        uint64_t calls = 0, permutations = 0, cycles = 0;
+        for (int t = 0; t < TRACE_TYPES; t++) {
+            calls += best.calls[t];
+            permutations += best.permutations[t];
+            cycles += best.cycles[t];
+        }
+        printf("%-14s %10.3f %10.2f %12.2f %10.1f  ", backends[k].name, best.ns / 1e6, calls * 1e3 / best.ns,
+               permutations * 1e3 / best.ns, best.bytes * 1e3 / best.ns);
+        for (int i = 0; i < 8; i++)
+            printf("%02x", best.checksum[i]);
+        printf("\n");
+        for (int t = 0; t < TRACE_TYPES; t++) {
+            if (best.cycles[t] == 0)
+                continue;
+            printf("    %-8s %10lu calls %10lu perm %8.1f cycles/perm %5.1f%%\n", type_names[t], (unsigned long) best.calls[t],
+                   (unsigned long) best.permutations[t], best.permutations[t] ? (double) best.cycles[t] / best.permutations[t] : 0.0,
+                   100.0 * best.cycles[t] / cycles);
+        }
+
+        // a single backend has nothing to be compared with
+        if (backend == NULL && k > 0 && memcmp(reference, best.checksum, 32) != 0) {
+            printf("%s computes different outputs than %s\n", backends[k].name, backends[0].name);
+            ok = false;
+        }
+        if (k == 0)
+            memcpy(reference, best.checksum, 32);
+    }
+    if (!found) {
+        printf("Unknown backend %s, available:", backend);
+        for (size_t k = 0; k < BACKENDS; k++)
+            printf(" %s", backends[k].name);
+        printf("\n");
+        ok = false;
+    }
+
+    free(in);
+    free(out);
+    free(records);
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s -r -p set [-g messages] [-v] trace\n", name);
+    printf("       %s [-b backend] [-n runs] trace\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    bool recording = false, verify = false;
+    const char *set = "SLH-DSA-SHAKE-128f";
+    const char *backend = NULL;
+    uint32_t messages = 1, runs = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "rp:g:vb:n:h")) != -1) {
+        switch (opt) {
+        case 'r': recording = true; break;
+        case 'p': set = optarg; break;
+        case 'g': messages = atoi(optarg); break;
+        case 'v': verify = true; break;
+        case 'b': backend = optarg; break;
+        case 'n': runs = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || messages == 0 || runs == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = recording ? record(argv[optind], set, messages, verify) : replay(argv[optind], backend, runs);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sodium.h>
+#include "rng.h"
+
+// State of one thread, the first 32 bytes of each refill become the next key
+typedef struct {
+    uint8_t key[randombytes_SEEDBYTES];
+    uint8_t buffer[RNG_BUFFER_LEN];
+    size_t pos;
+    size_t since_reseed;
+    uint64_t generation;
+    bool seeded;
+} Rng;
+
+static _Thread_local Rng rng;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static bool init_ok;
+
+// bumped in the child after fork(), so parent and child never share a key stream
+static volatile uint64_t fork_generation;
+
+static void after_fork(void)
+{
+    fork_generation++;
+}
+
+static void rng_init(void)
+{
+    init_ok = sodium_init() >= 0;
+    if (init_ok)
+        pthread_atfork(NULL, NULL, after_fork);
+}
+
+static void refill(void)
+{
+    if (!rng.seeded || rng.generation != fork_generation || rng.since_reseed >= RNG_RESEED_BYTES) {
+        randombytes_buf(rng.key, sizeof rng.key);
+        rng.generation = fork_generation;
+        rng.since_reseed = 0;
+        rng.seeded = true;
+    }
+
+    randombytes_buf_deterministic(rng.buffer, sizeof rng.buffer, rng.key);
+    memcpy(rng.key, rng.buffer, sizeof rng.key);
+    sodium_memzero(rng.buffer, sizeof rng.key);
+    rng.pos = sizeof rng.key;
+}
+
+bool random_bytes(uint8_t *buf, size_t len)
+{
+    pthread_once(&init_once, rng_init);
+    if (!init_ok)
+        return false;
+
+    // nothing buffered yet, or the buffer was inherited from the parent process
+    if (!rng.seeded || rng.generation != fork_generation)
+        rng.pos = RNG_BUFFER_LEN;
+
+    while (len > 0) {
+        if (rng.pos == RNG_BUFFER_LEN)
+            refill();
+
+        size_t take = RNG_BUFFER_LEN - rng.pos < len ? RNG_BUFFER_LEN - rng.pos : len;
+        memcpy(buf, rng.buffer + rng.pos, take);
+        // bytes that were handed out are not kept around
+        sodium_memzero(rng.buffer + rng.pos, take);
+        rng.pos += take;
+        rng.since_reseed += take;
+        buf += take;
+        len -= take;
+    }
+    return true;
+}
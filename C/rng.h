@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bytes of ChaCha20 output each thread keeps buffered
+#define RNG_BUFFER_LEN 4096
+
+// A thread takes a fresh key from the OS after handing out this many bytes
+#define RNG_RESEED_BYTES (1 << 20)
+
+// Fills buf with len random bytes from the calling thread's buffer
+// The buffer is refilled with ChaCha20 under a key that is replaced after every refill,
+// the key comes from the OS on first use, every RNG_RESEED_BYTES bytes and after fork()
+// Returns false if the sodium library could not be initialised
+bool random_bytes(uint8_t *buf, size_t len);
@@ -0,0 +1,234 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "external.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "sign_state.h"
+
+typedef struct Task {
+    SignState state;            // signing only
+    SchedJob job;
+    struct Task *next;
+} Task;
+
+typedef struct {
+    Task *head;
+    Task *tail;
+} Queue;
+
+struct Sched {
+    pthread_t *threads;
+    uint32_t count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // signalled when a task is queued or the scheduler stops
+    pthread_cond_t idle;        // signalled when the last pending task is done
+
+    // guarded by lock
+    Queue queue[SCHED_CLASSES];
+    uint32_t weight[SCHED_CLASSES];
+    int64_t credit[SCHED_CLASSES];
+    size_t pending;             // submitted and not done
+    bool stop;
+};
+
+static void push_tail(Queue *q, Task *t)
+{
+    t->next = NULL;
+    if (q->tail != NULL)
+        q->tail->next = t;
+    else
+        q->head = t;
+    q->tail = t;
+}
+
+static void push_head(Queue *q, Task *t)
+{
+    t->next = q->head;
+    q->head = t;
+    if (q->tail == NULL)
+        q->tail = t;
+}
+
+static Task *pop_head(Queue *q)
+{
+    Task *t = q->head;
+    q->head = t->next;
+    if (q->head == NULL)
+        q->tail = NULL;
+    return t;
+}
+
+// Smooth weighted round robin over the classes that have work
+// Every candidate earns its weight, the richest one runs and pays the sum of the candidates' weights
+static int pick_class(Sched *sched)
+{
+    int best = -1;
+    int64_t total = 0;
+    for (int c = 0; c < SCHED_CLASSES; c++) {
+        if (sched->queue[c].head == NULL || sched->weight[c] == 0)
+            continue;
+        sched->credit[c] += sched->weight[c];
+        total += sched->weight[c];
+        if (best < 0 || sched->credit[c] > sched->credit[best])
+            best = c;
+    }
+    if (best >= 0) {
+        sched->credit[best] -= total;
+        return best;
+    }
+
+    // only classes with weight 0 have work
+    for (int c = 0; c < SCHED_CLASSES; c++) {
+        if (sched->queue[c].head != NULL)
+            return c;
+    }
+    return -1;
+}
+
+// Runs one piece of t, returns true if t is done
+static bool run_piece(Task *t, bool *result)
+{
+    SchedJob *job = &t->job;
+    if (job->op == SCHED_VERIFY) {
+        *result = slh_verify(job->prm, (uint8_t *) job->M, job->M_len, job->SIG, job->SIG_len,
+                             (uint8_t *) job->ctx, job->ctx_len, job->key);
+        return true;
+    }
+    SignBudget slice = { 0, SCHED_SLICE_NS };
+    *result = true;
+    return slh_sign_step(&t->state, &slice);
+}
+
+static void *worker(void *arg)
+{
+    Sched *sched = arg;
+
+    pthread_mutex_lock(&sched->lock);
+    for (;;) {
+        int c;
+        while ((c = pick_class(sched)) < 0 && !sched->stop)
+            pthread_cond_wait(&sched->work, &sched->lock);
+        if (c < 0)
+            break;
+
+        Task *t = pop_head(&sched->queue[c]);
+        pthread_mutex_unlock(&sched->lock);
+
+        bool result;
+        bool done = run_piece(t, &result);
+        if (done) {
+            if (t->job.done != NULL)
+                t->job.done(t->job.arg, result);
+            free(t);
+        }
+
+        pthread_mutex_lock(&sched->lock);
+        if (!done) {
+            // the oldest signature continues first, so signatures finish in submission order
+            push_head(&sched->queue[c], t);
+        } else if (--sched->pending == 0) {
+            pthread_cond_broadcast(&sched->idle);
+        }
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return NULL;
+}
+
+Sched *sched_create(uint32_t threads, const uint32_t *weight)
+{
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+
+    Sched *sched = calloc(1, sizeof *sched);
+    if (sched == NULL)
+        return NULL;
+    sched->threads = calloc(threads, sizeof *sched->threads);
+    if (sched->threads == NULL) {
+        free(sched);
+        return NULL;
+    }
+    sched->weight[SCHED_VERIFY] = weight != NULL ? weight[SCHED_VERIFY] : SCHED_VERIFY_WEIGHT;
+    sched->weight[SCHED_SIGN] = weight != NULL ? weight[SCHED_SIGN] : SCHED_SIGN_WEIGHT;
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->work, NULL);
+    pthread_cond_init(&sched->idle, NULL);
+
+    // see POOL_STACK_SIZE
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_STACK_SIZE);
+    for (uint32_t i = 0; i < threads; i++) {
+        if (pthread_create(&sched->threads[i], &attr, worker, sched) != 0) {
+            printf("Error starting worker thread\n");
+            pthread_attr_destroy(&attr);
+            sched_destroy(sched);
+            return NULL;
+        }
+        sched->count++;
+    }
+    pthread_attr_destroy(&attr);
+    return sched;
+}
+
+void sched_destroy(Sched *sched)
+{
+    if (sched == NULL)
+        return;
+
+    sched_drain(sched);
+    pthread_mutex_lock(&sched->lock);
+    sched->stop = true;
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+
+    for (uint32_t i = 0; i < sched->count; i++)
+        pthread_join(sched->threads[i], NULL);
+
+    pthread_cond_destroy(&sched->idle);
+    pthread_cond_destroy(&sched->work);
+    pthread_mutex_destroy(&sched->lock);
+    free(sched->threads);
+    free(sched);
+}
+
+bool sched_submit(Sched *sched, const SchedJob *job)
+{
+    if (job->ctx_len > MAX_CTX_LENGTH || job->op >= SCHED_CLASSES)
+        return false;
+
+    // the signing state holds a Keccak state that needs its alignment,
+    // and aligned_alloc needs a size that is a multiple of the alignment
+    size_t size = (sizeof(Task) + _Alignof(Task) - 1) / _Alignof(Task) * _Alignof(Task);
+    Task *t = aligned_alloc(_Alignof(Task), size);
+    if (t == NULL)
+        return false;
+    t->job = *job;
+
+    if (job->op == SCHED_SIGN) {
+        // deterministic variant, PK.seed is addrnd
+        const uint8_t *addrnd = job->addrnd != NULL ? job->addrnd : job->key + 2 * job->prm->n;
+        slh_sign_init_addrnd(job->prm, &t->state, job->M, job->M_len, job->ctx, job->ctx_len, job->key, addrnd, job->SIG);
+    }
+
+    pthread_mutex_lock(&sched->lock);
+    push_tail(&sched->queue[job->op], t);
+    sched->pending++;
+    pthread_cond_signal(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+    return true;
+}
+
+void sched_drain(Sched *sched)
+{
+    pthread_mutex_lock(&sched->lock);
+    while (sched->pending > 0)
+        pthread_cond_wait(&sched->idle, &sched->lock);
+    pthread_mutex_unlock(&sched->lock);
+}
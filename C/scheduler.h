@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "params.h"
+
+// Worker threads with one queue per operation class
+// A verification runs in one piece, a signature in slices of SCHED_SLICE_NS (slh_sign_step),
+// so a waiting verification is delayed by at most one slice of a signature
+// slhd and the async queue keep their own workers: they sign and verify in lockstep groups of 8 (batch.h),
+// which a queue of single, sliced jobs cannot form
+typedef struct Sched Sched;
+
+#define SCHED_SLICE_NS 200000
+
+typedef enum {
+    SCHED_VERIFY,
+    SCHED_SIGN,
+    SCHED_CLASSES
+} SchedClass;
+
+// Default weights, while both queues have work 16 verifications run for every signing slice
+#define SCHED_VERIFY_WEIGHT 16
+#define SCHED_SIGN_WEIGHT 1
+
+// One pure SLH-DSA operation, the arguments of slh_sign or slh_verify
+// All buffers must stay valid until done is called
+typedef struct {
+    SchedClass op;
+    Parameters *prm;
+    const uint8_t *M;
+    size_t M_len;
+    const uint8_t *ctx;
+    size_t ctx_len;
+    const uint8_t *key;         // SK for signing, PK for verification
+    uint8_t *SIG;               // written when signing, read when verifying
+    size_t SIG_len;
+    const uint8_t *addrnd;      // signing only, NULL for deterministic signatures
+    // called on a worker thread when the operation is done, result is the verification result (true when signing)
+    void (*done)(void *arg, bool result);
+    void *arg;
+} SchedJob;
+
+// Starts a scheduler with the given number of workers, 0 uses one worker per online CPU
+// weight[c] is the share of class c while several classes have work, a class with weight 0 only runs when the others are idle
+// weight may be NULL for SCHED_VERIFY_WEIGHT and SCHED_SIGN_WEIGHT
+// Returns NULL if the threads could not be started
+Sched *sched_create(uint32_t threads, const uint32_t *weight);
+
+// Waits for all submitted jobs, then stops and joins the workers
+void sched_destroy(Sched *sched);
+
+// Queues a copy of job, returns false if the context is too long or memory ran out
+bool sched_submit(Sched *sched, const SchedJob *job);
+
+// Waits until every submitted job is done
+void sched_drain(Sched *sched);
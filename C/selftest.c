@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "async.h"
+#include "external.h"
+#include "internal.h"
+#include "params.h"
+
+// Checks of the front ends that the test vectors do not reach, run by make check
+
+// Submits req alone and returns the status of its completion
+static uint32_t async_status(AsyncQueue *q, const AsyncRequest *req)
+{
+    AsyncCompletion c;
+    if (!async_submit(q, req) || async_wait(q, &c, 1) != 1)
+        return UINT32_MAX;
+    return c.status;
+}
+
+// A request whose SIG_len is not the signature length is ASYNC_BAD_REQUEST, for signing and verification
+static bool check_async_sig_len(Parameters *prm)
+{
+    uint32_t n = prm->n;
+    uint32_t sig_len = slh_signature_length(prm);
+    uint8_t seed[3 * n];
+    memset(seed, 1, sizeof seed);
+    uint8_t SK[4 * n];
+    uint8_t PK[2 * n];
+    slh_keygen_internal(prm, seed, seed + n, seed + 2 * n, SK, PK);
+
+    uint8_t *SIG = malloc(sig_len + 1);
+    AsyncQueue *q = async_create(4, 1);
+    if (SIG == NULL || q == NULL) {
+        printf("Error setting up the async queue\n");
+        free(SIG);
+        if (q != NULL)
+            async_destroy(q);
+        return false;
+    }
+
+    uint8_t M[4] = { 1, 2, 3, 4 };
+    struct {
+        const char *name;
+        uint8_t op;
+        size_t SIG_len;
+        uint32_t expected;
+    } cases[] = {
+        { "sign",               ASYNC_SIGN,   sig_len,     ASYNC_OK },
+        { "verify",             ASYNC_VERIFY, sig_len,     ASYNC_OK },
+        { "sign, long SIG",     ASYNC_SIGN,   sig_len + 1, ASYNC_BAD_REQUEST },
+        { "verify, long SIG",   ASYNC_VERIFY, sig_len + 1, ASYNC_BAD_REQUEST },
+        { "verify, short SIG",  ASYNC_VERIFY, sig_len - 1, ASYNC_BAD_REQUEST }
+    };
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+        const uint8_t *key = cases[i].op == ASYNC_SIGN ? SK : PK;
+        AsyncRequest req = { i, cases[i].op, 0, prm, M, sizeof M, NULL, 0, key, SIG, cases[i].SIG_len };
+        uint32_t status = async_status(q, &req);
+        if (status != cases[i].expected) {
+            printf("async %s: status %u, expected %u\n", cases[i].name, status, cases[i].expected);
+            ok = false;
+        }
+    }
+    async_destroy(q);
+    free(SIG);
+    return ok;
+}
+
+int main(void)
+{
+    Parameters prm;
+    setup_parameter_set(&prm, "SLH-DSA-SHAKE-128f");
+
+    bool ok = check_async_sig_len(&prm);
+    printf("%s\n", ok ? "selftest ok" : "selftest failed");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,437 @@
+#include <stdint.h>
+#include <string.h>
+#include <cpuid.h>
+#include <immintrin.h>
+#include "sha2.h"
+#include "stats.h"
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t K512[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+    0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+    0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+    0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+    0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+    0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+    0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+    0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+    0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+static const uint32_t IV256[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t IV224[8] = {
+    0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4
+};
+
+static const uint64_t IV512[8] = {
+    0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+    0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+};
+
+static const uint64_t IV384[8] = {
+    0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+    0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4
+};
+
+static const uint64_t IV512_224[8] = {
+    0x8c3d37c819544da2, 0x73e1996689dcd4d6, 0x1dfab7ae32ff9c82, 0x679dd514582f9fcf,
+    0x0f6d2b697bd44da8, 0x77e36f7304c48942, 0x3f9d85a86a1d36c8, 0x1112e6ad91d692a1
+};
+
+static const uint64_t IV512_256[8] = {
+    0x22312194fc2bf72c, 0x9f555fa3c84c64c2, 0x2393b86b6f53b151, 0x963877195940eabd,
+    0x96283ee2a88effe3, 0xbe5e1e2553863992, 0x2b0199fc2c85b8aa, 0x0eb72ddc81c52ca2
+};
+
+#define ROR32(x, c) (((x) >> (c)) | ((x) << (32 - (c))))
+#define ROR64(x, c) (((x) >> (c)) | ((x) << (64 - (c))))
+
+static uint32_t load32(const uint8_t *x)
+{
+    return (uint32_t) x[0] << 24 | (uint32_t) x[1] << 16 | (uint32_t) x[2] << 8 | x[3];
+}
+
+static uint64_t load64(const uint8_t *x)
+{
+    return (uint64_t) load32(x) << 32 | load32(x + 4);
+}
+
+static void store32(uint8_t *x, uint32_t v)
+{
+    x[0] = v >> 24; x[1] = v >> 16; x[2] = v >> 8; x[3] = v;
+}
+
+static void store64(uint8_t *x, uint64_t v)
+{
+    store32(x, v >> 32);
+    store32(x + 4, (uint32_t) v);
+}
+
+static void sha256_compress_scalar(uint32_t *state, const uint8_t *blocks, size_t nblocks)
+{
+    uint32_t W[64];
+
+    for (; nblocks > 0; nblocks--, blocks += 64) {
+        for (int t = 0; t < 16; t++)
+            W[t] = load32(blocks + 4 * t);
+        for (int t = 16; t < 64; t++) {
+            uint32_t s0 = ROR32(W[t - 15], 7) ^ ROR32(W[t - 15], 18) ^ (W[t - 15] >> 3);
+            uint32_t s1 = ROR32(W[t - 2], 17) ^ ROR32(W[t - 2], 19) ^ (W[t - 2] >> 10);
+            W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; t++) {
+            uint32_t T1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + K256[t] + W[t];
+            uint32_t T2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + T1;
+            d = c; c = b; b = a; a = T1 + T2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+// SHA-256 with the x86 SHA extensions, four rounds per group of message words
+__attribute__((target("sha,sse4.1")))
+static void sha256_compress_shani(uint32_t *state, const uint8_t *blocks, size_t nblocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i STATE0, STATE1, TMP, MSG, ABEF_SAVE, CDGH_SAVE;
+    __m128i W[4];
+
+    // state is kept as ABEF and CDGH
+    TMP = _mm_loadu_si128((const __m128i *) &state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i *) &state[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xB1);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+
+    for (; nblocks > 0; nblocks--, blocks += 64) {
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        for (int j = 0; j < 4; j++)
+            W[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 16 * j)), MASK);
+
+        for (int g = 0; g < 16; g++) {
+            MSG = _mm_add_epi32(W[g & 3], _mm_loadu_si128((const __m128i *) &K256[4 * g]));
+            STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+            STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+
+            // message words for group g + 4
+            if (g < 12) {
+                TMP = _mm_sha256msg1_epu32(W[g & 3], W[(g + 1) & 3]);
+                TMP = _mm_add_epi32(TMP, _mm_alignr_epi8(W[(g + 3) & 3], W[(g + 2) & 3], 4));
+                W[g & 3] = _mm_sha256msg2_epu32(TMP, W[(g + 3) & 3]);
+            }
+        }
+
+        STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+        STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+    }
+
+    TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+    _mm_storeu_si128((__m128i *) &state[0], STATE0);
+    _mm_storeu_si128((__m128i *) &state[4], STATE1);
+}
+
+static int has_sha_ni(void)
+{
+    // -1 until the first call checks CPUID leaf 7, EBX bit 29
+    static int cached = -1;
+    if (cached < 0) {
+        unsigned int eax, ebx, ecx, edx;
+        cached = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29));
+    }
+    return cached;
+}
+
+void SHA_256_compress(uint32_t *state, const uint8_t *blocks, size_t nblocks)
+{
+    STATS_COUNT(sha256, nblocks);
+    if (has_sha_ni())
+        sha256_compress_shani(state, blocks, nblocks);
+    else
+        sha256_compress_scalar(state, blocks, nblocks);
+}
+
+// Multi-buffer SHA-256, each 32-bit lane of a vector belongs to an independent message
+#define XOR3_512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+
+__attribute__((target("avx512f")))
+static void sha256_compress_x16(uint32_t state[8][SHA_256_LANES], const uint32_t W[16][SHA_256_LANES])
+{
+    __m512i w[16], s[8];
+
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm512_loadu_si512(state[i]);
+    for (int t = 0; t < 16; t++)
+        w[t] = _mm512_loadu_si512(W[t]);
+
+    __m512i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m512i e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0; t < 64; t++) {
+        if (t >= 16) {
+            __m512i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m512i s0 = XOR3_512(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18), _mm512_srli_epi32(w15, 3));
+            __m512i s1 = XOR3_512(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19), _mm512_srli_epi32(w2, 10));
+            w[t & 15] = _mm512_add_epi32(_mm512_add_epi32(w[t & 15], s0), _mm512_add_epi32(w[(t - 7) & 15], s1));
+        }
+        __m512i T1 = _mm512_add_epi32(h, XOR3_512(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25)));
+        T1 = _mm512_add_epi32(T1, _mm512_ternarylogic_epi32(e, f, g, 0xCA));
+        T1 = _mm512_add_epi32(T1, _mm512_add_epi32(_mm512_set1_epi32(K256[t]), w[t & 15]));
+        __m512i T2 = _mm512_add_epi32(XOR3_512(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22)),
+                                      _mm512_ternarylogic_epi32(a, b, c, 0xE8));
+        h = g; g = f; f = e; e = _mm512_add_epi32(d, T1);
+        d = c; c = b; b = a; a = _mm512_add_epi32(T1, T2);
+    }
+
+    _mm512_storeu_si512(state[0], _mm512_add_epi32(s[0], a));
+    _mm512_storeu_si512(state[1], _mm512_add_epi32(s[1], b));
+    _mm512_storeu_si512(state[2], _mm512_add_epi32(s[2], c));
+    _mm512_storeu_si512(state[3], _mm512_add_epi32(s[3], d));
+    _mm512_storeu_si512(state[4], _mm512_add_epi32(s[4], e));
+    _mm512_storeu_si512(state[5], _mm512_add_epi32(s[5], f));
+    _mm512_storeu_si512(state[6], _mm512_add_epi32(s[6], g));
+    _mm512_storeu_si512(state[7], _mm512_add_epi32(s[7], h));
+}
+
+#define ROR_256(x, c) _mm256_or_si256(_mm256_srli_epi32(x, c), _mm256_slli_epi32(x, 32 - (c)))
+#define XOR3_256(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+
+// Runs lanes off to off + 7 of the same layout as sha256_compress_x16
+__attribute__((target("avx2")))
+static void sha256_compress_x8(uint32_t state[8][SHA_256_LANES], const uint32_t W[16][SHA_256_LANES], int off)
+{
+    __m256i w[16], s[8];
+
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm256_loadu_si256((const __m256i *) &state[i][off]);
+    for (int t = 0; t < 16; t++)
+        w[t] = _mm256_loadu_si256((const __m256i *) &W[t][off]);
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0; t < 64; t++) {
+        if (t >= 16) {
+            __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m256i s0 = XOR3_256(ROR_256(w15, 7), ROR_256(w15, 18), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = XOR3_256(ROR_256(w2, 17), ROR_256(w2, 19), _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i T1 = _mm256_add_epi32(h, XOR3_256(ROR_256(e, 6), ROR_256(e, 11), ROR_256(e, 25)));
+        T1 = _mm256_add_epi32(T1, ch);
+        T1 = _mm256_add_epi32(T1, _mm256_add_epi32(_mm256_set1_epi32(K256[t]), w[t & 15]));
+        __m256i T2 = _mm256_add_epi32(XOR3_256(ROR_256(a, 2), ROR_256(a, 13), ROR_256(a, 22)), maj);
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, T1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(T1, T2);
+    }
+
+    __m256i v[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_si256((__m256i *) &state[i][off], _mm256_add_epi32(s[i], v[i]));
+}
+
+void SHA_256_compress_lanes(uint32_t state[8][SHA_256_LANES], const uint32_t W[16][SHA_256_LANES], uint32_t lanes)
+{
+    // 8 AVX2 lanes are not faster than hashing them one by one with the SHA extensions
+    if (__builtin_cpu_supports("avx512f")) {
+        STATS_COUNT(sha256_lanes, 1);
+        sha256_compress_x16(state, W);
+    }
+    else if (!has_sha_ni() && __builtin_cpu_supports("avx2")) {
+        STATS_COUNT(sha256_lanes, lanes > 8 ? 2 : 1);
+        sha256_compress_x8(state, W, 0);
+        if (lanes > 8)
+            sha256_compress_x8(state, W, 8);
+    }
+    else {
+        uint32_t lane_state[8];
+        uint8_t block[64];
+        for (uint32_t j = 0; j < lanes; j++) {
+            for (int i = 0; i < 8; i++)
+                lane_state[i] = state[i][j];
+            for (int t = 0; t < 16; t++)
+                store32(block + 4 * t, W[t][j]);
+            SHA_256_compress(lane_state, block, 1);
+            for (int i = 0; i < 8; i++)
+                state[i][j] = lane_state[i];
+        }
+    }
+}
+
+// There is no widely available SHA-512 instruction set extension, so this is always scalar
+void SHA_512_compress(uint64_t *state, const uint8_t *blocks, size_t nblocks)
+{
+    uint64_t W[80];
+    STATS_COUNT(sha512, nblocks);
+
+    for (; nblocks > 0; nblocks--, blocks += 128) {
+        for (int t = 0; t < 16; t++)
+            W[t] = load64(blocks + 8 * t);
+        for (int t = 16; t < 80; t++) {
+            uint64_t s0 = ROR64(W[t - 15], 1) ^ ROR64(W[t - 15], 8) ^ (W[t - 15] >> 7);
+            uint64_t s1 = ROR64(W[t - 2], 19) ^ ROR64(W[t - 2], 61) ^ (W[t - 2] >> 6);
+            W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+        }
+
+        uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 80; t++) {
+            uint64_t T1 = h + (ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41)) + ((e & f) ^ (~e & g)) + K512[t] + W[t];
+            uint64_t T2 = (ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + T1;
+            d = c; c = b; b = a; a = T1 + T2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+void SHA_256_init(SHA_256_CTX *ctx)
+{
+    memcpy(ctx->state, IV256, sizeof IV256);
+    ctx->len = 0;
+    ctx->out_len = 32;
+}
+
+void SHA_224_init(SHA_256_CTX *ctx)
+{
+    memcpy(ctx->state, IV224, sizeof IV224);
+    ctx->len = 0;
+    ctx->out_len = 28;
+}
+
+void SHA_256_update(SHA_256_CTX *ctx, const uint8_t *M, size_t M_len)
+{
+    size_t used = ctx->len % 64;
+    ctx->len += M_len;
+
+    if (used > 0) {
+        size_t fill = 64 - used;
+        if (M_len < fill) {
+            memcpy(ctx->buf + used, M, M_len);
+            return;
+        }
+        memcpy(ctx->buf + used, M, fill);
+        SHA_256_compress(ctx->state, ctx->buf, 1);
+        M += fill;
+        M_len -= fill;
+    }
+
+    // whole blocks are compressed straight from M
+    SHA_256_compress(ctx->state, M, M_len / 64);
+    memcpy(ctx->buf, M + (M_len & ~(size_t) 63), M_len % 64);
+}
+
+void SHA_256_final(SHA_256_CTX *ctx, uint8_t *buffer)
+{
+    size_t used = ctx->len % 64;
+    uint8_t pad[128] = {0};
+    size_t pad_len = used < 56 ? 64 : 128;
+
+    memcpy(pad, ctx->buf, used);
+    pad[used] = 0x80;
+    store64(pad + pad_len - 8, ctx->len * 8);
+    SHA_256_compress(ctx->state, pad, pad_len / 64);
+
+    uint8_t digest[32];
+    for (int i = 0; i < 8; i++)
+        store32(digest + 4 * i, ctx->state[i]);
+    memcpy(buffer, digest, ctx->out_len);
+}
+
+void SHA_512_init(SHA_512_CTX *ctx)
+{
+    memcpy(ctx->state, IV512, sizeof IV512);
+    ctx->len = 0;
+    ctx->out_len = 64;
+}
+
+void SHA_384_init(SHA_512_CTX *ctx)
+{
+    memcpy(ctx->state, IV384, sizeof IV384);
+    ctx->len = 0;
+    ctx->out_len = 48;
+}
+
+void SHA_512_224_init(SHA_512_CTX *ctx)
+{
+    memcpy(ctx->state, IV512_224, sizeof IV512_224);
+    ctx->len = 0;
+    ctx->out_len = 28;
+}
+
+void SHA_512_256_init(SHA_512_CTX *ctx)
+{
+    memcpy(ctx->state, IV512_256, sizeof IV512_256);
+    ctx->len = 0;
+    ctx->out_len = 32;
+}
+
+void SHA_512_update(SHA_512_CTX *ctx, const uint8_t *M, size_t M_len)
+{
+    size_t used = ctx->len % 128;
+    ctx->len += M_len;
+
+    if (used > 0) {
+        size_t fill = 128 - used;
+        if (M_len < fill) {
+            memcpy(ctx->buf + used, M, M_len);
+            return;
+        }
+        memcpy(ctx->buf + used, M, fill);
+        SHA_512_compress(ctx->state, ctx->buf, 1);
+        M += fill;
+        M_len -= fill;
+    }
+
+    SHA_512_compress(ctx->state, M, M_len / 128);
+    memcpy(ctx->buf, M + (M_len & ~(size_t) 127), M_len % 128);
+}
+
+void SHA_512_final(SHA_512_CTX *ctx, uint8_t *buffer)
+{
+    size_t used = ctx->len % 128;
+    uint8_t pad[256] = {0};
+    size_t pad_len = used < 112 ? 128 : 256;
+
+    // the length field is 128 bits, messages here are shorter than 2^61 bytes
+    memcpy(pad, ctx->buf, used);
+    pad[used] = 0x80;
+    store64(pad + pad_len - 8, ctx->len * 8);
+    SHA_512_compress(ctx->state, pad, pad_len / 128);
+
+    uint8_t digest[64];
+    for (int i = 0; i < 8; i++)
+        store64(digest + 8 * i, ctx->state[i]);
+    memcpy(buffer, digest, ctx->out_len);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Incremental SHA-256 and SHA-224, see FIPS 180-4
+typedef struct {
+    uint32_t state[8];
+    uint8_t buf[64];
+    uint64_t len;
+    uint32_t out_len;
+} SHA_256_CTX;
+
+// Incremental SHA-512 and its truncated variants SHA-384, SHA-512/224 and SHA-512/256
+typedef struct {
+    uint64_t state[8];
+    uint8_t buf[128];
+    uint64_t len;
+    uint32_t out_len;
+} SHA_512_CTX;
+
+// Runs the SHA-256 compression function over nblocks consecutive 64-byte blocks
+// Uses the SHA extensions if the CPU has them
+void SHA_256_compress(uint32_t *state, const uint8_t *blocks, size_t nblocks);
+
+// Number of independent messages SHA_256_compress_lanes works on
+#define SHA_256_LANES 16
+
+// Runs one SHA-256 compression in each of the first `lanes` lanes
+// Uses 16 AVX-512 lanes, else the SHA extensions per lane, else 8 AVX2 lanes
+// The data is transposed: state[i][j] is state word i of lane j and W[t][j] is message word t of lane j
+void SHA_256_compress_lanes(uint32_t state[8][SHA_256_LANES], const uint32_t W[16][SHA_256_LANES], uint32_t lanes);
+
+void SHA_512_compress(uint64_t *state, const uint8_t *blocks, size_t nblocks);
+
+void SHA_256_init(SHA_256_CTX *ctx);
+
+void SHA_224_init(SHA_256_CTX *ctx);
+
+void SHA_256_update(SHA_256_CTX *ctx, const uint8_t *M, size_t M_len);
+
+// Writes the digest, its length depends on the init function that was used
+void SHA_256_final(SHA_256_CTX *ctx, uint8_t *buffer);
+
+void SHA_512_init(SHA_512_CTX *ctx);
+
+void SHA_384_init(SHA_512_CTX *ctx);
+
+void SHA_512_224_init(SHA_512_CTX *ctx);
+
+void SHA_512_256_init(SHA_512_CTX *ctx);
+
+void SHA_512_update(SHA_512_CTX *ctx, const uint8_t *M, size_t M_len);
+
+void SHA_512_final(SHA_512_CTX *ctx, uint8_t *buffer);
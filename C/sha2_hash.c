@@ -0,0 +1,327 @@
+#include <string.h>
+#include "adrs.h"
+#include "params.h"
+#include "sha2.h"
+#include "sha2_hash.h"
+
+static uint32_t load32(const uint8_t *x)
+{
+    return (uint32_t) x[0] << 24 | (uint32_t) x[1] << 16 | (uint32_t) x[2] << 8 | x[3];
+}
+
+static void store32(uint8_t *x, uint32_t v)
+{
+    x[0] = v >> 24; x[1] = v >> 16; x[2] = v >> 8; x[3] = v;
+}
+
+// ADRSc = ADRS[3] || ADRS[8:16] || ADRS[19] || ADRS[20:32]
+#define ADRSC_SIZE 22
+
+static void compress_adrs(const ADRS *adrs, uint8_t *adrsc)
+{
+    adrsc[0] = adrs->adrs[3];
+    memcpy(adrsc + 1, adrs->adrs + 8, 8);
+    adrsc[9] = adrs->adrs[19];
+    memcpy(adrsc + 10, adrs->adrs + 20, 12);
+}
+
+// F, H, PRF and Tlen all start with PK.seed padded to a full SHA-256/SHA-512 block,
+// so the compression state after that block only depends on the key.
+// Each thread caches it for the last MIDSTATE_KEYS keys it saw, so a batch that switches between
+// a few keys computes it once per key. With more keys than that, the oldest entry is replaced.
+#define MIDSTATE_KEYS 4
+
+typedef struct {
+    uint8_t n;
+    uint8_t pk_seed[32];
+    uint32_t state256[8];
+    uint64_t state512[8];
+} Midstate;
+
+static _Thread_local struct {
+    Midstate entry[MIDSTATE_KEYS];
+    uint32_t last;      // the entry found or filled last, it is looked at first
+    uint32_t next;      // the entry the next new key replaces
+} midstates;
+
+static const Midstate *load_midstate(Parameters *prm, const uint8_t *pk_seed)
+{
+    for (uint32_t k = 0; k < MIDSTATE_KEYS; k++) {
+        uint32_t i = (midstates.last + k) % MIDSTATE_KEYS;
+        Midstate *m = &midstates.entry[i];
+        if (m->n == prm->n && memcmp(m->pk_seed, pk_seed, prm->n) == 0) {
+            midstates.last = i;
+            return m;
+        }
+    }
+
+    Midstate *m = &midstates.entry[midstates.next];
+    midstates.last = midstates.next;
+    midstates.next = (midstates.next + 1) % MIDSTATE_KEYS;
+
+    uint8_t block[128] = {0};
+    memcpy(block, pk_seed, prm->n);
+
+    SHA_256_CTX ctx256;
+    SHA_256_init(&ctx256);
+    SHA_256_compress(ctx256.state, block, 1);
+    memcpy(m->state256, ctx256.state, sizeof m->state256);
+
+    // SHA-512 is only used by the security categories 3 and 5
+    if (prm->n > 16) {
+        SHA_512_CTX ctx512;
+        SHA_512_init(&ctx512);
+        SHA_512_compress(ctx512.state, block, 1);
+        memcpy(m->state512, ctx512.state, sizeof m->state512);
+    }
+
+    memcpy(m->pk_seed, pk_seed, prm->n);
+    m->n = prm->n;
+    return m;
+}
+
+// Trunc_n(SHA-256(PK.seed || toByte(0, 64 - n) || ADRSc || M))
+static void sha256_seeded(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    uint8_t adrsc[ADRSC_SIZE];
+    uint8_t digest[32];
+    SHA_256_CTX ctx;
+
+    const Midstate *m = load_midstate(prm, pk_seed);
+    SHA_256_init(&ctx);
+    memcpy(ctx.state, m->state256, sizeof ctx.state);
+    ctx.len = 64;
+
+    compress_adrs(adrs, adrsc);
+    SHA_256_update(&ctx, adrsc, sizeof adrsc);
+    SHA_256_update(&ctx, M, M_len);
+    SHA_256_final(&ctx, digest);
+    memcpy(buffer, digest, prm->n);
+}
+
+// Trunc_n(SHA-512(PK.seed || toByte(0, 128 - n) || ADRSc || M))
+static void sha512_seeded(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    uint8_t adrsc[ADRSC_SIZE];
+    uint8_t digest[64];
+    SHA_512_CTX ctx;
+
+    const Midstate *m = load_midstate(prm, pk_seed);
+    SHA_512_init(&ctx);
+    memcpy(ctx.state, m->state512, sizeof ctx.state);
+    ctx.len = 128;
+
+    compress_adrs(adrs, adrsc);
+    SHA_512_update(&ctx, adrsc, sizeof adrsc);
+    SHA_512_update(&ctx, M, M_len);
+    SHA_512_final(&ctx, digest);
+    memcpy(buffer, digest, prm->n);
+}
+
+// Below this many lanes a group is hashed one by one, which is cheaper with the SHA extensions
+#define MIN_LANES 4
+
+// sha256_seeded for count inputs at once, input j is M + j * M_stride with the address adrs[j]
+// ADRSc || M has to fit into the single block after the midstate, i.e. M_len <= 33
+// buffer may alias M if M_stride == n
+static void sha256_seeded_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M, size_t M_stride, size_t M_len, uint8_t *buffer, uint32_t count)
+{
+    uint32_t state[8][SHA_256_LANES];
+    uint32_t W[16][SHA_256_LANES];
+    uint8_t block[64] = {0};
+    size_t used = ADRSC_SIZE + M_len;
+
+    const Midstate *m = load_midstate(prm, pk_seed);
+
+    // the padding is the same in every lane, the length includes the 64 byte PK.seed block
+    block[used] = 0x80;
+    toByte((64 + used) * 8, 8, block + 56);
+
+    for (uint32_t j0 = 0; j0 < count; j0 += SHA_256_LANES) {
+        uint32_t lanes = count - j0 < SHA_256_LANES ? count - j0 : SHA_256_LANES;
+        if (lanes < MIN_LANES) {
+            for (uint32_t j = j0; j < count; j++)
+                sha256_seeded(prm, pk_seed, &adrs[j], M + j * M_stride, M_len, buffer + j * prm->n);
+            break;
+        }
+
+        for (uint32_t j = 0; j < SHA_256_LANES; j++) {
+            // unused lanes hash the previous block again, their result is ignored
+            if (j < lanes) {
+                compress_adrs(&adrs[j0 + j], block);
+                memcpy(block + ADRSC_SIZE, M + (j0 + j) * M_stride, M_len);
+            }
+            for (int t = 0; t < 16; t++)
+                W[t][j] = load32(block + 4 * t);
+            for (int i = 0; i < 8; i++)
+                state[i][j] = m->state256[i];
+        }
+
+        SHA_256_compress_lanes(state, W, lanes);
+
+        for (uint32_t j = 0; j < lanes; j++)
+            for (uint32_t i = 0; i < prm->n / 4; i++)
+                store32(buffer + (j0 + j) * prm->n + 4 * i, state[i][j]);
+    }
+}
+
+// MGF1 from RFC 8017 with SHA-256 for n = 16 and SHA-512 otherwise
+static void mgf1(Parameters *prm, const uint8_t *seed, size_t seed_len, uint8_t *buffer, size_t out_len)
+{
+    uint8_t counter[4];
+    uint8_t digest[64];
+    size_t digest_len = prm->n == 16 ? 32 : 64;
+
+    for (uint32_t i = 0; out_len > 0; i++) {
+        toByte(i, 4, counter);
+        if (prm->n == 16) {
+            SHA_256_CTX ctx;
+            SHA_256_init(&ctx);
+            SHA_256_update(&ctx, seed, seed_len);
+            SHA_256_update(&ctx, counter, 4);
+            SHA_256_final(&ctx, digest);
+        }
+        else {
+            SHA_512_CTX ctx;
+            SHA_512_init(&ctx);
+            SHA_512_update(&ctx, seed, seed_len);
+            SHA_512_update(&ctx, counter, 4);
+            SHA_512_final(&ctx, digest);
+        }
+        size_t len = out_len < digest_len ? out_len : digest_len;
+        memcpy(buffer, digest, len);
+        buffer += len;
+        out_len -= len;
+    }
+}
+
+// H_msg = MGF1(R || PK.seed || SHA-X(R || PK.seed || PK.root || M), m)
+void H_msg_sha2_init(Parameters *prm, MsgCtx *ctx, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root)
+{
+    memcpy(ctx->key, R, prm->n);
+    memcpy(ctx->key + prm->n, pk_seed, prm->n);
+
+    if (prm->n == 16) {
+        SHA_256_init(&ctx->sha256);
+        SHA_256_update(&ctx->sha256, ctx->key, 2 * prm->n);
+        SHA_256_update(&ctx->sha256, pk_root, prm->n);
+    }
+    else {
+        SHA_512_init(&ctx->sha512);
+        SHA_512_update(&ctx->sha512, ctx->key, 2 * prm->n);
+        SHA_512_update(&ctx->sha512, pk_root, prm->n);
+    }
+}
+
+void H_msg_sha2_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len)
+{
+    if (prm->n == 16)
+        SHA_256_update(&ctx->sha256, M, M_len);
+    else
+        SHA_512_update(&ctx->sha512, M, M_len);
+}
+
+void H_msg_sha2_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer)
+{
+    uint8_t seed[2 * 32 + 64];
+    size_t digest_len = prm->n == 16 ? 32 : 64;
+
+    memcpy(seed, ctx->key, 2 * prm->n);
+    if (prm->n == 16)
+        SHA_256_final(&ctx->sha256, seed + 2 * prm->n);
+    else
+        SHA_512_final(&ctx->sha512, seed + 2 * prm->n);
+
+    mgf1(prm, seed, 2 * prm->n + digest_len, buffer, prm->m);
+}
+
+// PRF_msg = Trunc_n(HMAC-SHA-X(SK.prf, opt_rand || M))
+void PRF_msg_sha2_init(Parameters *prm, MsgCtx *ctx, const uint8_t *sk_prf, const uint8_t *opt_rand)
+{
+    uint8_t ipad[128] = {0};
+    size_t block_len = prm->n == 16 ? 64 : 128;
+
+    memcpy(ctx->key, sk_prf, prm->n);
+    memcpy(ipad, sk_prf, prm->n);
+    for (size_t i = 0; i < block_len; i++)
+        ipad[i] ^= 0x36;
+
+    if (prm->n == 16) {
+        SHA_256_init(&ctx->sha256);
+        SHA_256_update(&ctx->sha256, ipad, block_len);
+        SHA_256_update(&ctx->sha256, opt_rand, prm->n);
+    }
+    else {
+        SHA_512_init(&ctx->sha512);
+        SHA_512_update(&ctx->sha512, ipad, block_len);
+        SHA_512_update(&ctx->sha512, opt_rand, prm->n);
+    }
+}
+
+void PRF_msg_sha2_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len)
+{
+    H_msg_sha2_update(prm, ctx, M, M_len);
+}
+
+void PRF_msg_sha2_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer)
+{
+    uint8_t opad[128] = {0};
+    uint8_t digest[64];
+    size_t block_len = prm->n == 16 ? 64 : 128;
+
+    memcpy(opad, ctx->key, prm->n);
+    for (size_t i = 0; i < block_len; i++)
+        opad[i] ^= 0x5c;
+
+    if (prm->n == 16) {
+        SHA_256_final(&ctx->sha256, digest);
+        SHA_256_init(&ctx->sha256);
+        SHA_256_update(&ctx->sha256, opad, block_len);
+        SHA_256_update(&ctx->sha256, digest, 32);
+        SHA_256_final(&ctx->sha256, digest);
+    }
+    else {
+        SHA_512_final(&ctx->sha512, digest);
+        SHA_512_init(&ctx->sha512);
+        SHA_512_update(&ctx->sha512, opad, block_len);
+        SHA_512_update(&ctx->sha512, digest, 64);
+        SHA_512_final(&ctx->sha512, digest);
+    }
+    memcpy(buffer, digest, prm->n);
+}
+
+void H_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M2, uint8_t *buffer)
+{
+    if (prm->n == 16)
+        sha256_seeded(prm, pk_seed, adrs, M2, 2 * prm->n, buffer);
+    else
+        sha512_seeded(prm, pk_seed, adrs, M2, 2 * prm->n, buffer);
+}
+
+void F_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer)
+{
+    sha256_seeded(prm, pk_seed, adrs, M1, prm->n, buffer);
+}
+
+void Tlen_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, uint8_t *Ml, size_t Ml_len, uint8_t *buffer)
+{
+    if (prm->n == 16)
+        sha256_seeded(prm, pk_seed, adrs, Ml, Ml_len, buffer);
+    else
+        sha512_seeded(prm, pk_seed, adrs, Ml, Ml_len, buffer);
+}
+
+void PRF_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer)
+{
+    sha256_seeded(prm, pk_seed, adrs, sk_seed, prm->n, buffer);
+}
+
+void F_sha2_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer, uint32_t count)
+{
+    sha256_seeded_lanes(prm, pk_seed, adrs, M1, prm->n, prm->n, buffer, count);
+}
+
+void PRF_sha2_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer, uint32_t count)
+{
+    sha256_seeded_lanes(prm, pk_seed, adrs, sk_seed, 0, prm->n, buffer, count);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "adrs.h"
+#include "params.h"
+#include "shake.h"
+
+// SHA2 instantiation of the SLH-DSA hash functions (FIPS 205, sections 11.2.1 and 11.2.2)
+// shake.c dispatches to these for the SLH-DSA-SHA2-* parameter sets
+
+void H_msg_sha2_init(Parameters *prm, MsgCtx *ctx, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root);
+
+void H_msg_sha2_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len);
+
+void H_msg_sha2_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer);
+
+void PRF_msg_sha2_init(Parameters *prm, MsgCtx *ctx, const uint8_t *sk_prf, const uint8_t *opt_rand);
+
+void PRF_msg_sha2_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len);
+
+void PRF_msg_sha2_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer);
+
+void H_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M2, uint8_t *buffer);
+
+void F_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer);
+
+void Tlen_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, uint8_t *Ml, size_t Ml_len, uint8_t *buffer);
+
+void PRF_sha2(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer);
+
+// F and PRF for count inputs at once, computed in SHA-256 lanes (see SHA_256_compress_lanes)
+void F_sha2_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer, uint32_t count);
+
+void PRF_sha2_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer, uint32_t count);
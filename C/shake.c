@@ -1,111 +1,296 @@
-#include <gcrypt.h>
-#include "params.h"
-#include "adrs.h"
-#include "KeccakSpongeWidth1600.h"
-
-void H_msg(Parameters *prm, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root, const uint8_t *M, size_t M_len, uint8_t *buffer)
-{
-    uint8_t combined[3 * prm->n + M_len];
-    memcpy(combined, R, prm->n);
-    memcpy(combined + prm->n, pk_seed, prm->n);
-    memcpy(combined + 2 * prm->n, pk_root, prm->n);
-    memcpy(combined + 3 * prm->n, M, M_len);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->m);
-}
-
-void PRF_msg(Parameters *prm, const uint8_t *sk_prf, const uint8_t *opt_rand, const uint8_t *M, size_t M_len, uint8_t *buffer)
-{
-    uint8_t combined[2 * prm->n + M_len];
-    memcpy(combined, sk_prf, prm->n);
-    memcpy(combined + prm->n, opt_rand, prm->n);
-    memcpy(combined + 2 * prm->n, M, M_len);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
-}
-
-void H(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M2, uint8_t *buffer)
-{
-    uint8_t combined[3 * prm->n + ADRS_SIZE];
-    memcpy(combined, pk_seed, prm->n);
-    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
-    memcpy(combined + prm->n + ADRS_SIZE, M2, 2 * prm->n);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
-}
-
-void F(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer)
-{
-    uint8_t combined[2 * prm->n + ADRS_SIZE];
-    memcpy(combined, pk_seed, prm->n);
-    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
-    memcpy(combined + prm->n + ADRS_SIZE, M1, prm->n);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
-}
-
-void Tlen(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, uint8_t *Ml, size_t Ml_len, uint8_t *buffer)
-{
-    uint8_t combined[prm->n + ADRS_SIZE + Ml_len];
-    memcpy(combined, pk_seed, prm->n);
-    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
-    memcpy(combined + prm->n + ADRS_SIZE, Ml, Ml_len);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
-}
-
-void PRF(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer)
-{
-    uint8_t combined[prm->n + ADRS_SIZE + prm->n];
-    memcpy(combined, pk_seed, prm->n);
-    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
-    memcpy(combined + prm->n + ADRS_SIZE, sk_seed, prm->n);
-    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
-}
-
-void SHA_256(const uint8_t *M, size_t M_len, uint8_t *buffer)
-{
-    uint8_t *digest;
-    uint32_t digest_len = gcry_md_get_algo_dlen(GCRY_MD_SHA256);
-
-    gcry_md_hd_t h;
-    gcry_md_open(&h, GCRY_MD_SHA256, GCRY_MD_FLAG_SECURE);
-
-    gcry_md_write(h, M, M_len);
-
-    digest = gcry_md_read(h, GCRY_MD_SHA256);
-    memcpy(buffer, digest, digest_len);
-    gcry_md_close(h);
-}
-
-void SHA_512(const uint8_t *M, size_t M_len, uint8_t *buffer)
-{
-    uint8_t *digest;
-    uint32_t digest_len = gcry_md_get_algo_dlen(GCRY_MD_SHA512);
-
-    gcry_md_hd_t h;
-    gcry_md_open(&h, GCRY_MD_SHA512, GCRY_MD_FLAG_SECURE);
-
-    gcry_md_write(h, M, M_len);
-
-    digest = gcry_md_read(h, GCRY_MD_SHA512);
-    memcpy(buffer, digest, digest_len);
-    gcry_md_close(h);
-}
-
-void SHAKE_128(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len)
-{
-    gcry_md_hd_t h;
-    gcry_md_open(&h, GCRY_MD_SHAKE128, GCRY_MD_FLAG_SECURE);
-
-    gcry_md_write(h, M, M_len);
-
-    gcry_md_extract(h, GCRY_MD_SHAKE128, buffer, out_len);
-    gcry_md_close(h);
-}
-
-void SHAKE_256(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len)
-{
-    gcry_md_hd_t h;
-    gcry_md_open(&h, GCRY_MD_SHAKE256, GCRY_MD_FLAG_SECURE);
-
-    gcry_md_write(h, M, M_len);
-
-    gcry_md_extract(h, GCRY_MD_SHAKE256, buffer, out_len);
-    gcry_md_close(h);
-}
+#include "params.h"
+#include "adrs.h"
+#include "shake.h"
+#include "sha2.h"
+#include "sha2_hash.h"
+#include "shake_x8.h"
+#include "stats.h"
+#include "trace.h"
+#include "KeccakSpongeWidth1600.h"
+
+void SHAKE_256_init(SHAKE_256_CTX *ctx)
+{
+    TRACE_CALL(TRACE_INIT, 0, NULL, 0, NULL, 0);
+    KeccakWidth1600_SpongeInitialize(ctx, 1088, 512);
+}
+
+void SHAKE_256_update(SHAKE_256_CTX *ctx, const uint8_t *M, size_t M_len)
+{
+    STATS_COUNT(keccak, (ctx->byteIOIndex + M_len) / (ctx->rate / 8));
+    TRACE_CALL(TRACE_ABSORB, M_len, M, M_len, NULL, 0);
+    KeccakWidth1600_SpongeAbsorb(ctx, M, M_len);
+}
+
+void SHAKE_256_final(SHAKE_256_CTX *ctx, uint8_t *buffer, size_t out_len)
+{
+    STATS_COUNT(keccak, 1 + (out_len - 1) / (ctx->rate / 8));
+    TRACE_CALL(TRACE_SQUEEZE, 0, NULL, 0, buffer, out_len);
+    KeccakWidth1600_SpongeAbsorbLastFewBits(ctx, 0x1F);
+    KeccakWidth1600_SpongeSqueeze(ctx, buffer, out_len);
+}
+
+void H_msg_init(Parameters *prm, MsgCtx *ctx, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root)
+{
+    STATS_COUNT(H_msg, 1);
+    if (prm->sha2) {
+        H_msg_sha2_init(prm, ctx, R, pk_seed, pk_root);
+        return;
+    }
+    SHAKE_256_init(&ctx->shake);
+    SHAKE_256_update(&ctx->shake, R, prm->n);
+    SHAKE_256_update(&ctx->shake, pk_seed, prm->n);
+    SHAKE_256_update(&ctx->shake, pk_root, prm->n);
+}
+
+void H_msg_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len)
+{
+    if (prm->sha2) {
+        H_msg_sha2_update(prm, ctx, M, M_len);
+        return;
+    }
+    SHAKE_256_update(&ctx->shake, M, M_len);
+}
+
+void H_msg_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer)
+{
+    if (prm->sha2) {
+        H_msg_sha2_final(prm, ctx, buffer);
+        return;
+    }
+    SHAKE_256_final(&ctx->shake, buffer, prm->m);
+}
+
+void PRF_msg_init(Parameters *prm, MsgCtx *ctx, const uint8_t *sk_prf, const uint8_t *opt_rand)
+{
+    STATS_COUNT(PRF_msg, 1);
+    if (prm->sha2) {
+        PRF_msg_sha2_init(prm, ctx, sk_prf, opt_rand);
+        return;
+    }
+    SHAKE_256_init(&ctx->shake);
+    SHAKE_256_update(&ctx->shake, sk_prf, prm->n);
+    SHAKE_256_update(&ctx->shake, opt_rand, prm->n);
+}
+
+void PRF_msg_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len)
+{
+    if (prm->sha2) {
+        PRF_msg_sha2_update(prm, ctx, M, M_len);
+        return;
+    }
+    SHAKE_256_update(&ctx->shake, M, M_len);
+}
+
+void PRF_msg_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer)
+{
+    if (prm->sha2) {
+        PRF_msg_sha2_final(prm, ctx, buffer);
+        return;
+    }
+    SHAKE_256_final(&ctx->shake, buffer, prm->n);
+}
+
+void H_msg(Parameters *prm, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root, const Segment *M, size_t M_count, uint8_t *buffer)
+{
+    // absorb the prefix and each message segment directly, M is never copied
+    MsgCtx ctx;
+    H_msg_init(prm, &ctx, R, pk_seed, pk_root);
+    for (size_t i = 0; i < M_count; i++)
+        H_msg_update(prm, &ctx, M[i].data, M[i].len);
+    H_msg_final(prm, &ctx, buffer);
+}
+
+void PRF_msg(Parameters *prm, const uint8_t *sk_prf, const uint8_t *opt_rand, const Segment *M, size_t M_count, uint8_t *buffer)
+{
+    MsgCtx ctx;
+    PRF_msg_init(prm, &ctx, sk_prf, opt_rand);
+    for (size_t i = 0; i < M_count; i++)
+        PRF_msg_update(prm, &ctx, M[i].data, M[i].len);
+    PRF_msg_final(prm, &ctx, buffer);
+}
+
+void H(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M2, uint8_t *buffer)
+{
+    STATS_COUNT(H, 1);
+    if (prm->sha2) {
+        H_sha2(prm, pk_seed, adrs, M2, buffer);
+        return;
+    }
+    uint8_t combined[3 * prm->n + ADRS_SIZE];
+    memcpy(combined, pk_seed, prm->n);
+    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
+    memcpy(combined + prm->n + ADRS_SIZE, M2, 2 * prm->n);
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(sizeof combined, 136, prm->n));
+    TRACE_CALL(TRACE_H, sizeof combined, M2, 2 * prm->n, buffer, prm->n);
+    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
+}
+
+void F(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer)
+{
+    STATS_COUNT(F, 1);
+    if (prm->sha2) {
+        F_sha2(prm, pk_seed, adrs, M1, buffer);
+        return;
+    }
+    uint8_t combined[2 * prm->n + ADRS_SIZE];
+    memcpy(combined, pk_seed, prm->n);
+    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
+    memcpy(combined + prm->n + ADRS_SIZE, M1, prm->n);
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(sizeof combined, 136, prm->n));
+    TRACE_CALL(TRACE_F, sizeof combined, M1, prm->n, buffer, prm->n);
+    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
+}
+
+void Tlen(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, uint8_t *Ml, size_t Ml_len, uint8_t *buffer)
+{
+    STATS_COUNT(Tlen, 1);
+    if (prm->sha2) {
+        Tlen_sha2(prm, pk_seed, adrs, Ml, Ml_len, buffer);
+        return;
+    }
+    uint8_t combined[prm->n + ADRS_SIZE + Ml_len];
+    memcpy(combined, pk_seed, prm->n);
+    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
+    memcpy(combined + prm->n + ADRS_SIZE, Ml, Ml_len);
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(sizeof combined, 136, prm->n));
+    TRACE_CALL(TRACE_TLEN, sizeof combined, Ml, Ml_len, buffer, prm->n);
+    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
+}
+
+void PRF(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer)
+{
+    STATS_COUNT(PRF, 1);
+    if (prm->sha2) {
+        PRF_sha2(prm, pk_seed, adrs, sk_seed, buffer);
+        return;
+    }
+    uint8_t combined[prm->n + ADRS_SIZE + prm->n];
+    memcpy(combined, pk_seed, prm->n);
+    memcpy(combined + prm->n, adrs->adrs, ADRS_SIZE);
+    memcpy(combined + prm->n + ADRS_SIZE, sk_seed, prm->n);
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(sizeof combined, 136, prm->n));
+    TRACE_CALL(TRACE_PRF, sizeof combined, sk_seed, prm->n, buffer, prm->n);
+    KeccakWidth1600_Sponge(1088, 512, combined, sizeof combined, 0x1F, buffer, prm->n);
+}
+
+// Below this many inputs a group is hashed one by one
+#define MIN_LANES 3
+
+// SHAKE256(PK.seed || ADRS || M) for count inputs, input j is M + j * M_stride with the address adrs[j]
+// buffer may alias M if M_stride == n
+static void shake_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M, size_t M_stride, size_t M_len, uint8_t *buffer, uint32_t count)
+{
+    Segment seg[SHAKE_LANES][3];
+    const Segment *lane_M[SHAKE_LANES];
+    size_t lane_count[SHAKE_LANES];
+    uint8_t *lane_out[SHAKE_LANES];
+
+    for (uint32_t j0 = 0; j0 < count; j0 += SHAKE_LANES) {
+        uint32_t lanes = count - j0 < SHAKE_LANES ? count - j0 : SHAKE_LANES;
+        for (uint32_t j = 0; j < lanes; j++) {
+            seg[j][0] = (Segment) { pk_seed, prm->n };
+            seg[j][1] = (Segment) { adrs[j0 + j].adrs, ADRS_SIZE };
+            seg[j][2] = (Segment) { M + (j0 + j) * M_stride, M_len };
+            lane_M[j] = seg[j];
+            lane_count[j] = 3;
+            lane_out[j] = buffer + (j0 + j) * prm->n;
+        }
+        if (lanes < MIN_LANES) {
+            for (uint32_t j = 0; j < lanes; j++) {
+                SHAKE_256_CTX ctx;
+                SHAKE_256_init(&ctx);
+                for (int i = 0; i < 3; i++)
+                    SHAKE_256_update(&ctx, seg[j][i].data, seg[j][i].len);
+                SHAKE_256_final(&ctx, lane_out[j], prm->n);
+            }
+            break;
+        }
+        SHAKE_256_x8(lane_M, lane_count, lane_out, prm->n, lanes);
+    }
+}
+
+void F_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer, uint32_t count)
+{
+    STATS_COUNT(F, count);
+    if (prm->sha2) {
+        F_sha2_lanes(prm, pk_seed, adrs, M1, buffer, count);
+        return;
+    }
+    shake_lanes(prm, pk_seed, adrs, M1, prm->n, prm->n, buffer, count);
+}
+
+void PRF_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer, uint32_t count)
+{
+    STATS_COUNT(PRF, count);
+    if (prm->sha2) {
+        PRF_sha2_lanes(prm, pk_seed, adrs, sk_seed, buffer, count);
+        return;
+    }
+    shake_lanes(prm, pk_seed, adrs, sk_seed, 0, prm->n, buffer, count);
+}
+
+static void sha256_family(void (*init)(SHA_256_CTX *), const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    SHA_256_CTX ctx;
+    init(&ctx);
+    SHA_256_update(&ctx, M, M_len);
+    SHA_256_final(&ctx, buffer);
+}
+
+static void sha512_family(void (*init)(SHA_512_CTX *), const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    SHA_512_CTX ctx;
+    init(&ctx);
+    SHA_512_update(&ctx, M, M_len);
+    SHA_512_final(&ctx, buffer);
+}
+
+void SHA_224(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha256_family(SHA_224_init, M, M_len, buffer);
+}
+
+void SHA_256(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha256_family(SHA_256_init, M, M_len, buffer);
+}
+
+void SHA_384(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha512_family(SHA_384_init, M, M_len, buffer);
+}
+
+void SHA_512(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha512_family(SHA_512_init, M, M_len, buffer);
+}
+
+void SHA_512_224(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha512_family(SHA_512_224_init, M, M_len, buffer);
+}
+
+void SHA_512_256(const uint8_t *M, size_t M_len, uint8_t *buffer)
+{
+    sha512_family(SHA_512_256_init, M, M_len, buffer);
+}
+
+// SHA3 with an out_len byte digest uses a capacity of twice the digest length, see FIPS 202
+void SHA3(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len)
+{
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(M_len, 200 - 2 * out_len, out_len));
+    KeccakWidth1600_Sponge(1600 - 16 * out_len, 16 * out_len, M, M_len, 0x06, buffer, out_len);
+}
+
+void SHAKE_128(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len)
+{
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(M_len, 168, out_len));
+    KeccakWidth1600_Sponge(1344, 256, M, M_len, 0x1F, buffer, out_len);
+}
+
+void SHAKE_256(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len)
+{
+    STATS_COUNT(keccak, SPONGE_PERMUTATIONS(M_len, 136, out_len));
+    TRACE_CALL(TRACE_SHAKE, M_len, M, M_len, buffer, out_len);
+    KeccakWidth1600_Sponge(1088, 512, M, M_len, 0x1F, buffer, out_len);
+}
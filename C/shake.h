@@ -3,10 +3,50 @@
 #include <stdlib.h>
 #include "adrs.h"
 #include "params.h"
+#include "sha2.h"
+#include "KeccakSpongeWidth1600.h"
 
-void H_msg(Parameters *prm, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root, const uint8_t *M, size_t M_len, uint8_t *buffer);
+// A piece of a message, messages are passed as a list of segments
+// so that prefixes like 0x00 || len(ctx) || ctx can be absorbed without copying M
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} Segment;
 
-void PRF_msg(Parameters *prm, const uint8_t *sk_prf, const uint8_t *opt_rand, const uint8_t *M, size_t M_len, uint8_t *buffer);
+// Incremental SHAKE256, absorbs any number of chunks before squeezing out_len bytes
+typedef KeccakWidth1600_SpongeInstance SHAKE_256_CTX;
+
+// Incremental state of H_msg and PRF_msg, the hash state depends on prm->sha2
+typedef struct {
+    union {
+        SHAKE_256_CTX shake;
+        SHA_256_CTX sha256;
+        SHA_512_CTX sha512;
+    };
+    uint8_t key[64];    // SHA2 only: R || PK.seed for H_msg, SK.prf for PRF_msg
+} MsgCtx;
+
+void SHAKE_256_init(SHAKE_256_CTX *ctx);
+
+void SHAKE_256_update(SHAKE_256_CTX *ctx, const uint8_t *M, size_t M_len);
+
+void SHAKE_256_final(SHAKE_256_CTX *ctx, uint8_t *buffer, size_t out_len);
+
+void H_msg_init(Parameters *prm, MsgCtx *ctx, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root);
+
+void H_msg_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len);
+
+void H_msg_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer);
+
+void PRF_msg_init(Parameters *prm, MsgCtx *ctx, const uint8_t *sk_prf, const uint8_t *opt_rand);
+
+void PRF_msg_update(Parameters *prm, MsgCtx *ctx, const uint8_t *M, size_t M_len);
+
+void PRF_msg_final(Parameters *prm, MsgCtx *ctx, uint8_t *buffer);
+
+void H_msg(Parameters *prm, const uint8_t *R, const uint8_t *pk_seed, const uint8_t *pk_root, const Segment *M, size_t M_count, uint8_t *buffer);
+
+void PRF_msg(Parameters *prm, const uint8_t *sk_prf, const uint8_t *opt_rand, const Segment *M, size_t M_count, uint8_t *buffer);
 
 void H(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M2, uint8_t *buffer);
 
@@ -16,10 +56,28 @@ void Tlen(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, uint8_t *Ml
 
 void PRF(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer);
 
+// F and PRF for count independent inputs, input i uses the address adrs[i]
+// M1 and buffer hold count n-byte strings and may be the same array
+// The inputs are computed in parallel SHA-256 or Keccak lanes
+void F_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *M1, uint8_t *buffer, uint32_t count);
+
+// Uses the same sk_seed for all inputs
+void PRF_lanes(Parameters *prm, const uint8_t *pk_seed, const ADRS *adrs, const uint8_t *sk_seed, uint8_t *buffer, uint32_t count);
+
+void SHA_224(const uint8_t *M, size_t M_len, uint8_t *buffer);
+
 void SHA_256(const uint8_t *M, size_t M_len, uint8_t *buffer);
 
+void SHA_384(const uint8_t *M, size_t M_len, uint8_t *buffer);
+
 void SHA_512(const uint8_t *M, size_t M_len, uint8_t *buffer);
 
+void SHA_512_224(const uint8_t *M, size_t M_len, uint8_t *buffer);
+
+void SHA_512_256(const uint8_t *M, size_t M_len, uint8_t *buffer);
+
+void SHA3(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len);
+
 void SHAKE_128(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len);
 
 void SHAKE_256(const uint8_t *M, size_t M_len, uint8_t *buffer, uint32_t out_len);
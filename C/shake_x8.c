@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+#include "shake.h"
+#include "shake_x8.h"
+#include "stats.h"
+#include "trace.h"
+
+static const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+// rotation offsets of the rho step, indexed by x + 5 * y
+static const int RHO[25] = {
+     0,  1, 62, 28, 27,
+    36, 44,  6, 55, 20,
+     3, 10, 43, 25, 39,
+    41, 45, 15, 21,  8,
+    18,  2, 61, 56, 14
+};
+
+// Keccak-p[1600, 24] on 8 states, A[i] holds lane i of all 8 states
+static void keccak_x8(__m512i *A)
+{
+    __m512i B[25], C[5], D[5];
+
+    for (int round = 0; round < 24; round++) {
+        // theta
+        #pragma GCC unroll 5
+        for (int x = 0; x < 5; x++)
+            C[x] = _mm512_ternarylogic_epi64(_mm512_xor_si512(A[x], A[x + 5]), A[x + 10],
+                                             _mm512_xor_si512(A[x + 15], A[x + 20]), 0x96);
+        #pragma GCC unroll 5
+        for (int x = 0; x < 5; x++)
+            D[x] = _mm512_xor_si512(C[(x + 4) % 5], _mm512_rol_epi64(C[(x + 1) % 5], 1));
+
+        // rho and pi, B[y, 2x + 3y] = ROT(A[x, y])
+        #pragma GCC unroll 5
+        for (int y = 0; y < 5; y++)
+            #pragma GCC unroll 5
+            for (int x = 0; x < 5; x++)
+                B[y + 5 * ((2 * x + 3 * y) % 5)] = _mm512_rolv_epi64(_mm512_xor_si512(A[x + 5 * y], D[x]),
+                                                                     _mm512_set1_epi64(RHO[x + 5 * y]));
+
+        // chi
+        #pragma GCC unroll 5
+        for (int y = 0; y < 25; y += 5)
+            #pragma GCC unroll 5
+            for (int x = 0; x < 5; x++)
+                A[x + y] = _mm512_ternarylogic_epi64(B[x + y], B[(x + 1) % 5 + y], B[(x + 2) % 5 + y], 0xD2);
+
+        // iota
+        A[0] = _mm512_xor_si512(A[0], _mm512_set1_epi64(RC[round]));
+    }
+}
+
+// memcpy for the short pieces gather_block copies, in words so the compiler can inline it
+static inline void copy_bytes(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    for (; len >= 8; len -= 8, dst += 8, src += 8)
+        memcpy(dst, src, 8);
+    for (; len > 0; len--)
+        *dst++ = *src++;
+}
+
+// Copies bytes [off, off + SHAKE_256_RATE) of the message into block and pads it if the message ends there
+static void gather_block(const Segment *M, size_t M_count, size_t M_len, size_t off, uint8_t *block)
+{
+    size_t pos = 0;
+    size_t filled = 0;
+    for (size_t i = 0; i < M_count && filled < SHAKE_256_RATE; i++) {
+        if (pos + M[i].len > off) {
+            size_t start = off > pos ? off - pos : 0;
+            size_t len = M[i].len - start;
+            if (len > SHAKE_256_RATE - filled)
+                len = SHAKE_256_RATE - filled;
+            copy_bytes(block + filled, M[i].data + start, len);
+            filled += len;
+        }
+        pos += M[i].len;
+    }
+    memset(block + filled, 0, SHAKE_256_RATE - filled);
+
+    // 0x1F || 0* || 0x80 in the block holding the end of the message
+    if (M_len < off + SHAKE_256_RATE) {
+        block[M_len - off] ^= 0x1F;
+        block[SHAKE_256_RATE - 1] ^= 0x80;
+    }
+}
+
+void SHAKE_256_x8(const Segment *const *M, const size_t *M_count, uint8_t *const *out, size_t out_len, uint32_t lanes)
+{
+    __m512i A[25];
+    uint8_t blocks[SHAKE_LANES][SHAKE_256_RATE];
+    uint64_t words[SHAKE_LANES];
+    size_t M_len[SHAKE_LANES];
+    size_t nblocks[SHAKE_LANES];
+    size_t max_blocks = 0;
+
+    for (uint32_t j = 0; j < lanes; j++) {
+        M_len[j] = 0;
+        for (size_t i = 0; i < M_count[j]; i++)
+            M_len[j] += M[j][i].len;
+        // the padding always needs at least one byte
+        nblocks[j] = M_len[j] / SHAKE_256_RATE + 1;
+        if (nblocks[j] > max_blocks)
+            max_blocks = nblocks[j];
+    }
+    memset(blocks[lanes], 0, (SHAKE_LANES - lanes) * SHAKE_256_RATE);
+    STATS_COUNT(keccak_x8, max_blocks);
+    TRACE_LANES(M, M_count, out, out_len, lanes);
+    for (int i = 0; i < 25; i++)
+        A[i] = _mm512_setzero_si512();
+
+    // lane j of the vectors reads from blocks[j]
+    const __m512i index = _mm512_setr_epi64(0, 1 * SHAKE_256_RATE / 8, 2 * SHAKE_256_RATE / 8, 3 * SHAKE_256_RATE / 8,
+                                            4 * SHAKE_256_RATE / 8, 5 * SHAKE_256_RATE / 8, 6 * SHAKE_256_RATE / 8, 7 * SHAKE_256_RATE / 8);
+
+    // messages that are already absorbed keep being permuted, their output was taken after their last block
+    for (size_t b = 0; b < max_blocks; b++) {
+        for (uint32_t j = 0; j < lanes; j++) {
+            if (b < nblocks[j])
+                gather_block(M[j], M_count[j], M_len[j], b * SHAKE_256_RATE, blocks[j]);
+            else
+                memset(blocks[j], 0, SHAKE_256_RATE);
+        }
+        for (int i = 0; i < SHAKE_256_RATE / 8; i++)
+            A[i] = _mm512_xor_si512(A[i], _mm512_i64gather_epi64(index, blocks[0] + 8 * i, 8));
+
+        keccak_x8(A);
+
+        for (size_t i = 0; i < out_len; i += 8) {
+            _mm512_storeu_si512(words, A[i / 8]);
+            size_t len = out_len - i < 8 ? out_len - i : 8;
+            for (uint32_t j = 0; j < lanes; j++)
+                if (b == nblocks[j] - 1)
+                    memcpy(out[j] + i, &words[j], len);
+        }
+    }
+}
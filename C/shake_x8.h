@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "shake.h"
+
+// Number of messages SHAKE_256_x8 hashes at once
+#define SHAKE_LANES 8
+
+// SHAKE256 rate in bytes
+#define SHAKE_256_RATE 136
+
+// SHAKE256 of up to 8 independent messages on an 8-way AVX-512 Keccak-p[1600, 24]
+// Message j is the concatenation of the M_count[j] segments in M[j], the messages can have different lengths
+// out_len is at most SHAKE_256_RATE, lanes is the number of messages
+void SHAKE_256_x8(const Segment *const *M, const size_t *M_count, uint8_t *const *out, size_t out_len, uint32_t lanes);
@@ -0,0 +1,430 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "adrs.h"
+#include "external.h"
+#include "fors.h"
+#include "internal.h"
+#include "params.h"
+#include "rng.h"
+#include "shake.h"
+#include "shard.h"
+#include "wots.h"
+#include "xmss.h"
+
+struct ShardPool {
+    uint32_t count;
+    int *fds;                   // coordinator end of each worker's socket pair
+    pid_t *pids;
+    bool *alive;                // false once a worker failed, it gets no more shards
+};
+
+// One tree of a signature, the fields of a request
+typedef struct {
+    uint8_t kind;
+    uint32_t layer;
+    uint64_t tree;
+    uint32_t keypair;
+    uint32_t leaf;
+    uint8_t *out;               // the response without the status
+    size_t out_len;
+} Shard;
+
+static bool read_full(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t got = read(fd, buf, len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        buf += got;
+        len -= got;
+    }
+    return true;
+}
+
+// send instead of write, so a worker that is gone does not raise SIGPIPE
+static bool write_full(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, buf, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        buf += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+static size_t response_len(Parameters *prm, uint8_t kind)
+{
+    return kind == SHARD_FORS ? (1 + prm->a) * prm->n : (prm->h_ + 1) * prm->n;
+}
+
+// Authentication path of leaf in FORS tree leaf >> a, preceded by the leaf's secret value
+static void fors_shard(Parameters *prm, const uint8_t *sk_seed, const uint8_t *pk_seed, uint64_t tree, uint32_t keypair, uint32_t leaf, uint8_t *out)
+{
+    ADRS adrs;
+    initADRS(&adrs);
+    setTreeAddress(&adrs, tree);
+    setTypeAndClear(&adrs, prm->FORS_TREE);
+    setKeyPairAddress(&adrs, keypair);
+
+    uint32_t i = leaf >> prm->a;
+    uint32_t idx = leaf & ((1u << prm->a) - 1);
+    fors_skGen(prm, sk_seed, pk_seed, adrs, leaf, out);
+    for (uint32_t j = 0; j < prm->a; j++) {
+        uint64_t s = (idx >> j) ^ 1;
+        fors_node(prm, sk_seed, ((uint64_t) i << (prm->a - j)) + s, j, pk_seed, adrs, out + (1 + j) * prm->n);
+    }
+}
+
+// Authentication path of leaf in XMSS tree tree of layer layer, followed by the tree's root
+static void xmss_shard(Parameters *prm, const uint8_t *sk_seed, const uint8_t *pk_seed, uint32_t layer, uint64_t tree, uint32_t leaf, uint8_t *out)
+{
+    uint32_t n = prm->n;
+    ADRS adrs;
+    initADRS(&adrs);
+    setLayerAddress(&adrs, layer);
+    setTreeAddress(&adrs, tree);
+    for (uint32_t z = 0; z < prm->h_; z++)
+        xmss_node(prm, sk_seed, (leaf >> z) ^ 1, z, pk_seed, adrs, out + z * n);
+
+    // the root from the leaf and its path costs one leaf instead of a second tree
+    uint8_t node[2 * n];
+    uint8_t *root = out + prm->h_ * n;
+    xmss_node(prm, sk_seed, leaf, 0, pk_seed, adrs, root);
+    setTypeAndClear(&adrs, prm->TREE);
+    for (uint32_t z = 1; z <= prm->h_; z++) {
+        setTreeHeight(&adrs, z);
+        setTreeIndex(&adrs, leaf >> z);
+        const uint8_t *auth = out + (z - 1) * n;
+        if (((leaf >> (z - 1)) & 1) == 0) {
+            memcpy(node, root, n);
+            memcpy(node + n, auth, n);
+        } else {
+            memcpy(node, auth, n);
+            memcpy(node + n, root, n);
+        }
+        H(prm, pk_seed, &adrs, node, root);
+    }
+}
+
+// Reads and answers one request, returns false when the connection is closed or out of step
+static bool serve_one(int fd)
+{
+    uint8_t head[2];
+    char name[SHARD_MAX_NAME + 1];
+    if (!read_full(fd, head, sizeof head) || head[1] > SHARD_MAX_NAME || !read_full(fd, (uint8_t *) name, head[1]))
+        return false;
+    name[head[1]] = '\0';
+
+    Parameters prm;
+    memset(&prm, 0, sizeof prm);
+    setup_parameter_set(&prm, name);
+    if (prm.n == 0) {
+        // the length of the rest depends on n, so the stream cannot be followed any further
+        uint8_t status = SHARD_BAD_REQUEST;
+        write_full(fd, &status, 1);
+        return false;
+    }
+
+    uint32_t n = prm.n;
+    uint8_t body[2 * n + 20];
+    if (!read_full(fd, body, sizeof body))
+        return false;
+    uint32_t layer = toInt(body + 2 * n, 4);
+    uint64_t tree = toInt(body + 2 * n + 4, 8);
+    uint32_t keypair = toInt(body + 2 * n + 12, 4);
+    uint32_t leaf = toInt(body + 2 * n + 16, 4);
+
+    bool valid;
+    if (head[0] == SHARD_FORS)
+        valid = layer == 0 && keypair < (1u << prm.h_) && leaf < ((uint32_t) prm.k << prm.a)
+                && (prm.h - prm.h_ >= 64 || tree >> (prm.h - prm.h_) == 0);
+    else if (head[0] == SHARD_XMSS)
+        valid = layer < prm.d && leaf < (1u << prm.h_)
+                && (prm.h - (layer + 1) * prm.h_ >= 64 || tree >> (prm.h - (layer + 1) * prm.h_) == 0);
+    else
+        valid = false;
+
+    uint8_t response[1 + response_len(&prm, head[0])];
+    response[0] = valid ? SHARD_OK : SHARD_BAD_REQUEST;
+    if (!valid)
+        return write_full(fd, response, 1);
+
+    if (head[0] == SHARD_FORS)
+        fors_shard(&prm, body, body + n, tree, keypair, leaf, response + 1);
+    else
+        xmss_shard(&prm, body, body + n, layer, tree, leaf, response + 1);
+    return write_full(fd, response, sizeof response);
+}
+
+void shard_serve(int fd)
+{
+    while (serve_one(fd))
+        ;
+}
+
+ShardPool *shard_create(uint32_t workers)
+{
+    if (workers == 0)
+        return NULL;
+    ShardPool *sp = calloc(1, sizeof *sp);
+    if (sp == NULL)
+        return NULL;
+    sp->fds = calloc(workers, sizeof *sp->fds);
+    sp->pids = calloc(workers, sizeof *sp->pids);
+    sp->alive = calloc(workers, sizeof *sp->alive);
+    if (sp->fds == NULL || sp->pids == NULL || sp->alive == NULL) {
+        shard_destroy(sp);
+        return NULL;
+    }
+
+    // buffered output would otherwise be written again by each child
+    fflush(stdout);
+    for (uint32_t w = 0; w < workers; w++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+            printf("Error creating socket pair\n");
+            shard_destroy(sp);
+            return NULL;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("Error starting worker process\n");
+            close(pair[0]);
+            close(pair[1]);
+            shard_destroy(sp);
+            return NULL;
+        }
+        if (pid == 0) {
+            // the child keeps only its own end, so a worker ends when the coordinator closes it
+            for (uint32_t v = 0; v < sp->count; v++)
+                close(sp->fds[v]);
+            close(pair[0]);
+            shard_serve(pair[1]);
+            _exit(0);
+        }
+        close(pair[1]);
+        sp->fds[w] = pair[0];
+        sp->pids[w] = pid;
+        sp->alive[w] = true;
+        sp->count++;
+    }
+    return sp;
+}
+
+void shard_destroy(ShardPool *sp)
+{
+    if (sp == NULL)
+        return;
+    for (uint32_t w = 0; w < sp->count; w++)
+        close(sp->fds[w]);
+    for (uint32_t w = 0; w < sp->count; w++)
+        waitpid(sp->pids[w], NULL, 0);
+    free(sp->fds);
+    free(sp->pids);
+    free(sp->alive);
+    free(sp);
+}
+
+static bool send_shard(int fd, Parameters *prm, const uint8_t *SK, const Shard *s)
+{
+    uint32_t n = prm->n;
+    uint8_t req[2 + SHARD_MAX_NAME + 2 * n + 20];
+    size_t name_len = strlen(prm->name);
+
+    uint8_t *p = req;
+    *p++ = s->kind;
+    *p++ = name_len;
+    memcpy(p, prm->name, name_len);
+    p += name_len;
+    memcpy(p, SK, n);                   // SK.seed
+    memcpy(p + n, SK + 2 * n, n);       // PK.seed
+    p += 2 * n;
+    toByte(s->layer, 4, p);
+    toByte(s->tree, 8, p + 4);
+    toByte(s->keypair, 4, p + 12);
+    toByte(s->leaf, 4, p + 16);
+    p += 20;
+    return write_full(fd, req, p - req);
+}
+
+// Runs every shard on the workers, one shard per worker at a time so the fast ones take more
+// Returns false if all workers failed or one rejected its request
+static bool run_shards(ShardPool *sp, Parameters *prm, const uint8_t *SK, Shard *shards, size_t count)
+{
+    // shards still to hand out, the last one goes first
+    size_t pending[count];
+    size_t pending_len = count;
+    for (size_t i = 0; i < count; i++)
+        pending[i] = i;
+    size_t finished = 0;
+
+    long assigned[sp->count];
+    for (uint32_t w = 0; w < sp->count; w++)
+        assigned[w] = -1;
+
+    while (finished < count) {
+        struct pollfd pfd[sp->count];
+        uint32_t worker[sp->count];
+        nfds_t busy = 0;
+        for (uint32_t w = 0; w < sp->count; w++) {
+            if (!sp->alive[w])
+                continue;
+            if (assigned[w] < 0 && pending_len > 0) {
+                size_t s = pending[--pending_len];
+                if (send_shard(sp->fds[w], prm, SK, &shards[s])) {
+                    assigned[w] = s;
+                } else {
+                    printf("Shard worker %u failed\n", w);
+                    sp->alive[w] = false;
+                    pending[pending_len++] = s;
+                    continue;
+                }
+            }
+            if (assigned[w] >= 0) {
+                pfd[busy] = (struct pollfd) { sp->fds[w], POLLIN, 0 };
+                worker[busy++] = w;
+            }
+        }
+        if (busy == 0) {
+            printf("No shard worker left\n");
+            return false;
+        }
+
+        if (poll(pfd, busy, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        for (nfds_t b = 0; b < busy; b++) {
+            if (pfd[b].revents == 0)
+                continue;
+            uint32_t w = worker[b];
+            Shard *s = &shards[assigned[w]];
+            uint8_t status;
+            if (!read_full(sp->fds[w], &status, 1) || (status == SHARD_OK && !read_full(sp->fds[w], s->out, s->out_len))) {
+                // hand the shard to another worker
+                printf("Shard worker %u failed\n", w);
+                sp->alive[w] = false;
+                pending[pending_len++] = assigned[w];
+                continue;
+            }
+            if (status != SHARD_OK) {
+                printf("Shard request rejected\n");
+                return false;
+            }
+            assigned[w] = -1;
+            finished++;
+        }
+    }
+    return true;
+}
+
+bool shard_sign(ShardPool *sp, Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return false;
+    }
+    uint32_t n = prm->n;
+    const uint8_t *sk_seed = SK;
+    const uint8_t *pk_seed = SK + 2 * n;
+
+    // for deterministic varaiant, use PK_seed for addrnd
+    uint8_t addrnd[n];
+    if (deterministic)
+        memcpy(addrnd, pk_seed, n);
+    else if (!random_bytes(addrnd, n)) {
+        printf("Error initalizing sodium library\n");
+        return false;
+    }
+
+    // M' = 0x00 || len(ctx) || ctx || M
+    uint8_t prefix[2] = { 0, (uint8_t) ctx_len };
+    Segment M_prime[3] = { { prefix, sizeof prefix }, { ctx, ctx_len }, { M, M_len } };
+    PRF_msg(prm, SK + n, addrnd, M_prime, 3, SIG);
+    uint8_t digest[prm->m];
+    H_msg(prm, SIG, pk_seed, SK + 3 * n, M_prime, 3, digest);
+
+    uint64_t idx_tree, idx_leaf;
+    split_digest(prm, digest, NULL, &idx_tree, &idx_leaf);
+
+    // the FORS shards write their part of SIG, the XMSS shards go to xmss_out first
+    size_t fors_len = (1 + prm->a) * n;
+    size_t xmss_len = response_len(prm, SHARD_XMSS);
+    uint8_t *sig_fors = SIG + n;
+    uint8_t *sig_ht = sig_fors + prm->k * fors_len;
+    uint8_t xmss_out[prm->d * xmss_len];
+
+    // FORS first: run_shards hands out the last shard first, so the larger XMSS trees go out before them
+    Shard shards[prm->k + prm->d];
+    uint32_t indices[prm->k];
+    base_2b(digest, prm->a, prm->k, indices);
+    for (uint32_t i = 0; i < prm->k; i++)
+        shards[i] = (Shard) { SHARD_FORS, 0, idx_tree, idx_leaf, (i << prm->a) + indices[i], sig_fors + i * fors_len, fors_len };
+    uint64_t tree = idx_tree;
+    uint32_t leaf = idx_leaf;
+    for (uint32_t j = 0; j < prm->d; j++) {
+        shards[prm->k + j] = (Shard) { SHARD_XMSS, j, tree, 0, leaf, xmss_out + j * xmss_len, xmss_len };
+        leaf = tree & ((1u << prm->h_) - 1);
+        tree = tree >> prm->h_;
+    }
+
+    size_t sig_len = slh_signature_length(prm);
+    if (!run_shards(sp, prm, SK, shards, prm->k + prm->d)) {
+        memset(SIG, 0, sig_len);
+        return false;
+    }
+
+    // the WOTS+ signatures chain: each one signs the root of the layer below
+    ADRS adrs;
+    initADRS(&adrs);
+    setTreeAddress(&adrs, idx_tree);
+    setTypeAndClear(&adrs, prm->FORS_TREE);
+    setKeyPairAddress(&adrs, idx_leaf);
+    uint8_t root[n];
+    fors_pkFromSig(prm, sig_fors, digest, pk_seed, adrs, root);
+
+    for (uint32_t j = 0; j < prm->d; j++) {
+        const Shard *s = &shards[prm->k + j];
+        uint8_t *sig_xmss = sig_ht + j * (prm->len + prm->h_) * n;
+        initADRS(&adrs);
+        setLayerAddress(&adrs, j);
+        setTreeAddress(&adrs, s->tree);
+
+        ADRS wots_adrs = adrs;
+        setTypeAndClear(&wots_adrs, prm->WOTS_HASH);
+        setKeyPairAddress(&wots_adrs, s->leaf);
+        wots_sign(prm, root, sk_seed, pk_seed, wots_adrs, sig_xmss);
+        memcpy(sig_xmss + prm->len * n, s->out, prm->h_ * n);
+
+        // a fault in the WOTS+ signature or the worker's leaf shows up here, one in a path at PK.root
+        uint8_t check[n];
+        xmss_pkFromSig(prm, s->leaf, sig_xmss, root, pk_seed, adrs, check);
+        if (memcmp(check, s->out + prm->h_ * n, n) != 0) {
+            printf("Shard results do not match\n");
+            memset(SIG, 0, sig_len);
+            return false;
+        }
+        memcpy(root, check, n);
+    }
+
+    if (memcmp(root, SK + 3 * n, n) != 0) {
+        printf("Shard results do not match PK.root\n");
+        memset(SIG, 0, sig_len);
+        return false;
+    }
+    return true;
+}
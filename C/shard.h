@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "params.h"
+
+// One signature split over worker processes
+// The coordinator computes R and H_msg, then hands out k FORS trees and d XMSS trees as shards:
+// a shard is the authentication path (and for XMSS the root) of one tree at an explicit address,
+// which does not depend on the message, so all shards run at the same time.
+// The coordinator then WOTS-signs the layers in order and checks every layer and the final root against PK.root.
+// Workers receive SK.seed with every request, they must be as trusted as the coordinator.
+typedef struct ShardPool ShardPool;
+
+// Longest parameter set name in a request
+#define SHARD_MAX_NAME 32
+
+// Request: kind (1 byte), name length (1 byte), parameter set name, SK.seed, PK.seed,
+// layer (4 bytes), tree address (8 bytes), key pair address (4 bytes), leaf (4 bytes), integers big-endian
+// For a FORS shard, layer is 0, the key pair is idx_leaf and leaf is i * 2^a + indices[i] for tree i
+// For an XMSS shard, tree and leaf are the tree and leaf index within the layer, the key pair is ignored
+enum {
+    SHARD_FORS = 1,
+    SHARD_XMSS = 2
+};
+
+// Response: status (1 byte), then on SHARD_OK the FORS tree's signature, sk || AUTH ((1 + a) * n bytes),
+// or the XMSS tree's AUTH || root ((h' + 1) * n bytes)
+enum {
+    SHARD_OK          = 0,
+    SHARD_BAD_REQUEST = 1
+};
+
+// Forks the given number of worker processes, each connected to the coordinator by a Unix socket pair
+// Call it before the process starts threads, the children only inherit the calling thread
+// Returns NULL if a socket pair or a process could not be created
+ShardPool *shard_create(uint32_t workers);
+
+// Closes the sockets, which ends the workers, and waits for them
+void shard_destroy(ShardPool *sp);
+
+// Answers shard requests on the stream socket fd until the peer closes it
+// This is the loop of the forked workers, it works on any connected stream socket
+void shard_serve(int fd);
+
+// Algorithm 22 with the trees computed by the workers of sp, SIG is the same as that of slh_sign
+// A worker that fails has its shard handed to another one
+// Returns false if ctx is too long, no randomness was available, all workers failed
+// or the results did not add up to a signature under PK.root (SIG is then cleared)
+bool shard_sign(ShardPool *sp, Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic);
@@ -0,0 +1,408 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "adrs.h"
+#include "external.h"
+#include "fors.h"
+#include "internal.h"
+#include "params.h"
+#include "rng.h"
+#include "shake.h"
+#include "sign_state.h"
+#include "timing.h"
+#include "wots.h"
+#include "xmss.h"
+
+// FORS trees are built from subtrees of this height, whose leaves fill the hash lanes together
+#define FORS_BLOCK_HEIGHT 4
+
+enum {
+    SIGN_PRF_MSG,
+    SIGN_H_MSG,
+    SIGN_FORS,
+    SIGN_WOTS,      // WOTS+ signature of the current layer
+    SIGN_XMSS,      // leaves of the current layer's XMSS tree
+    SIGN_DONE
+};
+
+// The tree that is being built: its height, the height of its blocks, the signed leaf and where its authentication path goes
+typedef struct {
+    uint32_t height;
+    uint32_t block_height;
+    uint64_t target;
+    uint8_t *auth;
+} Tree;
+
+void slh_sign_init_internal(Parameters *prm, SignState *st, const Segment *M, size_t M_count, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG)
+{
+    memset(st, 0, sizeof *st);
+    st->prm = prm;
+    st->M = M;
+    st->M_count = M_count;
+    st->SK = SK;
+    st->SIG = SIG;
+    memcpy(st->addrnd, addrnd, prm->n);
+
+    st->phase = SIGN_PRF_MSG;
+    PRF_msg_init(prm, &st->msg, SK + 1 * prm->n, st->addrnd);
+}
+
+bool slh_sign_init_addrnd(Parameters *prm, SignState *st, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG)
+{
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        return false;
+    }
+
+    slh_sign_init_internal(prm, st, st->M_prime, 3, SK, addrnd, SIG);
+    st->prefix[0] = 0;
+    toByte(ctx_len, 1, st->prefix + 1);
+    st->M_prime[0] = (Segment) { st->prefix, sizeof st->prefix };
+    st->M_prime[1] = (Segment) { ctx, ctx_len };
+    st->M_prime[2] = (Segment) { M, M_len };
+    return true;
+}
+
+void slh_sign_set_sink(SignState *st, SignSink sink, void *arg)
+{
+    st->sink = sink;
+    st->sink_arg = arg;
+}
+
+// Offsets of the parts of the signature
+static size_t fors_offset(Parameters *prm, uint32_t i)
+{
+    return prm->n + i * (1 + prm->a) * prm->n;
+}
+
+static size_t layer_offset(Parameters *prm, uint32_t j)
+{
+    return fors_offset(prm, prm->k) + j * (prm->len + prm->h_) * prm->n;
+}
+
+// Where the signature byte at offset goes, into SIG or, with a sink, into the buffer of the current part
+static uint8_t *sig_at(SignState *st, size_t offset)
+{
+    if (st->sink == NULL)
+        return st->SIG + offset;
+    return st->part + (offset - st->part_start);
+}
+
+// The signature is complete up to offset end, a sink gets the current part now
+// Returns false if the sink failed, which ends the signature
+static bool part_done(SignState *st, size_t end)
+{
+    if (st->sink == NULL)
+        return true;
+    if (!st->sink(st->sink_arg, st->part, end - st->part_start)) {
+        st->failed = true;
+        st->phase = SIGN_DONE;
+        return false;
+    }
+    st->part_start = end;
+    return true;
+}
+
+bool slh_sign_init(Parameters *prm, SignState *st, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic)
+{
+    // for the deterministic variant, PK.seed is addrnd
+    uint8_t addrnd[prm->n];
+    if (deterministic) {
+        memcpy(addrnd, SK + 2 * prm->n, prm->n);
+    } else if (!random_bytes(addrnd, sizeof addrnd)) {
+        printf("Error initalizing sodium library\n");
+        return false;
+    }
+    return slh_sign_init_addrnd(prm, st, M, M_len, ctx, ctx_len, SK, addrnd, SIG);
+}
+
+// Absorbs up to MSG_CHUNK_LEN bytes of M into PRF_msg or H_msg, and finishes the hash at the end of M
+static uint64_t absorb_chunk(SignState *st)
+{
+    Parameters *prm = st->prm;
+    size_t left = MSG_CHUNK_LEN;
+
+    while (left > 0 && st->segment < st->M_count) {
+        const Segment *seg = &st->M[st->segment];
+        size_t len = seg->len - st->offset < left ? seg->len - st->offset : left;
+        if (st->phase == SIGN_PRF_MSG)
+            PRF_msg_update(prm, &st->msg, seg->data + st->offset, len);
+        else
+            H_msg_update(prm, &st->msg, seg->data + st->offset, len);
+        left -= len;
+        st->offset += len;
+        if (st->offset == seg->len) {
+            st->segment++;
+            st->offset = 0;
+        }
+    }
+    uint64_t cost = 1 + (MSG_CHUNK_LEN - left) / 64;
+    if (st->segment < st->M_count)
+        return cost;
+
+    st->segment = 0;
+    if (st->phase == SIGN_PRF_MSG) {
+        // R is the first part of the signature
+        PRF_msg_final(prm, &st->msg, sig_at(st, 0));
+        H_msg_init(prm, &st->msg, sig_at(st, 0), st->SK + 2 * prm->n, st->SK + 3 * prm->n);
+        st->phase = SIGN_H_MSG;
+        part_done(st, prm->n);
+        return cost;
+    }
+
+    H_msg_final(prm, &st->msg, st->digest);
+    split_digest(prm, st->digest, NULL, &st->idx_tree, &st->idx_leaf);
+
+    st->phase = SIGN_FORS;
+    st->tree = 0;
+    st->block = 0;
+    st->stack_len = 0;
+    return cost;
+}
+
+static ADRS fors_adrs(SignState *st)
+{
+    ADRS adrs;
+    initADRS(&adrs);
+    setTreeAddress(&adrs, st->idx_tree);
+    setTypeAndClear(&adrs, st->prm->FORS_TREE);
+    setKeyPairAddress(&adrs, st->idx_leaf);
+    return adrs;
+}
+
+static ADRS layer_adrs(SignState *st)
+{
+    ADRS adrs;
+    initADRS(&adrs);
+    setLayerAddress(&adrs, st->tree);
+    setTreeAddress(&adrs, st->layer_tree);
+    return adrs;
+}
+
+static void current_tree(SignState *st, Tree *t)
+{
+    Parameters *prm = st->prm;
+    if (st->phase == SIGN_FORS) {
+        uint32_t indices[prm->k];
+        base_2b(st->digest, prm->a, prm->k, indices);
+        t->height = prm->a;
+        t->block_height = prm->a < FORS_BLOCK_HEIGHT ? prm->a : FORS_BLOCK_HEIGHT;
+        t->target = indices[st->tree];
+        t->auth = sig_at(st, fors_offset(prm, st->tree) + prm->n);
+    } else {
+        t->height = prm->h_;
+        t->block_height = 0;
+        t->target = st->layer_leaf;
+        t->auth = sig_at(st, layer_offset(prm, st->tree) + prm->len * prm->n);
+    }
+}
+
+// Node i of height z of the current tree, i counts from the left of this tree
+static void tree_node(SignState *st, uint64_t i, uint32_t z, uint8_t *buffer)
+{
+    Parameters *prm = st->prm;
+    if (st->phase == SIGN_FORS)
+        fors_node(prm, st->SK, ((uint64_t) st->tree << (prm->a - z)) + i, z, st->SK + 2 * prm->n, fors_adrs(st), buffer);
+    else
+        xmss_node(prm, st->SK, i, z, st->SK + 2 * prm->n, layer_adrs(st), buffer);
+}
+
+// Node i of height z from its children, which are next to each other in pair
+static void tree_parent(SignState *st, uint64_t i, uint32_t z, const uint8_t *pair, uint8_t *buffer)
+{
+    Parameters *prm = st->prm;
+    ADRS adrs;
+    if (st->phase == SIGN_FORS) {
+        adrs = fors_adrs(st);
+        setTreeHeight(&adrs, z);
+        setTreeIndex(&adrs, ((uint64_t) st->tree << (prm->a - z)) + i);
+    } else {
+        adrs = layer_adrs(st);
+        setTypeAndClear(&adrs, prm->TREE);
+        setTreeHeight(&adrs, z);
+        setTreeIndex(&adrs, i);
+    }
+    H(prm, st->SK + 2 * prm->n, &adrs, pair, buffer);
+}
+
+// The signed leaf, for FORS its secret value also goes into the signature
+static void tree_leaf(SignState *st, const Tree *t, uint8_t *buffer)
+{
+    Parameters *prm = st->prm;
+    if (st->phase != SIGN_FORS) {
+        tree_node(st, t->target, 0, buffer);
+        return;
+    }
+    uint8_t *sk = t->auth - prm->n;
+    uint64_t idx = ((uint64_t) st->tree << prm->a) + t->target;
+    ADRS adrs = fors_adrs(st);
+    fors_skGen(prm, st->SK, st->SK + 2 * prm->n, adrs, idx, sk);
+    setTreeHeight(&adrs, 0);
+    setTreeIndex(&adrs, idx);
+    F(prm, st->SK + 2 * prm->n, &adrs, sk, buffer);
+}
+
+// Computes the next block of the current tree and merges it into the stack
+// Nodes of the signed leaf's authentication path are copied to the signature when they appear
+// Returns true when the stack holds the root of the tree
+static bool tree_block(SignState *st, uint64_t *cost)
+{
+    Parameters *prm = st->prm;
+    uint32_t n = prm->n;
+    Tree t;
+    current_tree(st, &t);
+
+    uint64_t leaf_cost = st->phase == SIGN_FORS ? 3 : prm->len * prm->w + 1;
+    uint64_t index = st->block++;
+    uint32_t z = t.block_height;
+    uint8_t node[n];
+    uint8_t pair[2 * n];
+    *cost += leaf_cost << z;
+
+    if (index == t.target >> z) {
+        // the block of the signed leaf: the authentication path inside the block, then the path from the leaf to the block root
+        tree_leaf(st, &t, node);
+        for (uint32_t j = 0; j < z; j++) {
+            uint64_t sibling = (t.target >> j) ^ 1;
+            tree_node(st, sibling, j, t.auth + j * n);
+            memcpy(pair + (sibling & 1 ? 0 : n), node, n);
+            memcpy(pair + (sibling & 1 ? n : 0), t.auth + j * n, n);
+            tree_parent(st, t.target >> (j + 1), j + 1, pair, node);
+        }
+        *cost += z;
+    } else {
+        tree_node(st, index, z, node);
+    }
+
+    for (;;) {
+        if (z < t.height && index == ((t.target >> z) ^ 1))
+            memcpy(t.auth + z * n, node, n);
+        if (st->stack_len == 0 || st->stack_height[st->stack_len - 1] != z)
+            break;
+        // the left sibling is on top of the stack
+        st->stack_len--;
+        memcpy(pair, st->stack[st->stack_len], n);
+        memcpy(pair + n, node, n);
+        index >>= 1;
+        z++;
+        tree_parent(st, index, z, pair, node);
+        (*cost)++;
+    }
+    memcpy(st->stack[st->stack_len], node, n);
+    st->stack_height[st->stack_len] = z;
+    st->stack_len++;
+    return z == t.height;
+}
+
+// Runs one unit of work and returns its approximate number of hash calls
+static uint64_t sign_unit(SignState *st)
+{
+    Parameters *prm = st->prm;
+    uint64_t cost = 0;
+
+    switch (st->phase) {
+    case SIGN_PRF_MSG:
+    case SIGN_H_MSG:
+        return absorb_chunk(st);
+
+    case SIGN_FORS:
+        if (!tree_block(st, &cost))
+            return cost;
+        memcpy(st->roots + st->tree * prm->n, st->stack[0], prm->n);
+        if (!part_done(st, fors_offset(prm, st->tree + 1)))
+            return cost;
+        st->tree++;
+        st->block = 0;
+        st->stack_len = 0;
+        if (st->tree < prm->k)
+            return cost;
+
+        // algorithm 17, lines 24 to 27 on the roots built while signing
+        ADRS forspkadrs = fors_adrs(st);
+        setTypeAndClear(&forspkadrs, prm->FORS_ROOTS);
+        setKeyPairAddress(&forspkadrs, st->idx_leaf);
+        Tlen(prm, st->SK + 2 * prm->n, &forspkadrs, st->roots, prm->k * prm->n, st->root);
+
+        st->phase = SIGN_WOTS;
+        st->tree = 0;
+        st->layer_tree = st->idx_tree;
+        st->layer_leaf = st->idx_leaf;
+        return cost + 1;
+
+    case SIGN_WOTS: {
+        uint8_t *sig = sig_at(st, layer_offset(prm, st->tree));
+        ADRS adrs = layer_adrs(st);
+        setTypeAndClear(&adrs, prm->WOTS_HASH);
+        setKeyPairAddress(&adrs, st->layer_leaf);
+        wots_sign(prm, st->root, st->SK, st->SK + 2 * prm->n, adrs, sig);
+        st->phase = SIGN_XMSS;
+        // on average half of each chain is computed
+        return prm->len * (prm->w + 1) / 2;
+    }
+
+    case SIGN_XMSS:
+        if (!tree_block(st, &cost))
+            return cost;
+        memcpy(st->root, st->stack[0], prm->n);
+        if (!part_done(st, layer_offset(prm, st->tree + 1)))
+            return cost;
+        st->tree++;
+        st->block = 0;
+        st->stack_len = 0;
+        if (st->tree == prm->d) {
+            st->phase = SIGN_DONE;
+            return cost;
+        }
+        st->layer_leaf = st->layer_tree & ((1 << prm->h_) - 1);
+        st->layer_tree = st->layer_tree >> prm->h_;
+        st->phase = SIGN_WOTS;
+        return cost;
+    }
+    return 0;
+}
+
+bool slh_sign_step(SignState *st, const SignBudget *budget)
+{
+    uint64_t hashes = budget != NULL ? budget->hashes : 0;
+    uint64_t ns = budget != NULL ? budget->ns : 0;
+    uint64_t start = ns > 0 ? now_ns() : 0;
+    uint64_t spent = 0;
+
+    while (st->phase != SIGN_DONE) {
+        spent += sign_unit(st);
+        if (hashes > 0 && spent >= hashes)
+            break;
+        if (ns > 0 && now_ns() - start >= ns)
+            break;
+    }
+    return st->phase == SIGN_DONE;
+}
+
+static bool fd_sink(void *arg, const uint8_t *data, size_t len)
+{
+    int fd = *(int *) arg;
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+bool slh_sign_fd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, int fd, bool deterministic)
+{
+    SignState st;
+    if (!slh_sign_init(prm, &st, M, M_len, ctx, ctx_len, SK, NULL, deterministic))
+        return false;
+    slh_sign_set_sink(&st, fd_sink, &fd);
+    slh_sign_step(&st, NULL);
+    return !st.failed;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "params.h"
+#include "shake.h"
+
+// Largest n, m, k, a and h' of the parameter sets
+#define SIGN_STATE_MAX_N 32
+#define SIGN_STATE_MAX_M 49
+#define SIGN_STATE_MAX_K 35
+#define SIGN_STATE_MAX_HEIGHT 14
+
+// Longest part of a signature that a sink receives at once, one XMSS signature of SLH-DSA-*-256s, (67 + 8) * 32
+#define SIGN_STATE_MAX_PART 2400
+
+// Receives the signature in order, returns false to abort signing (e.g. when the connection is gone)
+typedef bool (*SignSink)(void *arg, const uint8_t *data, size_t len);
+
+// Resumable signature (algorithm 19), computed a small unit of work at a time by slh_sign_step
+// The units are one message chunk of PRF_msg or H_msg, 16 leaves of a FORS tree, one leaf of an XMSS tree
+// or one WOTS+ signature. The trees are built bottom-up with a stack, so each leaf is computed once.
+// The state holds a Keccak state with 64-byte alignment, allocate it with aligned_alloc when it is not on the stack.
+// M' points into the state after slh_sign_init, so the state must not be copied while signing.
+// With a sink, the signature is not kept: R, each FORS tree and each XMSS layer go to the sink when they are complete.
+typedef struct {
+    Parameters *prm;
+    const Segment *M;           // must stay valid until the signature is done
+    size_t M_count;
+    uint8_t prefix[2];          // M' = 0x00 || len(ctx) || ctx || M for slh_sign_init
+    Segment M_prime[3];
+    const uint8_t *SK;
+    uint8_t *SIG;
+    uint8_t addrnd[SIGN_STATE_MAX_N];
+
+    uint32_t phase;
+    MsgCtx msg;                 // PRF_msg, then H_msg
+    size_t segment;             // position in M while absorbing
+    size_t offset;
+    uint8_t digest[SIGN_STATE_MAX_M];
+    uint64_t idx_tree;
+    uint64_t idx_leaf;
+
+    uint32_t tree;              // FORS tree or hypertree layer
+    uint64_t layer_tree;        // tree and leaf index within the current layer
+    uint64_t layer_leaf;
+    uint64_t block;             // next block of the current tree
+    uint32_t stack_len;         // nodes on the stack, their heights strictly decrease
+    uint8_t stack[SIGN_STATE_MAX_HEIGHT + 1][SIGN_STATE_MAX_N];
+    uint32_t stack_height[SIGN_STATE_MAX_HEIGHT + 1];
+    uint8_t roots[SIGN_STATE_MAX_K * SIGN_STATE_MAX_N];     // FORS tree roots
+    uint8_t root[SIGN_STATE_MAX_N];     // message of the next layer: FORS public key, then the root of the last layer
+
+    SignSink sink;
+    void *sink_arg;
+    size_t part_start;          // offset in the signature of the part that is being computed
+    uint8_t part[SIGN_STATE_MAX_PART];
+    bool failed;                // the sink returned false, the signature stopped
+} SignState;
+
+// Budget of one slh_sign_step call, 0 means no limit
+// hashes counts calls of F, H, PRF and T_l, a 64-byte block of the message counts as one call
+typedef struct {
+    uint64_t hashes;
+    uint64_t ns;
+} SignBudget;
+
+// Prepares algorithm 19 for the message segments M with addrnd, the signature goes to SIG
+void slh_sign_init_internal(Parameters *prm, SignState *st, const Segment *M, size_t M_count, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG);
+
+// Prepares algorithm 22 with the caller's addrnd, returns false if ctx is too long
+bool slh_sign_init_addrnd(Parameters *prm, SignState *st, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, const uint8_t *addrnd, uint8_t *SIG);
+
+// Prepares algorithm 22, returns false if ctx is too long or no randomness was available
+bool slh_sign_init(Parameters *prm, SignState *st, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, uint8_t *SIG, bool deterministic);
+
+// Sends the signature to sink instead of SIG (which may then be NULL), call it after init and before the first step
+void slh_sign_set_sink(SignState *st, SignSink sink, void *arg);
+
+// Runs units of work until the budget is spent or the signature is done, at least one unit per call
+// Returns true once SIG holds the whole signature, which is the same as the one of slh_sign_internal
+// With a sink, the signature is complete when this returns true and st->failed is false
+// budget may be NULL to finish the signature in one call
+bool slh_sign_step(SignState *st, const SignBudget *budget);
+
+// Algorithm 22 with the signature written to fd as its parts are computed
+// Returns false if ctx is too long, no randomness was available or writing failed
+bool slh_sign_fd(Parameters *prm, const uint8_t *M, size_t M_len, const uint8_t *ctx, size_t ctx_len, const uint8_t *SK, int fd, bool deterministic);
@@ -0,0 +1,636 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "external.h"
+#include "params.h"
+#include "pool.h"
+#include "shake_x8.h"
+#include "slhd.h"
+#include "timing.h"
+
+// Signing daemon: holds the configured keys and serves sign and verify requests over a Unix socket, see slhd.h
+// slhd [-t threads] [-w wait_us] socket set:keyfile...
+// A key file holds SK (4 * n bytes), anything after it is ignored, so the output of slh_keygen_batch_file works as well.
+//
+// One thread runs the event loop. Requests that arrive close together are signed and verified as one batch on the
+// worker pool, so the SHAKE sets fill the lanes of the lockstep signer. While a batch runs, new requests queue up
+// in the sockets and form the next batch.
+
+// How long the first pending request waits for others to join its batch
+#define DEFAULT_WAIT_US 200
+
+// A client is not read while it has this many complete requests, or the bytes of the longest request, waiting
+// in either direction, so pipelining cannot make the daemon buffer without bound
+#define CLIENT_MAX_PENDING 64
+#define CLIENT_MAX_INPUT (4 + (size_t) SLHD_MAX_REQUEST)
+
+// Most requests in one batch, a batch takes at most CLIENT_MAX_PENDING of them from each client
+#define BATCH_MAX 1024
+
+typedef struct {
+    Parameters prm;
+    char name[32];
+    uint8_t SK[128];
+    uint8_t *top;       // top XMSS tree from slh_expand_key
+    uint32_t sig_len;
+} Key;
+
+typedef struct {
+    int fd;
+    uint8_t *in;
+    size_t in_len;
+    size_t in_cap;
+    uint8_t *out;       // response bytes the socket did not take yet
+    size_t out_len;
+    size_t out_cap;
+    bool eof;           // the client sends no more requests
+    bool broken;        // the connection failed, it is dropped
+} Client;
+
+typedef struct {
+    Client *client;
+    uint32_t id;
+    uint8_t op;
+    uint8_t flags;
+    uint16_t key;
+    const uint8_t *ctx;
+    size_t ctx_len;
+    const uint8_t *M;
+    size_t M_len;
+    const uint8_t *SIG;
+    bool done;
+    uint8_t status;
+    uint8_t *body;
+    size_t body_len;
+} Request;
+
+static Key *keys;
+static uint32_t key_count;
+static Pool *pool;
+static size_t first_client;     // the client a batch takes requests from first, it moves on with every batch
+static volatile sig_atomic_t stop;
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void put_u32(uint8_t *p, uint32_t x)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = x >> (8 * i);
+}
+
+static uint64_t now_us(void)
+{
+    return now_ns() / 1000;
+}
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+// Reads the key of a set:path argument and expands it
+static bool load_key(const char *spec, Key *key)
+{
+    const char *colon = strchr(spec, ':');
+    if (colon == NULL || colon - spec >= (long) sizeof key->name) {
+        printf("Invalid key %s, expected set:path\n", spec);
+        return false;
+    }
+    memset(key, 0, sizeof *key);
+    memcpy(key->name, spec, colon - spec);
+    setup_parameter_set(&key->prm, key->name);
+    if (key->prm.n == 0)
+        return false;
+
+    uint32_t n = key->prm.n;
+    FILE *fp = fopen(colon + 1, "rb");
+    if (fp == NULL || fread(key->SK, 1, 4 * n, fp) != 4 * n) {
+        printf("Error reading the key from %s\n", colon + 1);
+        if (fp != NULL)
+            fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    key->sig_len = slh_signature_length(&key->prm);
+    key->top = malloc(slh_top_tree_size(&key->prm));
+    if (key->top == NULL || !slh_expand_key(&key->prm, pool, key->SK, key->top)) {
+        printf("%s: SK.seed and PK.root do not match\n", colon + 1);
+        return false;
+    }
+    return true;
+}
+
+static int listen_socket(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof addr.sun_path) {
+        printf("Socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // a socket left behind by an earlier run is replaced, any other file is not
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof addr) != 0 || listen(fd, SOMAXCONN) != 0) {
+        printf("Error listening on %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool reserve(uint8_t **buf, size_t *cap, size_t len)
+{
+    if (len <= *cap)
+        return true;
+    size_t new_cap = *cap ? *cap : 4096;
+    while (new_cap < len)
+        new_cap *= 2;
+    uint8_t *p = realloc(*buf, new_cap);
+    if (p == NULL)
+        return false;
+    *buf = p;
+    *cap = new_cap;
+    return true;
+}
+
+// Number of complete requests in the input of c, a malformed length breaks the connection
+static size_t complete_requests(Client *c)
+{
+    size_t count = 0, pos = 0;
+    while (!c->broken && c->in_len - pos >= 4) {
+        uint32_t len = get_u32(c->in + pos);
+        if (len < SLHD_HEADER - 4 || len > SLHD_MAX_REQUEST) {
+            c->broken = true;
+            return 0;
+        }
+        if (c->in_len - pos - 4 < len)
+            break;
+        pos += 4 + (size_t) len;
+        count++;
+    }
+    return count;
+}
+
+// Whether c has enough waiting that it is not read until a batch takes some of it
+static bool client_full(Client *c)
+{
+    return c->in_len >= CLIENT_MAX_INPUT || c->out_len >= CLIENT_MAX_INPUT || complete_requests(c) >= CLIENT_MAX_PENDING;
+}
+
+static void read_client(Client *c)
+{
+    while (!client_full(c)) {
+        size_t room = CLIENT_MAX_INPUT - c->in_len;
+        if (room > 65536)
+            room = 65536;
+        if (!reserve(&c->in, &c->in_cap, c->in_len + room)) {
+            c->broken = true;
+            return;
+        }
+        ssize_t got = read(c->fd, c->in + c->in_len, room);
+        if (got > 0) {
+            c->in_len += got;
+            continue;
+        }
+        if (got == 0)
+            c->eof = true;
+        else if (errno != EAGAIN && errno != EINTR)
+            c->broken = true;
+        if (got == 0 || errno != EINTR)
+            return;
+    }
+}
+
+static void flush_client(Client *c)
+{
+    size_t sent = 0;
+    while (sent < c->out_len) {
+        ssize_t put = write(c->fd, c->out + sent, c->out_len - sent);
+        if (put < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                c->broken = true;
+            break;
+        }
+        sent += put;
+    }
+    memmove(c->out, c->out + sent, c->out_len - sent);
+    c->out_len -= sent;
+}
+
+// Header and body go out in one writev, what the socket does not take waits for POLLOUT
+static void send_response(Client *c, uint32_t id, uint8_t status, const uint8_t *body, size_t body_len)
+{
+    uint8_t header[SLHD_HEADER] = { 0 };
+    put_u32(header, SLHD_HEADER - 4 + body_len);
+    put_u32(header + 4, id);
+    header[8] = status;
+    if (c->broken)
+        return;
+
+    size_t sent = 0;
+    if (c->out_len == 0) {
+        struct iovec iov[2] = { { header, SLHD_HEADER }, { (void *) body, body_len } };
+        ssize_t put;
+        do {
+            put = writev(c->fd, iov, body_len > 0 ? 2 : 1);
+        } while (put < 0 && errno == EINTR);
+        if (put < 0 && errno != EAGAIN) {
+            c->broken = true;
+            return;
+        }
+        sent = put > 0 ? put : 0;
+    }
+
+    size_t total = SLHD_HEADER + body_len;
+    if (sent == total)
+        return;
+    if (!reserve(&c->out, &c->out_cap, c->out_len + total - sent)) {
+        c->broken = true;
+        return;
+    }
+    if (sent < SLHD_HEADER) {
+        memcpy(c->out + c->out_len, header + sent, SLHD_HEADER - sent);
+        c->out_len += SLHD_HEADER - sent;
+        sent = SLHD_HEADER;
+    }
+    memcpy(c->out + c->out_len, body + (sent - SLHD_HEADER), total - sent);
+    c->out_len += total - sent;
+}
+
+// Splits a request into its fields, returns false if it is malformed
+static bool parse_request(Client *c, size_t pos, Request *r)
+{
+    const uint8_t *p = c->in + pos;
+    size_t len = 4 + (size_t) get_u32(p);
+    memset(r, 0, sizeof *r);
+    r->client = c;
+    r->id = get_u32(p + 4);
+    r->op = p[8];
+    r->flags = p[9];
+    r->key = p[10] | p[11] << 8;
+
+    const uint8_t *body = p + SLHD_HEADER;
+    size_t body_len = len - SLHD_HEADER;
+    if (r->key >= key_count) {
+        r->status = SLHD_UNKNOWN_KEY;
+        return true;
+    }
+    Key *key = &keys[r->key];
+
+    switch (r->op) {
+    case SLHD_SIGN:
+    case SLHD_VERIFY:
+        if (body_len < 1 || body_len - 1 < body[0])
+            return false;
+        r->ctx_len = body[0];
+        r->ctx = body + 1;
+        body += 1 + r->ctx_len;
+        body_len -= 1 + r->ctx_len;
+        if (r->op == SLHD_VERIFY) {
+            if (body_len < key->sig_len)
+                return false;
+            r->SIG = body;
+            body += key->sig_len;
+            body_len -= key->sig_len;
+        }
+        r->M = body;
+        r->M_len = body_len;
+        return true;
+    case SLHD_PUBLIC_KEY:
+        return body_len == 0;
+    }
+    return false;
+}
+
+// Requests that run in the same batch: the same operation and parameter set, and for signing the same flags
+static bool same_group(const Request *a, const Request *b)
+{
+    return a->op == b->op && strcmp(keys[a->key].name, keys[b->key].name) == 0
+           && (a->op != SLHD_SIGN || (a->flags & SLHD_RANDOMIZED) == (b->flags & SLHD_RANDOMIZED));
+}
+
+// Answers the open requests of the group of r[first] with SLHD_ERROR, for when its batch cannot be set up
+static void fail_group(Request *r, size_t count, size_t first)
+{
+    for (size_t i = first; i < count; i++) {
+        if (!r[i].done && same_group(&r[i], &r[first])) {
+            r[i].done = true;
+            r[i].status = SLHD_ERROR;
+        }
+    }
+}
+
+// Signs all sign requests that use the parameter set and flags of r[first] in one slh_sign_batch
+static void sign_requests(Request *r, size_t count, size_t first)
+{
+    Key *key = &keys[r[first].key];
+    bool randomized = r[first].flags & SLHD_RANDOMIZED;
+    SignItem *items = malloc(count * sizeof *items);
+    bool *signed_ok = malloc(count * sizeof *signed_ok);
+    Request **owner = malloc(count * sizeof *owner);
+    if (items == NULL || signed_ok == NULL || owner == NULL) {
+        fail_group(r, count, first);
+        free(items);
+        free(signed_ok);
+        free(owner);
+        return;
+    }
+    size_t L = 0;
+
+    for (size_t i = first; i < count; i++) {
+        Key *k = &keys[r[i].key];
+        if (r[i].done || !same_group(&r[i], &r[first]))
+            continue;
+        r[i].done = true;
+        r[i].body = malloc(k->sig_len);
+        r[i].body_len = k->sig_len;
+        if (r[i].body == NULL) {
+            r[i].status = SLHD_ERROR;
+            r[i].body_len = 0;
+            continue;
+        }
+        items[L] = (SignItem) { r[i].M, r[i].M_len, r[i].ctx, r[i].ctx_len, k->SK, r[i].body, k->top };
+        owner[L++] = &r[i];
+    }
+    if (L > 0)
+        slh_sign_batch(&key->prm, pool, items, L, !randomized, signed_ok);
+    // ctx fits by the framing, so a failure means no randomness was available
+    for (size_t i = 0; i < L; i++) {
+        if (!signed_ok[i])
+            owner[i]->status = SLHD_ERROR;
+    }
+    free(items);
+    free(signed_ok);
+    free(owner);
+}
+
+static void verify_requests(Request *r, size_t count, size_t first)
+{
+    Key *key = &keys[r[first].key];
+    VerifyItem *items = malloc(count * sizeof *items);
+    bool *results = malloc(count * sizeof *results);
+    Request **owner = malloc(count * sizeof *owner);
+    if (items == NULL || results == NULL || owner == NULL) {
+        fail_group(r, count, first);
+        free(items);
+        free(results);
+        free(owner);
+        return;
+    }
+    size_t L = 0;
+
+    for (size_t i = first; i < count; i++) {
+        Key *k = &keys[r[i].key];
+        if (r[i].done || !same_group(&r[i], &r[first]))
+            continue;
+        r[i].done = true;
+        // only the result of the batch makes a verification succeed
+        r[i].status = SLHD_INVALID;
+        items[L] = (VerifyItem) { r[i].M, r[i].M_len, r[i].SIG, k->sig_len, r[i].ctx, r[i].ctx_len, k->SK + 2 * k->prm.n };
+        owner[L++] = &r[i];
+    }
+    slh_verify_batch_pool(&key->prm, pool, items, L, results);
+    for (size_t i = 0; i < L; i++)
+        owner[i]->status = results[i] ? SLHD_OK : SLHD_INVALID;
+    free(items);
+    free(results);
+    free(owner);
+}
+
+// Runs every complete request of every client as one batch and answers them in order
+static void run_batch(Client **clients, size_t client_count, size_t pending)
+{
+    Request *r = malloc(pending * sizeof *r);
+    size_t *consumed = calloc(client_count, sizeof *consumed);
+    if (r == NULL || consumed == NULL) {
+        free(r);
+        free(consumed);
+        return;
+    }
+
+    // every client gets its turn to go first, so the batch cap does not always leave out the same ones
+    size_t count = 0;
+    for (size_t j = 0; j < client_count; j++) {
+        size_t c = (first_client + j) % client_count;
+        Client *cl = clients[c];
+        size_t pos = 0, taken = 0;
+        while (!cl->broken && count < pending && taken < CLIENT_MAX_PENDING && cl->in_len - pos >= 4
+               && cl->in_len - pos - 4 >= get_u32(cl->in + pos)) {
+            if (!parse_request(cl, pos, &r[count])) {
+                r[count].done = true;
+                r[count].status = SLHD_BAD_REQUEST;
+            }
+            if (r[count].status != SLHD_OK)
+                r[count].done = true;
+            pos += 4 + (size_t) get_u32(cl->in + pos);
+            count++;
+            taken++;
+        }
+        consumed[c] = pos;
+    }
+    first_client = (first_client + 1) % client_count;
+
+    // verifications first, they are short and nobody should wait for them behind a signature
+    for (size_t i = 0; i < count; i++) {
+        if (!r[i].done && r[i].op == SLHD_VERIFY)
+            verify_requests(r, count, i);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!r[i].done && r[i].op == SLHD_SIGN)
+            sign_requests(r, count, i);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (r[i].op == SLHD_PUBLIC_KEY && r[i].status == SLHD_OK) {
+            Key *k = &keys[r[i].key];
+            uint8_t body[1 + sizeof k->name + 2 * k->prm.n];
+            size_t name_len = strlen(k->name);
+            body[0] = name_len;
+            memcpy(body + 1, k->name, name_len);
+            memcpy(body + 1 + name_len, k->SK + 2 * k->prm.n, 2 * k->prm.n);
+            send_response(r[i].client, r[i].id, SLHD_OK, body, 1 + name_len + 2 * k->prm.n);
+        } else {
+            send_response(r[i].client, r[i].id, r[i].status, r[i].body, r[i].status == SLHD_OK ? r[i].body_len : 0);
+        }
+        free(r[i].body);
+    }
+
+    for (size_t c = 0; c < client_count; c++) {
+        Client *cl = clients[c];
+        memmove(cl->in, cl->in + consumed[c], cl->in_len - consumed[c]);
+        cl->in_len -= consumed[c];
+    }
+    free(r);
+    free(consumed);
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-t threads] [-w wait_us] socket set:keyfile...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t threads = 0;
+    uint64_t wait_us = DEFAULT_WAIT_US;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:w:h")) != -1) {
+        switch (opt) {
+        case 't': threads = atoi(optarg); break;
+        case 'w': wait_us = strtoull(optarg, NULL, 10); break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pool = pool_create(threads);
+    if (pool == NULL) {
+        printf("Error starting the worker threads\n");
+        return EXIT_FAILURE;
+    }
+    key_count = argc - optind - 1;
+    keys = calloc(key_count, sizeof *keys);
+    for (uint32_t i = 0; i < key_count; i++) {
+        if (!load_key(argv[optind + 1 + i], &keys[i]))
+            return EXIT_FAILURE;
+    }
+
+    const char *path = argv[optind];
+    int listener = listen_socket(path);
+    if (listener < 0)
+        return EXIT_FAILURE;
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    printf("slhd: %u key(s), %u workers, listening on %s\n", key_count, pool_size(pool), path);
+    fflush(stdout);
+
+    // enough requests to give every worker a full group of lockstep signatures run without waiting
+    size_t target = (size_t) pool_size(pool) * SHAKE_LANES;
+    Client **clients = NULL;
+    size_t client_count = 0, client_cap = 0;
+    struct pollfd *fds = NULL;
+    uint64_t deadline = 0;
+
+    while (!stop) {
+        size_t polled = client_count;
+        fds = realloc(fds, (polled + 1) * sizeof *fds);
+        fds[0] = (struct pollfd) { listener, POLLIN, 0 };
+        for (size_t c = 0; c < polled; c++)
+            fds[c + 1] = (struct pollfd) { clients[c]->fd, (clients[c]->eof || client_full(clients[c]) ? 0 : POLLIN)
+                                                           | (clients[c]->out_len > 0 ? POLLOUT : 0), 0 };
+
+        struct timespec timeout = { 1, 0 };
+        if (deadline != 0) {
+            uint64_t now = now_us();
+            uint64_t left = deadline > now ? deadline - now : 0;
+            timeout = (struct timespec) { left / 1000000, left % 1000000 * 1000 };
+        }
+        if (ppoll(fds, polled + 1, &timeout, NULL) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                if (client_count == client_cap) {
+                    client_cap = client_cap ? 2 * client_cap : 16;
+                    clients = realloc(clients, client_cap * sizeof *clients);
+                }
+                Client *c = calloc(1, sizeof *c);
+                c->fd = fd;
+                clients[client_count++] = c;
+            }
+        }
+        for (size_t c = 0; c < client_count; c++) {
+            // clients accepted in this round have no poll result yet, reading them just finds nothing
+            short ev = c < polled ? fds[c + 1].revents : POLLIN;
+            if (ev & POLLERR)
+                clients[c]->broken = true;
+            if ((ev & (POLLIN | POLLHUP)) && !clients[c]->eof)
+                read_client(clients[c]);
+            if (ev & POLLOUT)
+                flush_client(clients[c]);
+        }
+
+        size_t pending = 0;
+        for (size_t c = 0; c < client_count; c++) {
+            size_t waiting = complete_requests(clients[c]);
+            pending += waiting < CLIENT_MAX_PENDING ? waiting : CLIENT_MAX_PENDING;
+        }
+        if (pending > BATCH_MAX)
+            pending = BATCH_MAX;
+        if (pending > 0) {
+            uint64_t now = now_us();
+            if (deadline == 0)
+                deadline = now + wait_us;
+            if (pending >= target || now >= deadline) {
+                run_batch(clients, client_count, pending);
+                // requests the caps left out have waited already, they run without another wait
+                deadline = 0;
+                for (size_t c = 0; c < client_count && deadline == 0; c++) {
+                    if (complete_requests(clients[c]) > 0)
+                        deadline = now;
+                }
+            }
+        } else {
+            deadline = 0;
+        }
+
+        // a client that stopped sending goes away once its answers are out
+        size_t kept = 0;
+        for (size_t c = 0; c < client_count; c++) {
+            Client *cl = clients[c];
+            if (cl->broken || (cl->eof && cl->out_len == 0 && complete_requests(cl) == 0)) {
+                close(cl->fd);
+                free(cl->in);
+                free(cl->out);
+                free(cl);
+                continue;
+            }
+            clients[kept++] = cl;
+        }
+        client_count = kept;
+    }
+
+    for (size_t c = 0; c < client_count; c++)
+        close(clients[c]->fd);
+    close(listener);
+    unlink(path);
+    pool_destroy(pool);
+    return EXIT_SUCCESS;
+}
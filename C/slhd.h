@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire protocol of the signing daemon slhd (slhd.c), spoken over a Unix stream socket
+// All integers are little-endian, a connection can send any number of requests without waiting for the answers
+//
+// Request:  length (4) | id (4) | op (1) | flags (1) | key (2) | body
+// Response: length (4) | id (4) | status (1) | 0 (3) | body
+// length counts the bytes after it, id is chosen by the client and copied into the response,
+// key is the position of the key on the daemon's command line, starting at 0
+//
+// SLHD_SIGN        body: ctx_len (1) | ctx | M                   response: SIG
+// SLHD_VERIFY      body: ctx_len (1) | ctx | SIG | M             response: empty, status SLHD_OK or SLHD_INVALID
+// SLHD_PUBLIC_KEY  body: empty                                   response: name_len (1) | parameter set name | PK
+//
+// Signatures are pure SLH-DSA (slh_sign, slh_verify), SIG has the signature length of the key's parameter set
+
+#define SLHD_HEADER 12
+
+// Longest request the daemon accepts, a longer one closes the connection
+#define SLHD_MAX_REQUEST (16 << 20)
+
+enum {
+    SLHD_SIGN       = 1,
+    SLHD_VERIFY     = 2,
+    SLHD_PUBLIC_KEY = 3
+};
+
+// flags
+#define SLHD_RANDOMIZED 0x01    // hedged signing with fresh addrnd, otherwise deterministic
+
+enum {
+    SLHD_OK          = 0,
+    SLHD_INVALID     = 1,       // the signature does not verify
+    SLHD_BAD_REQUEST = 2,
+    SLHD_UNKNOWN_KEY = 3,
+    SLHD_ERROR       = 4        // the daemon ran out of memory, the request may be sent again
+};
@@ -0,0 +1,101 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "params.h"
+#include "stats.h"
+#include "timing.h"
+
+#ifdef SLH_STATS
+
+_Thread_local SlhStats slh_stats;
+
+uint64_t stats_now(void)
+{
+    return now_ns();
+}
+
+void stats_reset(void)
+{
+    memset(&slh_stats, 0, sizeof slh_stats);
+}
+
+void stats_get(SlhStats *stats)
+{
+    *stats = slh_stats;
+}
+
+#else
+
+void stats_reset(void)
+{
+}
+
+void stats_get(SlhStats *stats)
+{
+    memset(stats, 0, sizeof *stats);
+}
+
+#endif
+
+void stats_expected(Parameters *prm, bool sign, SlhStats *min, SlhStats *max)
+{
+    uint64_t fors_leaves = (uint64_t) prm->k << prm->a;
+    uint64_t xmss_leaves = (uint64_t) 1 << prm->h_;
+    uint64_t chain_steps = (uint64_t) prm->len * (prm->w - 1);
+
+    memset(min, 0, sizeof *min);
+    if (sign) {
+        // FORS: every tree but the signed leaf's path is built (algorithm 16), then the root is recomputed (algorithm 17)
+        // hypertree: every tree but the signed leaf's path is built, the WOTS+ public key is recomputed on all but the top layer
+        min->PRF_msg = 1;
+        min->H_msg = 1;
+        min->PRF = fors_leaves + prm->d * xmss_leaves * prm->len;
+        min->F = fors_leaves + prm->d * (xmss_leaves - 1) * chain_steps + (prm->d - 1) * chain_steps;
+        min->H = prm->k * (((uint64_t) 1 << prm->a) - 1) + prm->d * (xmss_leaves - 1 - prm->h_) + (prm->d - 1) * prm->h_;
+        min->Tlen = 1 + prm->d * (xmss_leaves - 1) + (prm->d - 1);
+        *max = *min;
+        // the chains of the top layer's WOTS+ signature
+        max->F += chain_steps;
+    } else {
+        min->H_msg = 1;
+        min->F = prm->k;
+        min->H = prm->k * prm->a + prm->d * prm->h_;
+        min->Tlen = 1 + prm->d;
+        *max = *min;
+        max->F += prm->d * chain_steps;
+    }
+}
+
+static bool check_count(const char *name, uint64_t value, uint64_t min, uint64_t max)
+{
+    if (value >= min && value <= max)
+        return true;
+    if (min == max)
+        printf("%s: %lu calls, expected %lu\n", name, (unsigned long) value, (unsigned long) min);
+    else
+        printf("%s: %lu calls, expected %lu to %lu\n", name, (unsigned long) value, (unsigned long) min, (unsigned long) max);
+    return false;
+}
+
+bool stats_check(Parameters *prm, bool sign, const SlhStats *stats)
+{
+    SlhStats min, max;
+    stats_expected(prm, sign, &min, &max);
+
+    bool ok = true;
+    ok &= check_count("F", stats->F, min.F, max.F);
+    ok &= check_count("H", stats->H, min.H, max.H);
+    ok &= check_count("PRF", stats->PRF, min.PRF, max.PRF);
+    ok &= check_count("Tlen", stats->Tlen, min.Tlen, max.Tlen);
+    ok &= check_count("H_msg", stats->H_msg, min.H_msg, max.H_msg);
+    ok &= check_count("PRF_msg", stats->PRF_msg, min.PRF_msg, max.PRF_msg);
+
+    // a hash family whose primitive is not counted would otherwise pass with zero work
+    uint64_t work = prm->sha2 ? stats->sha256 + stats->sha256_lanes + stats->sha512 : stats->keccak + stats->keccak_x8;
+    if (work == 0) {
+        printf("%s: no %s counted\n", prm->sha2 ? "SHA-2" : "Keccak", prm->sha2 ? "compressions" : "permutations");
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "params.h"
+
+// Hash-call accounting, compiled in only with -DSLH_STATS
+// The counters belong to the calling thread, reset them before an operation and read them after it
+
+// largest d of all parameter sets
+#define STATS_MAX_LAYERS 22
+
+typedef struct {
+    // tweakable hash calls, a multi-buffer call counts once per input
+    uint64_t F;
+    uint64_t H;
+    uint64_t PRF;
+    uint64_t Tlen;
+    uint64_t H_msg;
+    uint64_t PRF_msg;
+
+    // Keccak-p[1600, 24] permutations, one state at a time and 8 states at a time
+    uint64_t keccak;
+    uint64_t keccak_x8;
+
+    // SHA-256 compressions of one block, vector compressions of up to 16 blocks (x16 or x8) and SHA-512 compressions
+    uint64_t sha256;
+    uint64_t sha256_lanes;
+    uint64_t sha512;
+
+    // wall time of the stages of slh_sign and slh_verify in nanoseconds
+    uint64_t ns_PRF_msg;
+    uint64_t ns_H_msg;
+    uint64_t ns_fors_sign;
+    uint64_t ns_fors_pk;
+    uint64_t ns_layer[STATS_MAX_LAYERS];
+} SlhStats;
+
+#ifdef SLH_STATS
+
+extern _Thread_local SlhStats slh_stats;
+
+uint64_t stats_now(void);
+
+#define STATS_ENABLED 1
+#define STATS_COUNT(field, count) (slh_stats.field += (count))
+#define STATS_START(t) uint64_t t = stats_now()
+#define STATS_STOP(t, field) (slh_stats.field += stats_now() - (t))
+
+#else
+
+#define STATS_ENABLED 0
+#define STATS_COUNT(field, count) ((void) 0)
+#define STATS_START(t) ((void) 0)
+#define STATS_STOP(t, field) ((void) 0)
+
+#endif
+
+// Keccak-p permutations of a sponge that absorbs in_len bytes and squeezes out_len bytes
+#define SPONGE_PERMUTATIONS(in_len, rate_bytes, out_len) ((in_len) / (rate_bytes) + 1 + ((out_len) - 1) / (rate_bytes))
+
+// Clears the counters of the calling thread
+void stats_reset(void);
+
+// Copies the counters of the calling thread, they are all zero without SLH_STATS
+void stats_get(SlhStats *stats);
+
+// Lowest and highest hash counts of one slh_sign (sign == true) or slh_verify call
+// Only F depends on the message: the WOTS+ chains that are not recomputed from the signature run as many steps as their digits say
+void stats_expected(Parameters *prm, bool sign, SlhStats *min, SlhStats *max);
+
+// Compares the counts of one slh_sign or slh_verify call with stats_expected and prints every mismatch
+// The permutations or compressions are not predicted, but a call without any fails as well
+bool stats_check(Parameters *prm, bool sign, const SlhStats *stats);
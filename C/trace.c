@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shake.h"
+#include "trace.h"
+
+// File layout: magic, version, parameter set name, record count, then 16 bytes per record, all little-endian
+static const char trace_magic[8] = "SLHTRACE";
+#define TRACE_VERSION 1
+#define RECORD_SIZE 16
+
+typedef struct {
+    TraceRecord *records;
+    size_t count;
+    size_t cap;
+    bool active;
+    // outputs of the last call that produced any
+    const uint8_t *last_out[8];
+    uint32_t last_count;
+    size_t last_len;
+} Trace;
+
+static _Thread_local Trace trace;
+
+#ifdef SLH_TRACE
+
+static bool overlaps_output(const uint8_t *M, size_t M_len)
+{
+    for (uint32_t i = 0; i < trace.last_count; i++) {
+        if (M < trace.last_out[i] + trace.last_len && trace.last_out[i] < M + M_len)
+            return true;
+    }
+    return false;
+}
+
+static void add_record(TraceType type, bool dep, uint32_t lanes, size_t in_len, size_t out_len)
+{
+    TraceRecord r = { type, dep, lanes, in_len, out_len, 1 };
+    if (trace.count > 0) {
+        TraceRecord *last = &trace.records[trace.count - 1];
+        if (last->type == r.type && last->dep == r.dep && last->lanes == r.lanes && last->in_len == r.in_len
+            && last->out_len == r.out_len && last->repeat < UINT32_MAX) {
+            last->repeat++;
+            return;
+        }
+    }
+    if (trace.count == trace.cap) {
+        size_t cap = trace.cap ? 2 * trace.cap : 4096;
+        TraceRecord *records = realloc(trace.records, cap * sizeof *records);
+        if (records == NULL) {
+            // out of memory, the trace ends here
+            trace.active = false;
+            return;
+        }
+        trace.records = records;
+        trace.cap = cap;
+    }
+    trace.records[trace.count++] = r;
+}
+
+void trace_call(TraceType type, size_t in_len, const uint8_t *M, size_t M_len, const uint8_t *out, size_t out_len)
+{
+    if (!trace.active)
+        return;
+    add_record(type, M != NULL && overlaps_output(M, M_len), 1, in_len, out_len);
+    if (out != NULL) {
+        trace.last_out[0] = out;
+        trace.last_count = 1;
+        trace.last_len = out_len;
+    }
+}
+
+void trace_lanes(const Segment *const *M, const size_t *M_count, uint8_t *const *out, size_t out_len, uint32_t lanes)
+{
+    if (!trace.active)
+        return;
+    size_t in_len = 0;
+    bool dep = false;
+    for (uint32_t j = 0; j < lanes; j++) {
+        size_t len = 0;
+        for (size_t i = 0; i < M_count[j]; i++) {
+            len += M[j][i].len;
+            dep |= overlaps_output(M[j][i].data, M[j][i].len);
+        }
+        if (len > in_len)
+            in_len = len;
+    }
+    add_record(TRACE_X8, dep, lanes, in_len, out_len);
+    for (uint32_t j = 0; j < lanes; j++)
+        trace.last_out[j] = out[j];
+    trace.last_count = lanes;
+    trace.last_len = out_len;
+}
+
+#endif
+
+void trace_begin(void)
+{
+    free(trace.records);
+    memset(&trace, 0, sizeof trace);
+    trace.active = true;
+}
+
+TraceRecord *trace_end(size_t *count)
+{
+    TraceRecord *records = trace.records;
+    *count = trace.count;
+    memset(&trace, 0, sizeof trace);
+    return records;
+}
+
+static void put_u32(uint8_t *p, uint32_t x)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = x >> (8 * i);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+bool trace_write(FILE *out, const char *set, const TraceRecord *records, size_t count)
+{
+    uint8_t header[8 + 4 + 32 + 8] = { 0 };
+    memcpy(header, trace_magic, 8);
+    put_u32(header + 8, TRACE_VERSION);
+    strncpy((char *) header + 12, set, 31);
+    put_u32(header + 44, (uint32_t) count);
+    put_u32(header + 48, (uint32_t) ((uint64_t) count >> 32));
+    if (fwrite(header, 1, sizeof header, out) != sizeof header)
+        return false;
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t r[RECORD_SIZE] = { records[i].type, records[i].dep, records[i].lanes, 0 };
+        put_u32(r + 4, records[i].in_len);
+        put_u32(r + 8, records[i].out_len);
+        put_u32(r + 12, records[i].repeat);
+        if (fwrite(r, 1, RECORD_SIZE, out) != RECORD_SIZE)
+            return false;
+    }
+    return true;
+}
+
+TraceRecord *trace_read(FILE *in, char set[32], size_t *count)
+{
+    uint8_t header[8 + 4 + 32 + 8];
+    if (fread(header, 1, sizeof header, in) != sizeof header || memcmp(header, trace_magic, 8) != 0
+        || get_u32(header + 8) != TRACE_VERSION)
+        return NULL;
+    memcpy(set, header + 12, 32);
+    set[31] = 0;
+    *count = get_u32(header + 44) | (size_t) get_u32(header + 48) << 32;
+
+    TraceRecord *records = malloc((*count + 1) * sizeof *records);
+    if (records == NULL)
+        return NULL;
+    for (size_t i = 0; i < *count; i++) {
+        uint8_t r[RECORD_SIZE];
+        if (fread(r, 1, RECORD_SIZE, in) != RECORD_SIZE || r[0] >= TRACE_TYPES || r[2] == 0 || r[2] > 8) {
+            free(records);
+            return NULL;
+        }
+        records[i] = (TraceRecord) { r[0], r[1], r[2], get_u32(r + 4), get_u32(r + 8), get_u32(r + 12) };
+    }
+    return records;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "shake.h"
+
+// Hash-call tracing, compiled in only with -DSLH_TRACE
+// Records the SHAKE256 calls of the calling thread between trace_begin and trace_end, see replay.c
+
+typedef enum {
+    TRACE_F,
+    TRACE_H,
+    TRACE_PRF,
+    TRACE_TLEN,
+    TRACE_SHAKE,        // one-shot SHAKE_256, used for pre-hashing
+    TRACE_INIT,         // incremental SHAKE_256_init, H_msg and PRF_msg
+    TRACE_ABSORB,       // SHAKE_256_update
+    TRACE_SQUEEZE,      // SHAKE_256_final
+    TRACE_X8,           // SHAKE_256_x8
+    TRACE_TYPES
+} TraceType;
+
+// Identical calls in a row are stored once with a repeat count
+// in_len is the number of bytes the sponge absorbs, for TRACE_X8 the longest of the lanes
+// dep is set if the input contains the output of the previous call, like the steps of a WOTS+ chain
+typedef struct {
+    uint8_t type;
+    uint8_t dep;
+    uint8_t lanes;
+    uint32_t in_len;
+    uint32_t out_len;
+    uint32_t repeat;
+} TraceRecord;
+
+#ifdef SLH_TRACE
+
+#define TRACE_ENABLED 1
+#define TRACE_CALL(type, in_len, M, M_len, out, out_len) trace_call(type, in_len, M, M_len, out, out_len)
+#define TRACE_LANES(M, M_count, out, out_len, lanes) trace_lanes(M, M_count, out, out_len, lanes)
+
+void trace_call(TraceType type, size_t in_len, const uint8_t *M, size_t M_len, const uint8_t *out, size_t out_len);
+
+void trace_lanes(const Segment *const *M, const size_t *M_count, uint8_t *const *out, size_t out_len, uint32_t lanes);
+
+#else
+
+#define TRACE_ENABLED 0
+#define TRACE_CALL(type, in_len, M, M_len, out, out_len) ((void) 0)
+#define TRACE_LANES(M, M_count, out, out_len, lanes) ((void) 0)
+
+#endif
+
+// Starts recording the calls of the calling thread, an earlier unfinished trace is dropped
+void trace_begin(void);
+
+// Stops recording and returns the records, the caller frees them
+// Without SLH_TRACE, no calls are recorded
+TraceRecord *trace_end(size_t *count);
+
+// Writes a trace file, set is the name of the parameter set
+// Returns false if writing failed
+bool trace_write(FILE *out, const char *set, const TraceRecord *records, size_t count);
+
+// Reads a trace file written by trace_write, set receives the name of the parameter set
+// Returns NULL if the file is no trace
+TraceRecord *trace_read(FILE *in, char set[32], size_t *count);
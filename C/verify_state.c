@@ -0,0 +1,134 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "adrs.h"
+#include "fors.h"
+#include "internal.h"
+#include "params.h"
+#include "shake.h"
+#include "verify_state.h"
+#include "xmss.h"
+
+// Length of part p of the signature: R, k FORS trees, d XMSS signatures, 0 after the end
+static size_t part_length(Parameters *prm, uint32_t p)
+{
+    if (p == 0)
+        return prm->n;
+    if (p <= prm->k)
+        return (1 + prm->a) * prm->n;
+    if (p <= prm->k + prm->d)
+        return (prm->len + prm->h_) * prm->n;
+    return 0;
+}
+
+bool slh_verify_init(Parameters *prm, VerifyState *st, const uint8_t *ctx, size_t ctx_len, const uint8_t *PK)
+{
+    memset(st, 0, sizeof *st);
+    if (ctx_len > MAX_CTX_LENGTH) {
+        printf("Invalid context length\n");
+        st->failed = true;
+        return false;
+    }
+    st->prm = prm;
+    st->PK = PK;
+    memcpy(st->ctx, ctx, ctx_len);
+    st->ctx_len = ctx_len;
+    st->part_len = part_length(prm, 0);
+    return true;
+}
+
+// algorithm 20, lines 9 to 14 and 16 to 18 for the part that has just been completed
+static void process_part(VerifyState *st)
+{
+    Parameters *prm = st->prm;
+    const uint8_t *pk_seed = st->PK;
+    uint32_t p = st->part;
+
+    if (p == 0) {
+        // M' = 0x00 || len(ctx) || ctx || M follows R, PK.seed and PK.root in H_msg
+        uint8_t prefix[2] = { 0, st->ctx_len };
+        H_msg_init(prm, &st->msg, st->buffer, pk_seed, st->PK + prm->n);
+        H_msg_update(prm, &st->msg, prefix, sizeof prefix);
+        H_msg_update(prm, &st->msg, st->ctx, st->ctx_len);
+        return;
+    }
+
+    ADRS adrs;
+    initADRS(&adrs);
+    if (p <= prm->k) {
+        setTreeAddress(&adrs, st->idx_tree);
+        setTypeAndClear(&adrs, prm->FORS_TREE);
+        setKeyPairAddress(&adrs, st->idx_leaf);
+        fors_rootFromSig(prm, st->buffer, p - 1, st->digest, pk_seed, adrs, st->roots + (p - 1) * prm->n);
+        if (p == prm->k) {
+            setTypeAndClear(&adrs, prm->FORS_ROOTS);
+            setKeyPairAddress(&adrs, st->idx_leaf);
+            Tlen(prm, pk_seed, &adrs, st->roots, prm->k * prm->n, st->node);
+        }
+        return;
+    }
+
+    // layer j, idx_tree and idx_leaf move up one layer after each
+    uint32_t j = p - 1 - prm->k;
+    setLayerAddress(&adrs, j);
+    setTreeAddress(&adrs, st->idx_tree);
+    xmss_pkFromSig(prm, st->idx_leaf, st->buffer, st->node, pk_seed, adrs, st->node);
+    st->idx_leaf = st->idx_tree & ((1 << prm->h_) - 1);
+    st->idx_tree = st->idx_tree >> prm->h_;
+}
+
+bool slh_verify_signature(VerifyState *st, const uint8_t *data, size_t len)
+{
+    while (len > 0 && !st->failed) {
+        // the parts after R need the digest
+        if (st->part_len == 0 || (st->part > 0 && !st->message_done)) {
+            st->failed = true;
+            break;
+        }
+        size_t take = st->part_len - st->part_fill < len ? st->part_len - st->part_fill : len;
+        memcpy(st->buffer + st->part_fill, data, take);
+        st->part_fill += take;
+        data += take;
+        len -= take;
+
+        if (st->part_fill == st->part_len) {
+            process_part(st);
+            st->part++;
+            st->part_len = part_length(st->prm, st->part);
+            st->part_fill = 0;
+        }
+    }
+    return !st->failed;
+}
+
+bool slh_verify_message(VerifyState *st, const uint8_t *M, size_t M_len)
+{
+    if (st->part == 0 || st->message_done)
+        st->failed = true;
+    if (!st->failed)
+        H_msg_update(st->prm, &st->msg, M, M_len);
+    return !st->failed;
+}
+
+bool slh_verify_message_end(VerifyState *st)
+{
+    Parameters *prm = st->prm;
+    if (st->part == 0 || st->message_done)
+        st->failed = true;
+    if (st->failed)
+        return false;
+
+    H_msg_final(prm, &st->msg, st->digest);
+    split_digest(prm, st->digest, NULL, &st->idx_tree, &st->idx_leaf);
+    st->message_done = true;
+    return true;
+}
+
+bool slh_verify_final(VerifyState *st)
+{
+    Parameters *prm = st->prm;
+    if (st->failed || st->part != 1 + prm->k + prm->d)
+        return false;
+    return memcmp(st->node, st->PK + prm->n, prm->n) == 0;
+}
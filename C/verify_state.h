@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "external.h"
+#include "params.h"
+#include "shake.h"
+#include "sign_state.h"
+
+// Incremental pure SLH-DSA verification (algorithm 24) in constant memory
+// H_msg hashes R before the message, so R (the first n bytes of the signature) has to come first:
+//   slh_verify_signature(R), slh_verify_message(M) any number of times, slh_verify_message_end,
+//   slh_verify_signature(rest of SIG) in chunks of any size, slh_verify_final
+// Each FORS tree and each XMSS layer is checked as soon as its last byte arrives, only the current part is buffered.
+// The state holds a Keccak state with 64-byte alignment, allocate it with aligned_alloc when it is not on the stack.
+typedef struct {
+    Parameters *prm;
+    const uint8_t *PK;
+    uint8_t ctx[MAX_CTX_LENGTH];
+    size_t ctx_len;
+    bool failed;                // bytes came in the wrong order or beyond the signature length
+
+    MsgCtx msg;
+    bool message_done;
+    uint8_t digest[SIGN_STATE_MAX_M];
+    uint64_t idx_tree;
+    uint64_t idx_leaf;
+
+    uint32_t part;              // R, then the FORS trees, then the layers
+    size_t part_len;
+    size_t part_fill;
+    uint8_t buffer[SIGN_STATE_MAX_PART];
+    uint8_t roots[SIGN_STATE_MAX_K * SIGN_STATE_MAX_N];
+    uint8_t node[SIGN_STATE_MAX_N];     // FORS public key, then the root of the last layer
+} VerifyState;
+
+// Starts verifying a signature of a message with context ctx under PK, PK must stay valid until slh_verify_final
+// Returns false if ctx is too long
+bool slh_verify_init(Parameters *prm, VerifyState *st, const uint8_t *ctx, size_t ctx_len, const uint8_t *PK);
+
+// Feeds the next len bytes of the signature, returns false once the verification has failed because of the order or length
+bool slh_verify_signature(VerifyState *st, const uint8_t *data, size_t len);
+
+// Feeds the next bytes of the message, allowed after R and before slh_verify_message_end
+bool slh_verify_message(VerifyState *st, const uint8_t *M, size_t M_len);
+
+bool slh_verify_message_end(VerifyState *st);
+
+// Returns true if all of the signature arrived and it is valid
+bool slh_verify_final(VerifyState *st);
@@ -1,121 +1,157 @@
-#include <string.h>
-#include "params.h"
-#include "shake.h"
-#include "wots.h"
-
-// Algorithm 4 (Computes the base 2^b representation of X)
-void base_2b(const uint8_t *X, uint64_t b, uint32_t out_len, uint32_t *baseb)
-{
-    uint64_t in_index = 0;                           // Equivalent to `in` in pseudocode
-    uint64_t bits = 0;                               // Number of bits currently in `total`
-    uint64_t total = 0;               // Accumulates the bit representation
-
-    for (uint32_t out = 0; out < out_len; out++) {
-        while (bits < b) {                      // Fill `total` with bits until it has at least `b` bits
-            total = (total << 8) + X[in_index]; // Add 8 bits from X[in_index]
-            in_index += 1;
-            bits += 8;
-        }
-
-        baseb[out] = (total >> (bits - b)) & ((1ULL << b) - 1); // Extract the `b` least significant bits
-        bits -= b;                              // Reduce `bits` by `b` as we've used them
-    }
-}
-
-// Algorithm 5 (Chaining function used in WOTS+)
-void chain(Parameters *prm, const uint8_t *X, uint64_t i, uint64_t s, const uint8_t *PK_seed, ADRS *adrs, uint8_t *buffer)
-{
-    uint8_t tmp[prm->n];
-    memcpy(tmp, X, prm->n);
-
-    for (uint32_t j = i; j < i + s; j++) {
-        setHashAddress(adrs, j);
-        F(prm, PK_seed, adrs, tmp, tmp);
-    }
-    memcpy(buffer, tmp, prm->n);
-}
-
-// Algorithm 6 (Generates a WOTS+ public key)
-void wots_pkGen(Parameters *prm, const uint8_t *SK_seed, const uint8_t *PK_seed, ADRS adrs, uint8_t *pk)
-{
-    ADRS skADRS;
-    skADRS = adrs;
-    setTypeAndClear(&skADRS, prm->WOTS_PRF);
-    setKeyPairAddress(&skADRS, getKeyPairAddress(&adrs));
-
-    uint8_t sk[prm->n];
-    uint8_t tmp[prm->len * prm->n];
-    for (uint32_t i = 0; i < prm->len; i++) {
-        setChainAddress(&skADRS, i);
-        PRF(prm, PK_seed, &skADRS, SK_seed, sk);
-        setChainAddress(&adrs, i);
-        chain(prm, sk, 0, prm->w - 1, PK_seed, &adrs, tmp + i * prm->n);
-    }
-
-    ADRS wotspkADRS;
-    wotspkADRS = adrs;
-    setTypeAndClear(&wotspkADRS, prm->WOTS_PK);
-    setKeyPairAddress(&wotspkADRS, getKeyPairAddress(&adrs));
-    Tlen(prm, PK_seed, &wotspkADRS, tmp, prm->len * prm->n, pk);
-}
-
-// Algorithm 7 (Generates a WOTS+ signature on an n-byte message)
-void wots_sign(Parameters *prm, const uint8_t *M, const uint8_t *SK_seed, const uint8_t *PK_seed, ADRS adrs, uint8_t *sig) {
-    uint64_t csum = 0;
-    uint32_t msg[prm->len];
-
-    base_2b(M, prm->lg_w, prm->len1, msg);       // Convert message to base w
-    for (uint32_t i = 0; i < prm->len1; i++) {
-        csum += prm->w - 1 - msg[i];            // Compute checksum
-    }
-
-    csum <<= 4;
-
-    // csum_bytes has length ceil((prm->len2 * prm->lg_w) / 8.0), which is always 2
-    // since len2 and lg_w are static across all parameter sets
-    uint8_t csum_bytes[2];
-    toByte(csum, 2, csum_bytes);
-    base_2b(csum_bytes, prm->lg_w, prm->len2, msg + prm->len1); // Convert to base w
-
-    ADRS skADRS;
-    skADRS = adrs;
-    setTypeAndClear(&skADRS, prm->WOTS_PRF);
-    setKeyPairAddress(&skADRS, getKeyPairAddress(&adrs));
-
-    uint8_t sk[prm->n];
-    for (uint32_t i = 0; i < prm->len; i++) {
-        setChainAddress(&skADRS, i);
-        PRF(prm, PK_seed, &skADRS, SK_seed, sk);
-        setChainAddress(&adrs, i);
-        chain(prm, sk, 0, msg[i], PK_seed, &adrs, sig + i * prm->n);
-    }
-}
-
-// Algorithm 8 (Computes a WOTS+ public key from a message and its signature)
-void wots_pkFromSig(Parameters *prm, uint8_t *sig, const uint8_t *M, const uint8_t *PK_seed, ADRS adrs, uint8_t *pksig) {
-    uint64_t csum = 0;
-    uint32_t msg[prm->len];
-
-    base_2b(M, prm->lg_w, prm->len1, msg);       // Convert message to base w
-    for (uint32_t i = 0; i < prm->len1; i++) {
-        csum += prm->w - 1 - msg[i];            // Compute checksum
-    }
-
-    csum <<= 4;
-    uint8_t csum_bytes[2];
-    toByte(csum, 2, csum_bytes);
-    base_2b(csum_bytes, prm->lg_w, prm->len2, msg + prm->len1); // Convert to base w
-
-    uint8_t tmp[prm->len * prm->n];
-    for (uint32_t i = 0; i < prm->len; i++) {
-        setChainAddress(&adrs, i);
-        chain(prm, sig + i * prm->n, msg[i], prm->w - 1 - msg[i], PK_seed, &adrs, tmp + i * prm->n);
-    }
-
-    ADRS wotspkADRS;
-    wotspkADRS = adrs;
-    setTypeAndClear(&wotspkADRS, prm->WOTS_PK);
-    setKeyPairAddress(&wotspkADRS, getKeyPairAddress(&adrs));
-
-    Tlen(prm, PK_seed, &wotspkADRS, tmp, prm->len * prm->n, pksig);
-}
+#include <string.h>
+#include "params.h"
+#include "shake.h"
+#include "wots.h"
+
+// Algorithm 4 (Computes the base 2^b representation of X)
+void base_2b(const uint8_t *X, uint64_t b, uint32_t out_len, uint32_t *baseb)
+{
+    uint64_t in_index = 0;                           // Equivalent to `in` in pseudocode
+    uint64_t bits = 0;                               // Number of bits currently in `total`
+    uint64_t total = 0;               // Accumulates the bit representation
+
+    for (uint32_t out = 0; out < out_len; out++) {
+        while (bits < b) {                      // Fill `total` with bits until it has at least `b` bits
+            total = (total << 8) + X[in_index]; // Add 8 bits from X[in_index]
+            in_index += 1;
+            bits += 8;
+        }
+
+        baseb[out] = (total >> (bits - b)) & ((1ULL << b) - 1); // Extract the `b` least significant bits
+        bits -= b;                              // Reduce `bits` by `b` as we've used them
+    }
+}
+
+// Algorithm 5 (Chaining function used in WOTS+)
+void chain(Parameters *prm, const uint8_t *X, uint64_t i, uint64_t s, const uint8_t *PK_seed, ADRS *adrs, uint8_t *buffer)
+{
+    uint8_t tmp[prm->n];
+    memcpy(tmp, X, prm->n);
+
+    for (uint32_t j = i; j < i + s; j++) {
+        setHashAddress(adrs, j);
+        F(prm, PK_seed, adrs, tmp, tmp);
+    }
+    memcpy(buffer, tmp, prm->n);
+}
+
+// Algorithm 5 for all len chains of a WOTS+ key, chain c runs s[c] steps starting at index i[c] from X + c * n
+// Each step hashes all chains that are not finished yet with one call to F_lanes
+void chains(Parameters *prm, const uint8_t *X, const uint32_t *i, const uint32_t *s, const uint8_t *PK_seed, ADRS adrs, uint8_t *buffer)
+{
+    ADRS lane_adrs[prm->len];
+    uint32_t order[prm->len];
+    uint8_t tmp[prm->len * prm->n];
+
+    // sort the chains by descending number of steps, so the unfinished ones are always a prefix
+    uint32_t count = 0;
+    for (int64_t steps = prm->w - 1; steps >= 0; steps--) {
+        for (uint32_t c = 0; c < prm->len; c++) {
+            if (s[c] == steps) {
+                lane_adrs[count] = adrs;
+                setChainAddress(&lane_adrs[count], c);
+                memcpy(tmp + count * prm->n, X + c * prm->n, prm->n);
+                order[count++] = c;
+            }
+        }
+    }
+
+    for (uint32_t j = 0; j < prm->w - 1; j++) {
+        while (count > 0 && s[order[count - 1]] <= j)
+            count--;
+        if (count == 0)
+            break;
+
+        for (uint32_t k = 0; k < count; k++)
+            setHashAddress(&lane_adrs[k], i[order[k]] + j);
+        F_lanes(prm, PK_seed, lane_adrs, tmp, tmp, count);
+    }
+
+    for (uint32_t k = 0; k < prm->len; k++)
+        memcpy(buffer + order[k] * prm->n, tmp + k * prm->n, prm->n);
+}
+
+// Secret start values of all chains of a WOTS+ key
+static void wots_skGen(Parameters *prm, const uint8_t *SK_seed, const uint8_t *PK_seed, ADRS adrs, uint8_t *sk)
+{
+    ADRS skADRS[prm->len];
+    for (uint32_t i = 0; i < prm->len; i++) {
+        skADRS[i] = adrs;
+        setTypeAndClear(&skADRS[i], prm->WOTS_PRF);
+        setKeyPairAddress(&skADRS[i], getKeyPairAddress(&adrs));
+        setChainAddress(&skADRS[i], i);
+    }
+    PRF_lanes(prm, PK_seed, skADRS, SK_seed, sk, prm->len);
+}
+
+// Algorithm 6 (Generates a WOTS+ public key)
+void wots_pkGen(Parameters *prm, const uint8_t *SK_seed, const uint8_t *PK_seed, ADRS adrs, uint8_t *pk)
+{
+    uint32_t start[prm->len];
+    uint32_t steps[prm->len];
+    for (uint32_t i = 0; i < prm->len; i++) {
+        start[i] = 0;
+        steps[i] = prm->w - 1;
+    }
+
+    uint8_t tmp[prm->len * prm->n];
+    wots_skGen(prm, SK_seed, PK_seed, adrs, tmp);
+    chains(prm, tmp, start, steps, PK_seed, adrs, tmp);
+
+    ADRS wotspkADRS;
+    wotspkADRS = adrs;
+    setTypeAndClear(&wotspkADRS, prm->WOTS_PK);
+    setKeyPairAddress(&wotspkADRS, getKeyPairAddress(&adrs));
+    Tlen(prm, PK_seed, &wotspkADRS, tmp, prm->len * prm->n, pk);
+}
+
+// Algorithm 7, lines 2 to 9 (Converts M to base w and appends the checksum digits)
+void wots_digits(Parameters *prm, const uint8_t *M, uint32_t *msg)
+{
+    uint64_t csum = 0;
+
+    base_2b(M, prm->lg_w, prm->len1, msg);       // Convert message to base w
+    for (uint32_t i = 0; i < prm->len1; i++) {
+        csum += prm->w - 1 - msg[i];            // Compute checksum
+    }
+
+    csum <<= 4;
+
+    // csum_bytes has length ceil((prm->len2 * prm->lg_w) / 8.0), which is always 2
+    // since len2 and lg_w are static across all parameter sets
+    uint8_t csum_bytes[2];
+    toByte(csum, 2, csum_bytes);
+    base_2b(csum_bytes, prm->lg_w, prm->len2, msg + prm->len1); // Convert to base w
+}
+
+// Algorithm 7 (Generates a WOTS+ signature on an n-byte message)
+void wots_sign(Parameters *prm, const uint8_t *M, const uint8_t *SK_seed, const uint8_t *PK_seed, ADRS adrs, uint8_t *sig) {
+    uint32_t msg[prm->len];
+    wots_digits(prm, M, msg);
+
+    uint32_t start[prm->len];
+    memset(start, 0, sizeof start);
+
+    wots_skGen(prm, SK_seed, PK_seed, adrs, sig);
+    chains(prm, sig, start, msg, PK_seed, adrs, sig);
+}
+
+// Algorithm 8 (Computes a WOTS+ public key from a message and its signature)
+void wots_pkFromSig(Parameters *prm, uint8_t *sig, const uint8_t *M, const uint8_t *PK_seed, ADRS adrs, uint8_t *pksig) {
+    uint32_t msg[prm->len];
+    wots_digits(prm, M, msg);
+
+    uint32_t steps[prm->len];
+    for (uint32_t i = 0; i < prm->len; i++)
+        steps[i] = prm->w - 1 - msg[i];
+
+    uint8_t tmp[prm->len * prm->n];
+    chains(prm, sig, msg, steps, PK_seed, adrs, tmp);
+
+    ADRS wotspkADRS;
+    wotspkADRS = adrs;
+    setTypeAndClear(&wotspkADRS, prm->WOTS_PK);
+    setKeyPairAddress(&wotspkADRS, getKeyPairAddress(&adrs));
+
+    Tlen(prm, PK_seed, &wotspkADRS, tmp, prm->len * prm->n, pksig);
+}
@@ -1,129 +1,120 @@
-import secrets
-import hashlib
-
-import params
-from adrs import toByte
-from internal import slh_keygen_internal, slh_sign_internal, slh_verify_internal
-
-# Algorithmus 21 (Generates an SLH-DSA key pair)
-def slh_keygen(SK_seed: bytes = b"", SK_prf: bytes = b"", PK_seed: bytes = b"") -> tuple:
-
-    # Generate random seeds
-    if not SK_seed:
-        SK_seed = secrets.token_bytes(params.prm.n)
-    if not SK_prf:
-        SK_prf = secrets.token_bytes(params.prm.n)
-    if not PK_seed:
-        PK_seed = secrets.token_bytes(params.prm.n)
-
-    # Check for errors
-    if not SK_seed or not SK_prf or not PK_seed:
-        return None, None
-
-    # Call the internal key generation function
-    return slh_keygen_internal(SK_seed, SK_prf, PK_seed)    # Output: SLH-DSA key pair (SK, PK)
-
-
-# Algorithmus 22 (Generates a pure SLH-DSA signature)
-def slh_sign(M: bytes, ctx: bytes, SK: bytes, deterministic: bool = True) -> bytes:
-
-    if len(ctx) > 255:
-        print("invalid conext length")
-        return b""
-
-    # for deterministic variant, use PK_seed for addrnd
-    if deterministic:
-        addrnd = SK[2 * params.prm.n:3 * params.prm.n]
-    else:
-        addrnd = secrets.token_bytes(params.prm.n)
-        if addrnd is None:
-            return b""
-
-    M_prime = toByte(0, 1) + toByte(len(ctx), 1)
-    M_prime = bytearray(M_prime) + ctx + M
-
-    return slh_sign_internal(M_prime, SK, addrnd)
-
-
-# Algorithmus 23 (Generates a pre-hash SLH-DSA signature)
-def hash_slh_sign(M: bytes, ctx: list, PH: str, SK: bytes, deterministic: bool = True) -> bytes:
-
-    if len(ctx) > 255:
-        return b""
-
-    if deterministic:
-        addrnd = SK[2 * params.prm.n:3 * params.prm.n]
-    else:
-        addrnd = secrets.token_bytes(params.prm.n)  # Skip for deterministic variant
-        if addrnd is None:
-            return b""
-
-    # NOTE we initialize PHM as an array with 64 bytes
-    PHM = bytearray([0] * 64)
-
-    # Pre-hash the message
-    match PH:
-        case "SHA-256":
-            OID = toByte(0x0609608648016503040201, 11)
-            PHM[0:32] = hashlib.sha256(M).digest()
-        case "SHA-512":
-            OID = toByte(0x0609608648016503040203, 11)
-            PHM[0:64] = hashlib.sha512(M).digest()
-        case "SHAKE128":
-            OID = toByte(0x060960864801650304020B, 11)
-            PHM[0:32] = hashlib.shake_128(M).digest(32)
-        case "SHAKE256":
-            OID = toByte(0x060960864801650304020C, 11)
-            PHM[0:64] = hashlib.shake_256(M).digest(64)
-        case _:
-            # Handle other approved hash functions or XOFs
-            raise NotImplementedError("Unsupported pre-hash function")
-
-    # Construct the M' message
-    M_prime = toByte(1, 1) + toByte(len(ctx), 1) + ctx + OID
-    M_prime = bytearray(M_prime) + PHM
-
-    return slh_sign_internal(M_prime, SK, addrnd)  # Omit addrnd for deterministic variant
-
-
-# Algorithmus 24 (Verifies a pure SLH-DSA signature)
-def slh_verify(M: bytes, ctx: bytes, SIG: bytes, PK: bytes) -> bool:
-    if len(ctx) > 255:
-        print("invalid context length")
-        return False
-
-    M_prime = toByte(0, 1) + toByte(len(ctx), 1)
-    M_prime = bytearray(M_prime) + ctx + M
-    return slh_verify_internal(M_prime, SIG, PK)
-
-
-# Algorithmus 25 (Verifies a pre-hash SLH-DSA signature)
-def hash_slh_verify(M: bytes, SIG: bytes, ctx: list, PH: str, PK: bytes) -> bool:   # Input: Message 𝑀, signature SIG, context string 𝑐𝑡𝑥, pre-hash function PH, public key PK
-
-    if len(ctx) > 255:
-        return False
-
-    PHM = bytearray([0] * 64)
-    # Pre-hash the message
-    match PH:
-        case "SHA-256":
-            OID = toByte(0x0609608648016503040201, 11)
-            PHM[0:32] = hashlib.sha256(M).digest()
-        case "SHA-512":
-            OID = toByte(0x0609608648016503040203, 11)
-            PHM[0:64] = hashlib.sha512(M).digest()
-        case "SHAKE128":
-            OID = toByte(0x060960864801650304020B, 11)
-            PHM[0:32] = hashlib.shake_128(M).digest(32)
-        case "SHAKE256":
-            OID = toByte(0x060960864801650304020C, 11)
-            PHM[0:64] = hashlib.shake_256(M).digest(64)
-        case _:
-            # Handle other approved hash functions or XOFs
-            raise NotImplementedError("Unsupported pre-hash function")
-
-    # Construct the M' message
-    M_prime = toByte(1, 1) + toByte(len(ctx), 1) + ctx + OID
-    M_prime = bytearray(M_prime) + PHM
-
-    return slh_verify_internal(M_prime, SIG, PK)
+import secrets
+import hashlib
+
+import params
+from adrs import toByte
+from internal import slh_keygen_internal, slh_sign_internal, slh_verify_internal
+
+# Algorithmus 21 (Generates an SLH-DSA key pair)
+def slh_keygen(SK_seed: bytes = b"", SK_prf: bytes = b"", PK_seed: bytes = b"") -> tuple:
+
+    # Generate random seeds
+    if not SK_seed:
+        SK_seed = secrets.token_bytes(params.prm.n)
+    if not SK_prf:
+        SK_prf = secrets.token_bytes(params.prm.n)
+    if not PK_seed:
+        PK_seed = secrets.token_bytes(params.prm.n)
+
+    # Check for errors
+    if not SK_seed or not SK_prf or not PK_seed:
+        return None, None
+
+    # Call the internal key generation function
+    return slh_keygen_internal(SK_seed, SK_prf, PK_seed)    # Output: SLH-DSA key pair (SK, PK)
+
+
+# Algorithmus 22 (Generates a pure SLH-DSA signature)
+def slh_sign(M: bytes, ctx: bytes, SK: bytes, deterministic: bool = True) -> bytes:
+
+    if len(ctx) > 255:
+        print("invalid conext length")
+        return b""
+
+    # for deterministic variant, use PK_seed for addrnd
+    if deterministic:
+        addrnd = SK[2 * params.prm.n:3 * params.prm.n]
+    else:
+        addrnd = secrets.token_bytes(params.prm.n)
+        if addrnd is None:
+            return b""
+
+    M_prime = toByte(0, 1) + toByte(len(ctx), 1)
+    M_prime = bytearray(M_prime) + ctx + M
+
+    return slh_sign_internal(M_prime, SK, addrnd)
+
+
+# Approved pre-hash functions, mapped to the last arc of their OID 2.16.840.1.101.3.4.2.x
+PREHASH = {
+    "SHA-256":     (0x01, lambda M: hashlib.sha256(M).digest()),
+    "SHA-384":     (0x02, lambda M: hashlib.sha384(M).digest()),
+    "SHA-512":     (0x03, lambda M: hashlib.sha512(M).digest()),
+    "SHA-224":     (0x04, lambda M: hashlib.sha224(M).digest()),
+    "SHA-512/224": (0x05, lambda M: hashlib.new("sha512_224", M).digest()),
+    "SHA-512/256": (0x06, lambda M: hashlib.new("sha512_256", M).digest()),
+    "SHA3-224":    (0x07, lambda M: hashlib.sha3_224(M).digest()),
+    "SHA3-256":    (0x08, lambda M: hashlib.sha3_256(M).digest()),
+    "SHA3-384":    (0x09, lambda M: hashlib.sha3_384(M).digest()),
+    "SHA3-512":    (0x0A, lambda M: hashlib.sha3_512(M).digest()),
+    "SHAKE128":    (0x0B, lambda M: hashlib.shake_128(M).digest(32)),
+    "SHAKE256":    (0x0C, lambda M: hashlib.shake_256(M).digest(64)),
+}
+
+
+# Computes the OID of PH and PH(M)
+def prehash(PH: str, M: bytes) -> tuple:
+    if PH not in PREHASH:
+        raise NotImplementedError("Unsupported pre-hash function")
+    oid, func = PREHASH[PH]
+    return toByte(0x0609608648016503040200 + oid, 11), func(M)
+
+
+# Algorithmus 23 (Generates a pre-hash SLH-DSA signature)
+def hash_slh_sign(M: bytes, ctx: list, PH: str, SK: bytes, deterministic: bool = True) -> bytes:
+
+    if len(ctx) > 255:
+        return b""
+
+    if deterministic:
+        addrnd = SK[2 * params.prm.n:3 * params.prm.n]
+    else:
+        addrnd = secrets.token_bytes(params.prm.n)  # Skip for deterministic variant
+        if addrnd is None:
+            return b""
+
+    # Pre-hash the message
+    OID, PHM = prehash(PH, M)
+
+    # Construct the M' message
+    M_prime = toByte(1, 1) + toByte(len(ctx), 1) + ctx + OID
+    M_prime = bytearray(M_prime) + PHM
+
+    return slh_sign_internal(M_prime, SK, addrnd)  # Omit addrnd for deterministic variant
+
+
+# Algorithmus 24 (Verifies a pure SLH-DSA signature)
+def slh_verify(M: bytes, ctx: bytes, SIG: bytes, PK: bytes) -> bool:
+    if len(ctx) > 255:
+        print("invalid context length")
+        return False
+
+    M_prime = toByte(0, 1) + toByte(len(ctx), 1)
+    M_prime = bytearray(M_prime) + ctx + M
+    return slh_verify_internal(M_prime, SIG, PK)
+
+
+# Algorithmus 25 (Verifies a pre-hash SLH-DSA signature)
+def hash_slh_verify(M: bytes, SIG: bytes, ctx: list, PH: str, PK: bytes) -> bool:   # Input: Message 𝑀, signature SIG, context string 𝑐𝑡𝑥, pre-hash function PH, public key PK
+
+    if len(ctx) > 255:
+        return False
+
+    # Pre-hash the message
+    OID, PHM = prehash(PH, M)
+
+    # Construct the M' message
+    M_prime = toByte(1, 1) + toByte(len(ctx), 1) + ctx + OID
+    M_prime = bytearray(M_prime) + PHM
+
+    return slh_verify_internal(M_prime, SIG, PK)